@@ -23,6 +23,17 @@ void Book::setCategory(const std::string& newCategory) { category = newCategory;
 void Book::setPublicationDate(const std::string& newDate) { publicationDate = newDate; }
 void Book::setPageCount(int newPageCount) { pageCount = newPageCount; }
 
+const char* bookStatusName(BookStatus status) {
+    switch (status) {
+        case BookStatus::Available: return "Available";
+        case BookStatus::Borrowed: return "Borrowed";
+        case BookStatus::Reserved: return "Reserved";
+        case BookStatus::Lost: return "Lost";
+        case BookStatus::ReferenceOnly: return "Reference Only";
+    }
+    return "";
+}
+
 void Book::printInfo() const {
     std::cout << "[" << getType() << "] ID: " << id
               << ", Title: " << title
@@ -30,15 +41,29 @@ void Book::printInfo() const {
               << ", Category: " << category
               << ", Published: " << publicationDate
               << ", Pages: " << pageCount
-              << ", Status: ";
-    switch (status) {
-        case BookStatus::Available: std::cout << "Available"; break;
-        case BookStatus::Borrowed: std::cout << "Borrowed"; break;
-        case BookStatus::Reserved: std::cout << "Reserved"; break;
-        case BookStatus::Lost: std::cout << "Lost"; break;
-        case BookStatus::ReferenceOnly: std::cout << "Reference Only"; break;
-    }
-    std::cout << std::endl;
+              << ", Status: " << bookStatusName(status) << '\n';
+}
+
+const std::vector<ReportColumn>& Book::reportColumns() {
+    static const std::vector<ReportColumn> columns = {
+        {"type", ""},
+        {"id", "ID: "},
+        {"title", "Title: "},
+        {"author", "Author: "},
+        {"category", "Category: "},
+        {"published", "Published: "},
+        {"pages", "Pages: "},
+        {"status", "Status: "},
+        {"academic_level", "\n  Academic Level: "},
+        {"field", "Field: "},
+        {"issue_number", "\n  Issue Number: "},
+    };
+    return columns;
+}
+
+void Book::render(ReportWriter& out) const {
+    out.field(getType()).field(id).field(title).field(author).field(category)
+       .field(publicationDate).field(pageCount).field(bookStatusName(status));
 }
 
 // TextBook Implementation
@@ -56,9 +81,14 @@ void TextBook::setField(const std::string& f) { field = f; }
 std::unique_ptr<Book> TextBook::clone() const { return std::make_unique<TextBook>(*this); }
 void TextBook::printInfo() const {
     Book::printInfo();
-    std::cout << "  Academic Level: " << academicLevel << ", Field: " << field << std::endl;
+    std::cout << "  Academic Level: " << academicLevel << ", Field: " << field << '\n';
+}
+void TextBook::render(ReportWriter& out) const {
+    Book::render(out);
+    out.field(academicLevel).field(field);
 }
 std::string TextBook::getType() const { return "TextBook"; }
+BookType TextBook::getBookType() const { return BookType::TextBook; }
 
 // Magazine Implementation
 Magazine::Magazine(int id, const std::string& title, const std::string& author,
@@ -72,9 +102,14 @@ void Magazine::setIssueNumber(int issue) { issueNumber = issue; }
 std::unique_ptr<Book> Magazine::clone() const { return std::make_unique<Magazine>(*this); }
 void Magazine::printInfo() const {
     Book::printInfo();
-    std::cout << "  Issue Number: " << issueNumber << std::endl;
+    std::cout << "  Issue Number: " << issueNumber << '\n';
+}
+void Magazine::render(ReportWriter& out) const {
+    Book::render(out);
+    out.skip().skip().field(issueNumber);
 }
 std::string Magazine::getType() const { return "Magazine"; }
+BookType Magazine::getBookType() const { return BookType::Magazine; }
 
 // ReferenceBook Implementation
 ReferenceBook::ReferenceBook(int id, const std::string& title, const std::string& author,
@@ -85,6 +120,7 @@ ReferenceBook::ReferenceBook(int id, const std::string& title, const std::string
 std::unique_ptr<Book> ReferenceBook::clone() const { return std::make_unique<ReferenceBook>(*this); }
 void ReferenceBook::printInfo() const {
     Book::printInfo();
-    std::cout << "  (Reference Book - Not Borrowable)" << std::endl;
+    std::cout << "  (Reference Book - Not Borrowable)" << '\n';
 }
-std::string ReferenceBook::getType() const { return "ReferenceBook"; } 
\ No newline at end of file
+std::string ReferenceBook::getType() const { return "ReferenceBook"; }
+BookType ReferenceBook::getBookType() const { return BookType::ReferenceBook; } 
\ No newline at end of file
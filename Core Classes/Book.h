@@ -5,6 +5,8 @@
 #include <memory>
 #include <vector>
 #include <ctime>
+#include "LibraryEnums.h"
+#include "../Utils/report/ReportWriter.h"
 using namespace std;
 
 // Enum for Book Status
@@ -16,6 +18,9 @@ enum class BookStatus {
     ReferenceOnly
 };
 
+// "Available", "Borrowed", ... as shown in the listings
+const char* bookStatusName(BookStatus status);
+
 // Base Book class
 class Book {
 protected:
@@ -56,8 +61,13 @@ public:
     // For displaying book info
     virtual void printInfo() const;
 
+    // One listing row in reportColumns() order
+    static const std::vector<ReportColumn>& reportColumns();
+    virtual void render(ReportWriter& out) const;
+
     // For type identification
     virtual string getType() const = 0;
+    virtual BookType getBookType() const = 0;
 };
 
 // TextBook derived class
@@ -75,7 +85,9 @@ public:
     void setField(const string& field);
     std::unique_ptr<Book> clone() const override;
     void printInfo() const override;
+    void render(ReportWriter& out) const override;
     string getType() const override;
+    BookType getBookType() const override;
 };
 
 // Magazine derived class
@@ -90,7 +102,9 @@ public:
     void setIssueNumber(int issue);
     std::unique_ptr<Book> clone() const override;
     void printInfo() const override;
+    void render(ReportWriter& out) const override;
     string getType() const override;
+    BookType getBookType() const override;
 };
 
 // ReferenceBook derived class (non-borrowable)
@@ -102,6 +116,7 @@ public:
     std::unique_ptr<Book> clone() const override;
     void printInfo() const override;
     string getType() const override;
+    BookType getBookType() const override;
 };
 
 #endif // BOOK_H
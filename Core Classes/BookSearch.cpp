@@ -0,0 +1,23 @@
+#include "BookSearch.h"
+#include "../Utils/metrics/LatencyHistogram.h"
+
+bool BookSearch::matches(const Book& book, Field field, const std::string& term) {
+    switch (field) {
+        case Field::Title: return book.getTitle().find(term) != std::string::npos;
+        case Field::Author: return book.getAuthor().find(term) != std::string::npos;
+        case Field::Category: return book.getCategory().find(term) != std::string::npos;
+    }
+    return false;
+}
+
+std::vector<Book*> BookSearch::search(const std::vector<std::unique_ptr<Book>>& books,
+                                      Field field, const std::string& term) {
+    ScopedLatencyTimer timer(MetricOperation::SearchBooks);
+    std::vector<Book*> results;
+    for (const auto& book : books) {
+        if (matches(*book, field, term)) {
+            results.push_back(book.get());
+        }
+    }
+    return results;
+}
@@ -0,0 +1,23 @@
+#ifndef BOOK_SEARCH_H
+#define BOOK_SEARCH_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "Book.h"
+
+// Catalog search used by the menus (substring match on one field)
+class BookSearch {
+public:
+    enum class Field {
+        Title,
+        Author,
+        Category
+    };
+
+    static std::vector<Book*> search(const std::vector<std::unique_ptr<Book>>& books,
+                                     Field field, const std::string& term);
+    static bool matches(const Book& book, Field field, const std::string& term);
+};
+
+#endif // BOOK_SEARCH_H
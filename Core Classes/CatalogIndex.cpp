@@ -0,0 +1,97 @@
+#include "CatalogIndex.h"
+#include <algorithm>
+#include <climits>
+#include "../Utils/metrics/MemoryTracker.h"
+
+void CatalogIndex::rebuild(const std::vector<std::unique_ptr<Book>>& books) {
+    all.clear();
+    for (BookMap& filed : byStatus) filed.clear();
+    for (BookMap& filed : byType) filed.clear();
+    filedStatus.clear();
+    filedStatus.reserve(books.size());
+    for (const auto& book : books) add(book.get());
+}
+
+void CatalogIndex::add(const Book* book) {
+    ScopedMemoryTag tag(MemorySubsystem::Catalog);
+    const int id = book->getId();
+    if (all.count(id)) remove(id);
+    all[id] = book;
+    byStatus[static_cast<size_t>(book->getStatus())][id] = book;
+    byType[static_cast<size_t>(book->getBookType())][id] = book;
+    filedStatus[id] = book->getStatus();
+}
+
+void CatalogIndex::update(const Book* book) {
+    auto filed = filedStatus.find(book->getId());
+    if (filed == filedStatus.end()) {
+        add(book);
+        return;
+    }
+    if (filed->second == book->getStatus()) return;
+    ScopedMemoryTag tag(MemorySubsystem::Catalog);
+    byStatus[static_cast<size_t>(filed->second)].erase(book->getId());
+    byStatus[static_cast<size_t>(book->getStatus())][book->getId()] = book;
+    filed->second = book->getStatus();
+}
+
+void CatalogIndex::remove(int bookId) {
+    auto it = all.find(bookId);
+    if (it == all.end()) return;
+    byType[static_cast<size_t>(it->second->getBookType())].erase(bookId);
+    byStatus[static_cast<size_t>(filedStatus[bookId])].erase(bookId);
+    filedStatus.erase(bookId);
+    all.erase(it);
+}
+
+static std::map<int, const Book*>::const_iterator firstAfter(const std::map<int, const Book*>& books,
+                                                            const PageCursor& after) {
+    if (after.atStart() || after.major < INT_MIN) return books.begin();
+    if (after.major >= INT_MAX) return books.end();
+    return books.upper_bound(static_cast<int>(after.major));
+}
+
+Page<const Book*> CatalogIndex::pageOf(const BookMap& books, const PageCursor& after, size_t limit) {
+    Page<const Book*> page;
+    auto it = firstAfter(books, after);
+    for (; it != books.end() && page.items.size() < limit; ++it) {
+        page.items.push_back(it->second);
+        page.next = PageCursor{it->first, 0};
+    }
+    page.more = it != books.end();
+    if (page.items.empty()) page.next = after;
+    return page;
+}
+
+Page<const Book*> CatalogIndex::page(const PageCursor& after, size_t limit) const {
+    return pageOf(all, after, limit);
+}
+
+Page<const Book*> CatalogIndex::pageByStatus(BookStatus status, const PageCursor& after, size_t limit) const {
+    return pageOf(byStatus[static_cast<size_t>(status)], after, limit);
+}
+
+Page<const Book*> CatalogIndex::pageByType(BookType type, const PageCursor& after, size_t limit) const {
+    return pageOf(byType[static_cast<size_t>(type)], after, limit);
+}
+
+Page<const Book*> CatalogIndex::searchPage(BookSearch::Field field, const std::string& term,
+                                           const PageCursor& after, size_t limit) const {
+    Page<const Book*> page;
+    for (auto it = firstAfter(all, after); it != all.end(); ++it) {
+        if (!BookSearch::matches(*it->second, field, term)) continue;
+        if (page.items.size() == limit) {
+            page.more = true;
+            break;
+        }
+        page.items.push_back(it->second);
+        page.next = PageCursor{it->first, 0};
+    }
+    if (page.items.empty()) page.next = after;
+    return page;
+}
+
+const Book* CatalogIndex::find(int bookId) const {
+    auto it = all.find(bookId);
+    return it == all.end() ? nullptr : it->second;
+}
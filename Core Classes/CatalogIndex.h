@@ -0,0 +1,50 @@
+#ifndef CATALOG_INDEX_H
+#define CATALOG_INDEX_H
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Book.h"
+#include "BookSearch.h"
+#include "LoanManager.h"
+#include "Paging.h"
+
+// Ordered views of the catalog (all books, by status, by type) for
+// keyset-paginated listings; cursor = (book id, 0). The books stay owned by
+// LibrarySystem. Borrows and returns keep statuses current through the
+// LoanManager events; any other change must be reported with add, update
+// or remove.
+class CatalogIndex : public LoanEventListener {
+public:
+    void rebuild(const std::vector<std::unique_ptr<Book>>& books);
+    void add(const Book* book);
+    void update(const Book* book);  // after its status changed
+    void remove(int bookId);
+
+    void onBorrow(const LoanTransaction&, const Book& book) override { update(&book); }
+    void onReturn(const LoanTransaction&, const Book& book) override { update(&book); }
+
+    Page<const Book*> page(const PageCursor& after, size_t limit) const;
+    Page<const Book*> pageByStatus(BookStatus status, const PageCursor& after, size_t limit) const;
+    Page<const Book*> pageByType(BookType type, const PageCursor& after, size_t limit) const;
+    // BookSearch matches in id order; stops as soon as the page is full
+    Page<const Book*> searchPage(BookSearch::Field field, const std::string& term,
+                                 const PageCursor& after, size_t limit) const;
+
+    const Book* find(int bookId) const;
+    size_t size() const { return all.size(); }
+
+private:
+    static const size_t statusCount = static_cast<size_t>(BookStatus::ReferenceOnly) + 1;
+    using BookMap = std::map<int, const Book*>;
+
+    BookMap all;
+    BookMap byStatus[statusCount];
+    BookMap byType[static_cast<size_t>(BookType::Count)];
+    std::unordered_map<int, BookStatus> filedStatus;   // the status each book is filed under
+
+    static Page<const Book*> pageOf(const BookMap& books, const PageCursor& after, size_t limit);
+};
+
+#endif // CATALOG_INDEX_H
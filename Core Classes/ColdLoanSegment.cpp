@@ -0,0 +1,291 @@
+#include "ColdLoanSegment.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+#include "LoanManager.h"
+#include "../Utils/analytics/DayNumber.h"
+#include "../Utils/archive/Varint.h"
+#include "../Utils/storage/AtomicFile.h"
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char fileMagic[8] = {'L', 'O', 'A', 'N', 'C', 'O', 'L', 'D'};
+const uint32_t fileVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockCount;
+    uint64_t loanCount;
+    int32_t maxTransactionId;
+    uint32_t loansPerBlock;
+    double totalFines;
+    uint64_t blocksOffset;      // BlockInfo[blockCount]
+    uint64_t bookRefsOffset;    // BookRef[loanCount]
+    uint64_t fileSize;
+};
+static_assert(sizeof(Header) == 64, "the header is part of the file format");
+
+// Whole cents are stored as a varint; anything else as the raw double
+void putFine(std::string& out, double fine) {
+    const double cents = std::round(fine * 100.0);
+    if (std::abs(cents) < 1e15 && cents / 100.0 == fine) {
+        putVarint(out, zigzag(static_cast<int64_t>(cents)) << 1);
+    } else {
+        putVarint(out, 1);
+        char raw[sizeof(double)];
+        std::memcpy(raw, &fine, sizeof(raw));
+        out.append(raw, sizeof(raw));
+    }
+}
+
+double readFine(VarintReader& in) {
+    const uint64_t tag = in.varint();
+    if (!(tag & 1)) return unzigzag(tag >> 1) / 100.0;
+    double value = 0.0;
+    if (const unsigned char* raw = in.bytes(sizeof(value))) std::memcpy(&value, raw, sizeof(value));
+    return value;
+}
+
+bool byUserBookId(const LoanTransaction& a, const LoanTransaction& b) {
+    return std::tie(a.userId, a.bookId, a.transactionId) < std::tie(b.userId, b.bookId, b.transactionId);
+}
+
+bool byId(const LoanTransaction& a, const LoanTransaction& b) {
+    return a.transactionId < b.transactionId;
+}
+}
+
+ColdLoanSegment::~ColdLoanSegment() {
+    close();
+}
+
+bool ColdLoanSegment::encodable(const LoanTransaction& loan) {
+    return loan.isReturned && dayNumber(loan.borrowDate) != kInvalidDay && dayNumber(loan.dueDate) != kInvalidDay &&
+           dayNumber(loan.returnDate) != kInvalidDay;
+}
+
+bool ColdLoanSegment::write(const std::string& filename, std::vector<LoanTransaction> loans) {
+    std::sort(loans.begin(), loans.end(), byUserBookId);
+
+    Header header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.loanCount = loans.size();
+    header.loansPerBlock = loansPerBlock;
+    header.blockCount = static_cast<uint32_t>((loans.size() + loansPerBlock - 1) / loansPerBlock);
+
+    // Each block starts from zero, so it decodes on its own
+    std::string encoded;
+    std::vector<BlockInfo> blockInfos;
+    blockInfos.reserve(header.blockCount);
+    for (size_t first = 0; first < loans.size(); first += loansPerBlock) {
+        const size_t last = std::min(loans.size(), first + loansPerBlock);
+        BlockInfo info{loans[first].userId, static_cast<uint32_t>(sizeof(Header) + encoded.size()), 0};
+        int64_t previousUser = 0, previousBook = 0, previousId = 0, previousBorrow = 0;
+        for (size_t i = first; i < last; ++i) {
+            const LoanTransaction& loan = loans[i];
+            const int borrowDay = dayNumber(loan.borrowDate);
+            putVarint(encoded, static_cast<uint64_t>(loan.userId - previousUser));
+            putVarint(encoded, zigzag(loan.bookId - previousBook));
+            putVarint(encoded, zigzag(loan.transactionId - previousId));
+            putVarint(encoded, zigzag(borrowDay - previousBorrow));
+            putVarint(encoded, zigzag(static_cast<int64_t>(dayNumber(loan.dueDate)) - borrowDay));
+            putVarint(encoded, zigzag(static_cast<int64_t>(dayNumber(loan.returnDate)) - borrowDay));
+            putFine(encoded, loan.fine);
+            previousUser = loan.userId;
+            previousBook = loan.bookId;
+            previousId = loan.transactionId;
+            previousBorrow = borrowDay;
+            header.maxTransactionId = std::max(header.maxTransactionId, loan.transactionId);
+            header.totalFines += loan.fine;
+        }
+        info.length = static_cast<uint32_t>(sizeof(Header) + encoded.size() - info.offset);
+        blockInfos.push_back(info);
+    }
+    encoded.resize((encoded.size() + 3) & ~size_t(3), '\0');
+    if (sizeof(Header) + encoded.size() > UINT32_MAX) return false;
+
+    std::vector<BookRef> refs(loans.size());
+    for (size_t i = 0; i < loans.size(); ++i) {
+        refs[i] = BookRef{loans[i].bookId, loans[i].transactionId, static_cast<uint32_t>(i)};
+    }
+    std::sort(refs.begin(), refs.end(), [](const BookRef& a, const BookRef& b) {
+        return std::tie(a.bookId, a.transactionId) < std::tie(b.bookId, b.transactionId);
+    });
+
+    header.blocksOffset = sizeof(Header) + encoded.size();
+    header.bookRefsOffset = header.blocksOffset + blockInfos.size() * sizeof(BlockInfo);
+    header.fileSize = header.bookRefsOffset + refs.size() * sizeof(BookRef);
+
+    const std::string tempFile = filename + ".tmp";
+    {
+        std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(encoded.data(), encoded.size());
+        out.write(reinterpret_cast<const char*>(blockInfos.data()), blockInfos.size() * sizeof(BlockInfo));
+        out.write(reinterpret_cast<const char*>(refs.data()), refs.size() * sizeof(BookRef));
+        if (!out.flush()) return false;
+    }
+    return replaceFile(tempFile, filename);
+}
+
+bool ColdLoanSegment::open(const std::string& filename) {
+    close();
+#ifdef _WIN32
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+    heapCopy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data = heapCopy.data();
+    dataSize = heapCopy.size();
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    data = static_cast<const unsigned char*>(mapped);
+    dataSize = static_cast<size_t>(info.st_size);
+#endif
+
+    Header header;
+    if (dataSize < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    const uint64_t expectedBlocks = (header.loanCount + loansPerBlock - 1) / loansPerBlock;
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version != fileVersion ||
+        header.loansPerBlock != loansPerBlock || header.fileSize != dataSize || header.blockCount != expectedBlocks ||
+        header.blocksOffset % 4 != 0 ||
+        header.bookRefsOffset != header.blocksOffset + uint64_t(header.blockCount) * sizeof(BlockInfo) ||
+        header.fileSize != header.bookRefsOffset + header.loanCount * sizeof(BookRef)) {
+        close();
+        return false;
+    }
+    blocks = reinterpret_cast<const BlockInfo*>(data + header.blocksOffset);
+    for (uint32_t i = 0; i < header.blockCount; ++i) {
+        if (blocks[i].offset < sizeof(Header) || uint64_t(blocks[i].offset) + blocks[i].length > header.blocksOffset) {
+            close();
+            return false;
+        }
+    }
+    blockCount = header.blockCount;
+    bookRefs = reinterpret_cast<const BookRef*>(data + header.bookRefsOffset);
+    loanCount = static_cast<size_t>(header.loanCount);
+    maxId = header.maxTransactionId;
+    fines = header.totalFines;
+    return true;
+}
+
+void ColdLoanSegment::close() {
+#ifndef _WIN32
+    if (data) munmap(const_cast<unsigned char*>(data), dataSize);
+#endif
+    heapCopy.clear();
+    heapCopy.shrink_to_fit();
+    data = nullptr;
+    dataSize = 0;
+    blocks = nullptr;
+    blockCount = 0;
+    bookRefs = nullptr;
+    loanCount = 0;
+    maxId = 0;
+    fines = 0.0;
+}
+
+bool ColdLoanSegment::decodeBlock(uint32_t block, std::vector<PackedLoan>& loans) const {
+    loans.clear();
+    const size_t count = std::min<size_t>(loansPerBlock, loanCount - size_t(block) * loansPerBlock);
+    VarintReader in(data + blocks[block].offset, data + blocks[block].offset + blocks[block].length);
+    int64_t user = 0, book = 0, id = 0, borrow = 0;
+    for (size_t i = 0; i < count; ++i) {
+        user += static_cast<int64_t>(in.varint());
+        book += in.signedVarint();
+        id += in.signedVarint();
+        borrow += in.signedVarint();
+        const int64_t due = borrow + in.signedVarint();
+        const int64_t returned = borrow + in.signedVarint();
+        const double fine = readFine(in);
+        if (!in.ok()) return false;
+        loans.push_back(PackedLoan{static_cast<int>(user), static_cast<int>(book), static_cast<int>(id),
+                                   static_cast<int>(borrow), static_cast<int>(due), static_cast<int>(returned), fine});
+    }
+    return true;
+}
+
+LoanTransaction ColdLoanSegment::unpack(const PackedLoan& packed) {
+    LoanTransaction loan(packed.transactionId, packed.userId, packed.bookId, dateFromDayNumber(packed.borrowDay),
+                         dateFromDayNumber(packed.dueDay));
+    loan.returnDate = dateFromDayNumber(packed.returnDay);
+    loan.fine = packed.fine;
+    loan.isReturned = true;
+    return loan;
+}
+
+bool ColdLoanSegment::contains(int bookId, int transactionId) const {
+    return std::binary_search(bookRefs, bookRefs + loanCount, BookRef{bookId, transactionId, 0},
+        [](const BookRef& a, const BookRef& b) {
+            return std::tie(a.bookId, a.transactionId) < std::tie(b.bookId, b.transactionId);
+        });
+}
+
+std::vector<LoanTransaction> ColdLoanSegment::userLoans(int userId) const {
+    std::vector<LoanTransaction> result;
+    // The user's loans can start in the block before the first one that begins with them
+    uint32_t block = static_cast<uint32_t>(std::lower_bound(blocks, blocks + blockCount, userId,
+        [](const BlockInfo& info, int id) { return info.firstUserId < id; }) - blocks);
+    if (block > 0) --block;
+    std::vector<PackedLoan> decoded;
+    for (; block < blockCount && blocks[block].firstUserId <= userId; ++block) {
+        if (!decodeBlock(block, decoded)) break;
+        for (const PackedLoan& loan : decoded) {
+            if (loan.userId == userId) result.push_back(unpack(loan));
+        }
+    }
+    std::sort(result.begin(), result.end(), byId);
+    return result;
+}
+
+std::vector<LoanTransaction> ColdLoanSegment::bookLoans(int bookId) const {
+    std::vector<LoanTransaction> result;
+    auto range = std::equal_range(bookRefs, bookRefs + loanCount, BookRef{bookId, 0, 0},
+        [](const BookRef& a, const BookRef& b) { return a.bookId < b.bookId; });
+    std::vector<PackedLoan> decoded;
+    uint32_t decodedBlock = UINT32_MAX;
+    for (const BookRef* ref = range.first; ref != range.second; ++ref) {
+        const uint32_t block = ref->position / loansPerBlock;
+        if (block != decodedBlock) {
+            if (block >= blockCount || !decodeBlock(block, decoded)) break;
+            decodedBlock = block;
+        }
+        const size_t index = ref->position % loansPerBlock;
+        if (index < decoded.size()) result.push_back(unpack(decoded[index]));
+    }
+    return result;
+}
+
+void ColdLoanSegment::forEach(const std::function<void(const LoanTransaction&)>& visit) const {
+    std::vector<PackedLoan> decoded;
+    decoded.reserve(loansPerBlock);
+    for (uint32_t block = 0; block < blockCount; ++block) {
+        if (!decodeBlock(block, decoded)) return;
+        for (const PackedLoan& loan : decoded) visit(unpack(loan));
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef COLD_LOAN_SEGMENT_H
+#define COLD_LOAN_SEGMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct LoanTransaction;
+
+// The cold tier of the loan history: returned loans moved out of memory into
+// a read-only file that is memory-mapped. Loans are sorted by (userId, bookId,
+// transactionId) and delta/varint-encoded in blocks of loansPerBlock, with
+// dates as day numbers. A block directory (first user of each block) serves
+// lookups by user, and a (bookId, transactionId) -> position table serves
+// lookups by book. The file is only ever written whole, by write().
+class ColdLoanSegment {
+public:
+    static constexpr uint32_t loansPerBlock = 128;
+
+    ColdLoanSegment() = default;
+    ~ColdLoanSegment();
+    ColdLoanSegment(const ColdLoanSegment&) = delete;
+    ColdLoanSegment& operator=(const ColdLoanSegment&) = delete;
+
+    // A missing or malformed file leaves the segment empty and returns false
+    bool open(const std::string& filename);
+    void close();
+
+    // Only returned loans with valid dates can be stored
+    static bool encodable(const LoanTransaction& loan);
+    // Writes a temporary file and renames it over filename, so an open
+    // segment (even of the same file) stays readable until reopened
+    static bool write(const std::string& filename, std::vector<LoanTransaction> loans);
+
+    size_t size() const { return loanCount; }
+    int maxTransactionId() const { return maxId; }
+    double totalFines() const { return fines; }
+
+    bool contains(int bookId, int transactionId) const;
+    // A user's or a book's loans, in transactionId order
+    std::vector<LoanTransaction> userLoans(int userId) const;
+    std::vector<LoanTransaction> bookLoans(int bookId) const;
+    // Decodes every loan in (userId, bookId, transactionId) order; stops at a damaged block
+    void forEach(const std::function<void(const LoanTransaction&)>& visit) const;
+
+private:
+    struct BlockInfo {
+        int32_t firstUserId;
+        uint32_t offset;        // of the block's encoded loans, from the start of the file
+        uint32_t length;
+    };
+    // A decoded loan before its dates are formatted
+    struct PackedLoan {
+        int userId;
+        int bookId;
+        int transactionId;
+        int borrowDay;
+        int dueDay;
+        int returnDay;
+        double fine;
+    };
+    struct BookRef {
+        int32_t bookId;
+        int32_t transactionId;
+        uint32_t position;      // in the (userId, bookId, transactionId) order
+    };
+
+    const unsigned char* data = nullptr;
+    size_t dataSize = 0;
+    std::vector<unsigned char> heapCopy;   // where the file cannot be mapped
+    const BlockInfo* blocks = nullptr;
+    uint32_t blockCount = 0;
+    const BookRef* bookRefs = nullptr;
+    size_t loanCount = 0;
+    int maxId = 0;
+    double fines = 0.0;
+
+    bool decodeBlock(uint32_t block, std::vector<PackedLoan>& loans) const;
+    static LoanTransaction unpack(const PackedLoan& packed);
+};
+
+#endif // COLD_LOAN_SEGMENT_H
@@ -0,0 +1,190 @@
+#include "FinePolicy.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+
+namespace {
+struct ParsedRule {
+    int type;           // BookType, or -1 for any
+    int role;           // UserRole, or -1 for any
+    int firstDay;
+    int lastDay;        // INT_MAX when open-ended
+    double rate;
+};
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+int parseType(const std::string& token) {
+    if (token == "*") return -1;
+    if (token == "textbook") return static_cast<int>(BookType::TextBook);
+    if (token == "magazine") return static_cast<int>(BookType::Magazine);
+    if (token == "referencebook" || token == "reference") return static_cast<int>(BookType::ReferenceBook);
+    return -2;
+}
+
+int parseRole(const std::string& token) {
+    if (token == "*") return -1;
+    if (token == "regular" || token == "regularuser") return static_cast<int>(UserRole::Regular);
+    if (token == "librarian") return static_cast<int>(UserRole::Librarian);
+    return -2;
+}
+
+bool parseDay(const std::string& text, int& day) {
+    if (text.empty() || text.size() > 6 || !std::all_of(text.begin(), text.end(), ::isdigit)) return false;
+    day = std::atoi(text.c_str());
+    return day >= 1;
+}
+
+bool parseRule(const FinePolicy::Rule& rule, ParsedRule& parsed, std::string& reason) {
+    const std::string key = lowercase(rule.key);
+    size_t firstDot = key.find('.');
+    size_t secondDot = firstDot == std::string::npos ? firstDot : key.find('.', firstDot + 1);
+    if (secondDot == std::string::npos) {
+        reason = "expected <book type>.<user role>.<days>";
+        return false;
+    }
+    parsed.type = parseType(key.substr(0, firstDot));
+    if (parsed.type == -2) {
+        reason = "unknown book type";
+        return false;
+    }
+    parsed.role = parseRole(key.substr(firstDot + 1, secondDot - firstDot - 1));
+    if (parsed.role == -2) {
+        reason = "unknown user role";
+        return false;
+    }
+
+    const std::string band = key.substr(secondDot + 1);
+    size_t dash = band.find('-');
+    if (!parseDay(band.substr(0, dash), parsed.firstDay)) {
+        reason = "bad first day";
+        return false;
+    }
+    parsed.lastDay = INT_MAX;
+    if (dash != std::string::npos && (!parseDay(band.substr(dash + 1), parsed.lastDay) || parsed.lastDay < parsed.firstDay)) {
+        reason = "bad last day";
+        return false;
+    }
+
+    char* end = nullptr;
+    parsed.rate = std::strtod(rule.value.c_str(), &end);
+    while (end && std::isspace(static_cast<unsigned char>(*end))) ++end;
+    if (end == rule.value.c_str() || (end && *end != '\0') || parsed.rate < 0) {
+        reason = "rate must be a non-negative number";
+        return false;
+    }
+    return true;
+}
+}
+
+FinePolicy::FinePolicy(double dailyRate) {
+    for (auto& byRole : rows) {
+        for (Row& row : byRole) {
+            row.rate[0] = 0.0;
+            std::fill(row.rate + 1, row.rate + tableDays, dailyRate);
+            row.tail.assign(1, Band{INT_MAX, dailyRate});
+        }
+    }
+    fillTotals();
+}
+
+void FinePolicy::fillTotals() {
+    for (auto& byRole : rows) {
+        for (Row& row : byRole) {
+            row.total[0] = 0.0;
+            for (int day = 1; day < tableDays; ++day) row.total[day] = row.total[day - 1] + row.rate[day];
+        }
+    }
+}
+
+double FinePolicy::tailFine(const Row& row, int daysOverdue) {
+    double total = 0.0;
+    int firstDay = tableDays;
+    for (const Band& band : row.tail) {
+        const int lastDay = std::min(band.lastDay, daysOverdue);
+        total += static_cast<double>(lastDay - firstDay + 1) * band.rate;
+        if (lastDay == daysOverdue) break;
+        firstDay = band.lastDay + 1;
+    }
+    return total;
+}
+
+// Sets days firstDay..lastDay (both past the table) to rate, splitting the bands it overlaps
+void FinePolicy::paintTail(std::vector<Band>& tail, int firstDay, int lastDay, double rate) {
+    std::vector<Band> painted;
+    int start = tableDays;
+    bool placed = false;
+    for (const Band& band : tail) {
+        if (start < firstDay) painted.push_back({std::min(band.lastDay, firstDay - 1), band.rate});
+        if (band.lastDay > lastDay) {
+            if (!placed) painted.push_back({lastDay, rate});
+            placed = true;
+            painted.push_back(band);
+        }
+        if (band.lastDay == INT_MAX) break;
+        start = band.lastDay + 1;
+    }
+    if (!placed) painted.push_back({lastDay, rate});
+
+    // Neighbours with the same rate become one band
+    tail.clear();
+    for (const Band& band : painted) {
+        if (!tail.empty() && tail.back().rate == band.rate) {
+            tail.back().lastDay = band.lastDay;
+        } else {
+            tail.push_back(band);
+        }
+    }
+}
+
+FinePolicy FinePolicy::compile(double dailyRate, const std::vector<Rule>& rules, std::string* errors) {
+    std::vector<ParsedRule> parsed;
+    for (const Rule& rule : rules) {
+        ParsedRule entry;
+        std::string reason;
+        if (parseRule(rule, entry, reason)) {
+            parsed.push_back(entry);
+        } else if (errors) {
+            *errors += "fine rule '" + rule.key + " = " + rule.value + "' ignored: " + reason + "\n";
+        }
+    }
+
+    // General rules first, so more specific ones overwrite them
+    auto wildcards = [](const ParsedRule& r) { return (r.type < 0) + (r.role < 0); };
+    std::stable_sort(parsed.begin(), parsed.end(), [&](const ParsedRule& a, const ParsedRule& b) {
+        if (wildcards(a) != wildcards(b)) return wildcards(a) > wildcards(b);
+        return static_cast<long long>(a.lastDay) - a.firstDay > static_cast<long long>(b.lastDay) - b.firstDay;
+    });
+
+    FinePolicy policy(dailyRate);
+    for (const ParsedRule& rule : parsed) {
+        const int lastDay = std::min(rule.lastDay, tableDays - 1);
+        const bool pastTable = rule.lastDay >= tableDays;
+        for (int type = 0; type < static_cast<int>(BookType::Count); ++type) {
+            if (rule.type >= 0 && rule.type != type) continue;
+            for (int role = 0; role < static_cast<int>(UserRole::Count); ++role) {
+                if (rule.role >= 0 && rule.role != role) continue;
+                Row& row = policy.rows[type][role];
+                if (rule.firstDay <= lastDay) std::fill(row.rate + rule.firstDay, row.rate + lastDay + 1, rule.rate);
+                if (pastTable) paintTail(row.tail, std::max(rule.firstDay, tableDays), rule.lastDay, rule.rate);
+            }
+        }
+    }
+    policy.fillTotals();
+    return policy;
+}
+
+double FinePolicy::dailyRate(BookType type, UserRole role, int day) const {
+    if (day <= 0) return 0.0;
+    const Row& row = rows[static_cast<size_t>(type)][static_cast<size_t>(role)];
+    if (day < tableDays) return row.rate[day];
+    for (const Band& band : row.tail) {
+        if (day <= band.lastDay) return band.rate;
+    }
+    return row.tail.back().rate;
+}
@@ -0,0 +1,62 @@
+#ifndef FINE_POLICY_H
+#define FINE_POLICY_H
+
+#include <string>
+#include <vector>
+#include "LibraryEnums.h"
+
+// Fine rates by book type, user role and day overdue, compiled from the
+// [FineRules] section of Config.ini into a dense table of running totals,
+// so a fine is two array loads and a multiply-add.
+//
+// A rule is "<book type>.<user role>.<first day>[-<last day>] = <rate per day>",
+// with '*' for any type or role and no last day for "and every day after":
+//   textbook.regular.1-7 = 0.5
+//   textbook.regular.8 = 1.5
+//   *.librarian.1 = 0
+// Rules with fewer wildcards, then narrower bands, override the others.
+// Days no rule covers are charged daily_fine_rate.
+class FinePolicy {
+public:
+    // Days 1..tableDays-1 are looked up in the table; later days are charged
+    // from a short list of bands kept per row
+    static constexpr int tableDays = 128;
+
+    struct Rule {
+        std::string key;    // as written under [FineRules]
+        std::string value;
+    };
+
+    explicit FinePolicy(double dailyRate = 1.0);
+
+    // Unparsable rules are skipped and described in errors (one per line)
+    static FinePolicy compile(double dailyRate, const std::vector<Rule>& rules, std::string* errors = nullptr);
+
+    // Total fine for a loan returned daysOverdue days late
+    double fine(BookType type, UserRole role, int daysOverdue) const {
+        if (daysOverdue <= 0) return 0.0;
+        const Row& row = rows[static_cast<size_t>(type)][static_cast<size_t>(role)];
+        if (daysOverdue < tableDays) return row.total[daysOverdue];
+        return row.total[tableDays - 1] + tailFine(row, daysOverdue);
+    }
+
+    double dailyRate(BookType type, UserRole role, int day) const;
+
+private:
+    struct Band {
+        int lastDay;                // the band starts the day after the previous one ends
+        double rate;
+    };
+    struct Row {
+        double rate[tableDays];     // fine for day d overdue (rate[0] unused)
+        double total[tableDays];    // fines for days 1..d
+        std::vector<Band> tail;     // days from tableDays on; the last band ends at INT_MAX
+    };
+    Row rows[static_cast<size_t>(BookType::Count)][static_cast<size_t>(UserRole::Count)];
+
+    void fillTotals();
+    static double tailFine(const Row& row, int daysOverdue);
+    static void paintTail(std::vector<Band>& tail, int firstDay, int lastDay, double rate);
+};
+
+#endif // FINE_POLICY_H
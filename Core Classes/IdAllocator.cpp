@@ -0,0 +1,49 @@
+#include "IdAllocator.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include "../Utils/storage/AtomicFile.h"
+
+const char* IdAllocator::kindName(IdKind kind) {
+    switch (kind) {
+        case IdKind::Book: return "book";
+        case IdKind::User: return "user";
+        default: return "";
+    }
+}
+
+bool IdAllocator::load(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!checkChecksumLine(content)) {
+        std::cerr << "Warning: " << filename << " does not match its checksum; ids already in use are still "
+                  << "never handed out again\n";
+    }
+    std::istringstream lines(content);
+    std::string line;
+    std::getline(lines, line); // header
+    while (std::getline(lines, line)) {
+        size_t comma = line.find(',');
+        if (comma == std::string::npos) continue;
+        const std::string name = line.substr(0, comma);
+        const int next = std::atoi(line.c_str() + comma + 1);
+        for (size_t i = 0; i < static_cast<size_t>(IdKind::Count); ++i) {
+            if (name == kindName(static_cast<IdKind>(i))) observe(static_cast<IdKind>(i), next - 1);
+        }
+    }
+    return true;
+}
+
+bool IdAllocator::save(const std::string& filename) const {
+    AtomicFileWriter writer(filename);
+    if (!writer.isOpen()) return false;
+    std::ostream& out = writer.stream();
+    out << "Kind,NextId\n";
+    for (size_t i = 0; i < static_cast<size_t>(IdKind::Count); ++i) {
+        out << kindName(static_cast<IdKind>(i)) << ',' << nextIds[i] << '\n';
+    }
+    return writer.commitWithChecksum();
+}
@@ -0,0 +1,39 @@
+#ifndef ID_ALLOCATOR_H
+#define ID_ALLOCATOR_H
+
+#include <string>
+
+enum class IdKind : unsigned char {
+    Book,
+    User,
+    Count
+};
+
+// Hands out book and user ids in increasing order and never reuses one, even
+// after the entity is removed: the next id of each kind is saved with the
+// database. On load, observe() every id already in use, so a missing or stale
+// file cannot lead to a duplicate.
+class IdAllocator {
+public:
+    int allocate(IdKind kind) { return nextIds[index(kind)]++; }
+    int peek(IdKind kind) const { return nextIds[index(kind)]; }
+
+    // Raises the next id above one that is already taken
+    void observe(IdKind kind, int usedId) {
+        int& next = nextIds[index(kind)];
+        if (usedId >= next) next = usedId + 1;
+    }
+
+    // Lines are "<kind>,<next id>" under a header, then a checksum line; a
+    // missing file leaves the counters alone and unknown kinds are ignored
+    bool load(const std::string& filename);
+    bool save(const std::string& filename) const;
+
+private:
+    int nextIds[static_cast<size_t>(IdKind::Count)] = {1, 1};
+
+    static size_t index(IdKind kind) { return static_cast<size_t>(kind); }
+    static const char* kindName(IdKind kind);
+};
+
+#endif // ID_ALLOCATOR_H
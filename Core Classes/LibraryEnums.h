@@ -0,0 +1,22 @@
+#ifndef LIBRARY_ENUMS_H
+#define LIBRARY_ENUMS_H
+
+// Dense enums used as table indexes. They live apart from Book.h and User.h
+// so configuration code can size tables by them without pulling in the classes.
+
+// Concrete Book subclass (Book::getBookType)
+enum class BookType : unsigned char {
+    TextBook,
+    Magazine,
+    ReferenceBook,
+    Count
+};
+
+// Enum for user roles (dense: indexes rolePolicies)
+enum class UserRole : unsigned char {
+    Regular,
+    Librarian,
+    Count
+};
+
+#endif // LIBRARY_ENUMS_H
@@ -0,0 +1,283 @@
+#include "LoanHistoryTree.h"
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include "LoanManager.h"
+#include "../Utils/analytics/DayNumber.h"
+#include "../Utils/checksum/Crc32c.h"
+#include "../Utils/metrics/MemoryTracker.h"
+#include "../Utils/metrics/Tracer.h"
+#include "../Utils/storage/AtomicFile.h"
+
+namespace {
+const char fileMagic[8] = {'L', 'O', 'A', 'N', 'T', 'R', 'E', 'E'};
+const uint32_t fileVersion = 1;
+const uint16_t leafPage = 1;
+const uint16_t innerPage = 2;
+const int maxDepth = 32;    // a damaged file must not send a lookup round in circles
+
+// Page 0, followed by zeros up to the page size
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t pageCount;
+    uint32_t userRoot;
+    uint32_t bookRoot;
+    int32_t maxTransactionId;   // of the cold segment the tree was built for
+    uint64_t loanCount;
+    double totalFines;
+    uint32_t headerCrc;         // of the bytes before it
+    uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 56, "the header is part of the file format");
+
+using KeyTuple = std::tuple<int32_t, int32_t, int32_t>;     // (user or book, borrow day, transactionId)
+
+uint32_t pageCrc(const unsigned char* page) {
+    return crc32c(page + sizeof(uint32_t), LoanHistoryTree::pageSize - sizeof(uint32_t));
+}
+}
+
+int32_t LoanHistoryTree::keyId(Key key, const LeafEntry& entry) {
+    return key == Key::User ? entry.userId : entry.bookId;
+}
+
+// Bulk load: full leaves in key order, then each inner level over the one below
+void LoanHistoryTree::writeTree(std::ofstream& out, Key key, std::vector<LeafEntry>& entries, uint32_t& nextPage,
+                                uint32_t& root) {
+    auto keyOf = [key](const LeafEntry& e) { return KeyTuple(keyId(key, e), e.borrowDay, e.transactionId); };
+    std::sort(entries.begin(), entries.end(),
+              [&keyOf](const LeafEntry& a, const LeafEntry& b) { return keyOf(a) < keyOf(b); });
+    root = 0;
+    if (entries.empty()) return;
+
+    std::vector<unsigned char> page(pageSize);
+    auto writePage = [&](uint16_t type, size_t count, uint32_t next, const void* items, size_t itemSize) {
+        std::fill(page.begin(), page.end(), 0);
+        PageHeader header{0, type, static_cast<uint16_t>(count), next, 0};
+        std::memcpy(page.data(), &header, sizeof(header));
+        std::memcpy(page.data() + sizeof(header), items, count * itemSize);
+        header.crc = pageCrc(page.data());
+        std::memcpy(page.data(), &header.crc, sizeof(header.crc));
+        out.write(reinterpret_cast<const char*>(page.data()), pageSize);
+        return nextPage++;
+    };
+
+    std::vector<InnerEntry> level;
+    for (size_t first = 0; first < entries.size(); first += leafCapacity) {
+        const size_t count = std::min(leafCapacity, entries.size() - first);
+        const bool last = first + count == entries.size();
+        const LeafEntry& head = entries[first];
+        const uint32_t written = writePage(leafPage, count, last ? 0 : nextPage + 1, &entries[first], sizeof(LeafEntry));
+        level.push_back({keyId(key, head), head.borrowDay, head.transactionId, written});
+    }
+    while (level.size() > 1) {
+        std::vector<InnerEntry> parents;
+        for (size_t first = 0; first < level.size(); first += innerCapacity) {
+            const size_t count = std::min(innerCapacity, level.size() - first);
+            InnerEntry parent = level[first];
+            parent.child = writePage(innerPage, count, 0, &level[first], sizeof(InnerEntry));
+            parents.push_back(parent);
+        }
+        level.swap(parents);
+    }
+    root = level.front().child;
+}
+
+bool LoanHistoryTree::build(const std::string& filename, std::vector<LoanTransaction> loans, int coldMaxId,
+                            double coldFines) {
+    ScopedTraceSpan span("LoanHistoryTree::build");
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    std::vector<LeafEntry> entries;
+    entries.reserve(loans.size());
+    for (const LoanTransaction& loan : loans) {
+        entries.push_back({loan.transactionId, loan.userId, loan.bookId, dayNumber(loan.borrowDate),
+                           dayNumber(loan.dueDate), loan.isReturned ? dayNumber(loan.returnDate) : kInvalidDay,
+                           loan.fine});
+    }
+    loans.clear();
+    loans.shrink_to_fit();
+
+    const std::string tempFile = filename + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    std::vector<char> headerPage(pageSize, 0);
+    out.write(headerPage.data(), pageSize);     // filled in at the end
+
+    FileHeader header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.pageSize = pageSize;
+    header.maxTransactionId = coldMaxId;
+    header.loanCount = entries.size();
+    header.totalFines = coldFines;
+    uint32_t nextPage = 1;
+    writeTree(out, Key::User, entries, nextPage, header.userRoot);
+    writeTree(out, Key::Book, entries, nextPage, header.bookRoot);
+    header.pageCount = nextPage;
+    header.headerCrc = crc32c(&header, offsetof(FileHeader, headerCrc));
+    std::memcpy(headerPage.data(), &header, sizeof(header));
+    out.seekp(0);
+    out.write(headerPage.data(), pageSize);
+    out.close();
+    if (out.fail()) {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return replaceFile(tempFile, filename);
+}
+
+bool LoanHistoryTree::open(const std::string& filename, size_t cachePages) {
+    close();
+    file.open(filename, std::ios::binary);
+    if (!file) return false;
+
+    FileHeader header;
+    file.seekg(0, std::ios::end);
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+    const bool valid = file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+                       std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) == 0 &&
+                       header.version == fileVersion && header.pageSize == pageSize &&
+                       header.headerCrc == crc32c(&header, offsetof(FileHeader, headerCrc)) &&
+                       fileSize == static_cast<std::streamoff>(header.pageCount) * pageSize &&
+                       header.userRoot < header.pageCount && header.bookRoot < header.pageCount;
+    if (!valid) {
+        close();
+        return false;
+    }
+    pageCount = header.pageCount;
+    roots[static_cast<int>(Key::User)] = header.userRoot;
+    roots[static_cast<int>(Key::Book)] = header.bookRoot;
+    loanCount = static_cast<size_t>(header.loanCount);
+    maxId = header.maxTransactionId;
+    fines = header.totalFines;
+    stats.capacity = std::max<size_t>(1, cachePages);
+    return true;
+}
+
+void LoanHistoryTree::close() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    file.close();
+    file.clear();
+    frames.clear();
+    framesByPage.clear();
+    stats = CacheStats{};
+    pageCount = 0;
+    roots[0] = roots[1] = 0;
+    loanCount = 0;
+    maxId = 0;
+    fines = 0.0;
+}
+
+bool LoanHistoryTree::matches(size_t loans, int coldMaxId, double coldFines) const {
+    return isOpen() && loanCount == loans && maxId == coldMaxId && fines == coldFines;
+}
+
+LoanHistoryTree::CacheStats LoanHistoryTree::cacheStats() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    CacheStats current = stats;
+    current.pages = frames.size();
+    return current;
+}
+
+const unsigned char* LoanHistoryTree::fetch(uint32_t page) const {
+    auto cached = framesByPage.find(page);
+    if (cached != framesByPage.end()) {
+        ++stats.hits;
+        frames.splice(frames.begin(), frames, cached->second);
+        return frames.front().bytes.get();
+    }
+    ++stats.misses;
+    if (page == 0 || page >= pageCount) return nullptr;
+
+    // Reuse the least recently used frame once the pool is full
+    Frame frame{page, nullptr};
+    if (frames.size() >= stats.capacity) {
+        frame.bytes = std::move(frames.back().bytes);
+        framesByPage.erase(frames.back().page);
+        frames.pop_back();
+    } else {
+        frame.bytes.reset(new unsigned char[pageSize]);
+    }
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(page) * pageSize);
+    if (!file.read(reinterpret_cast<char*>(frame.bytes.get()), pageSize)) return nullptr;
+    PageHeader header;
+    std::memcpy(&header, frame.bytes.get(), sizeof(header));
+    if (header.crc != pageCrc(frame.bytes.get())) return nullptr;
+
+    frames.push_front(std::move(frame));
+    framesByPage[page] = frames.begin();
+    return frames.front().bytes.get();
+}
+
+bool LoanHistoryTree::find(Key key, int id, int fromDay, int toDay, std::vector<LoanTransaction>& loans) const {
+    return scan(key, id, fromDay, INT_MIN, toDay, SIZE_MAX, loans);
+}
+
+bool LoanHistoryTree::findAfter(Key key, int id, int afterDay, int afterTransactionId, size_t limit,
+                                std::vector<LoanTransaction>& loans) const {
+    if (afterTransactionId < INT_MAX) return scan(key, id, afterDay, afterTransactionId + 1, INT_MAX, limit, loans);
+    if (afterDay == INT_MAX) return true;
+    return scan(key, id, afterDay + 1, INT_MIN, INT_MAX, limit, loans);
+}
+
+bool LoanHistoryTree::scan(Key key, int id, int fromDay, int fromTransactionId, int toDay, size_t limit,
+                           std::vector<LoanTransaction>& loans) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    uint32_t page = isOpen() ? roots[static_cast<int>(key)] : 0;
+    if (page == 0 || limit == 0) return true;
+    const KeyTuple low(id, fromDay, fromTransactionId);
+    const KeyTuple high(id, toDay, INT_MAX);
+
+    // Down to the leftmost leaf that can hold low
+    for (int depth = 0;; ++depth) {
+        const unsigned char* bytes = fetch(page);
+        if (!bytes || depth > maxDepth) return false;
+        const PageHeader* header = reinterpret_cast<const PageHeader*>(bytes);
+        if (header->type == leafPage) break;
+        const size_t count = header->count;
+        if (header->type != innerPage || count == 0 || count > innerCapacity) return false;
+        const InnerEntry* entries = reinterpret_cast<const InnerEntry*>(bytes + sizeof(PageHeader));
+        const InnerEntry* after = std::upper_bound(entries, entries + count, low,
+            [](const KeyTuple& k, const InnerEntry& e) { return k < KeyTuple(e.id, e.borrowDay, e.transactionId); });
+        page = (after == entries ? entries : after - 1)->child;
+    }
+
+    // Along the leaves until a key passes high
+    bool first = true;
+    for (size_t visited = 0; page != 0; ++visited) {
+        const unsigned char* bytes = fetch(page);
+        if (!bytes || visited > pageCount) return false;
+        const PageHeader* header = reinterpret_cast<const PageHeader*>(bytes);
+        if (header->type != leafPage || header->count > leafCapacity) return false;
+        const LeafEntry* entries = reinterpret_cast<const LeafEntry*>(bytes + sizeof(PageHeader));
+        const LeafEntry* end = entries + header->count;
+        const LeafEntry* it = entries;
+        if (first) {
+            it = std::lower_bound(entries, end, low, [key](const LeafEntry& e, const KeyTuple& k) {
+                return KeyTuple(keyId(key, e), e.borrowDay, e.transactionId) < k;
+            });
+            first = false;
+        }
+        for (; it != end; ++it) {
+            if (KeyTuple(keyId(key, *it), it->borrowDay, it->transactionId) > high) return true;
+            LoanTransaction loan(it->transactionId, it->userId, it->bookId, dateFromDayNumber(it->borrowDay),
+                                 dateFromDayNumber(it->dueDay));
+            loan.isReturned = it->returnDay != kInvalidDay;
+            if (loan.isReturned) loan.returnDate = dateFromDayNumber(it->returnDay);
+            loan.fine = it->fine;
+            loans.push_back(std::move(loan));
+            if (--limit == 0) return true;
+        }
+        page = header->next;
+    }
+    return true;
+}
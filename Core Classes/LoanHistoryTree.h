@@ -0,0 +1,117 @@
+#ifndef LOAN_HISTORY_TREE_H
+#define LOAN_HISTORY_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LoanTransaction;
+
+// A read-only B+tree file over the cold tier of the loan history. One file
+// holds two trees: loans by (userId, borrow day, transactionId) and loans by
+// (bookId, borrow day, transactionId). The leaves hold the loans themselves,
+// so a lookup reads the pages on one root-to-leaf path and the leaves it
+// scans. Pages are 4 KiB, page-aligned and checksummed, and are read through
+// an LRU buffer pool of a fixed number of pages, so memory use does not grow
+// with the history. The file is only ever written whole, by build().
+class LoanHistoryTree {
+public:
+    static constexpr uint32_t pageSize = 4096;
+
+    enum class Key { User, Book };
+
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t pages = 0;       // currently cached
+        size_t capacity = 0;
+    };
+
+    LoanHistoryTree() = default;
+    LoanHistoryTree(const LoanHistoryTree&) = delete;
+    LoanHistoryTree& operator=(const LoanHistoryTree&) = delete;
+
+    // Loans must have valid dates (ColdLoanSegment::encodable). coldMaxId and
+    // coldFines identify the segment the tree was built for.
+    static bool build(const std::string& filename, std::vector<LoanTransaction> loans, int coldMaxId,
+                      double coldFines);
+
+    // A missing or malformed file leaves the tree closed and returns false
+    bool open(const std::string& filename, size_t cachePages);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+    // Whether the file was built for a segment with these figures
+    bool matches(size_t loans, int coldMaxId, double coldFines) const;
+
+    size_t size() const { return loanCount; }
+
+    // Appends the loans of one user or book borrowed on days fromDay..toDay,
+    // by borrow day then transactionId. Returns false if a page is damaged.
+    bool find(Key key, int id, int fromDay, int toDay, std::vector<LoanTransaction>& loans) const;
+    // For paging: appends at most limit loans of one user or book that come
+    // after (afterDay, afterTransactionId) in the same order
+    bool findAfter(Key key, int id, int afterDay, int afterTransactionId, size_t limit,
+                   std::vector<LoanTransaction>& loans) const;
+
+    CacheStats cacheStats() const;
+
+private:
+    struct PageHeader {
+        uint32_t crc;           // of the rest of the page
+        uint16_t type;
+        uint16_t count;
+        uint32_t next;          // leaves: the next leaf of the same tree (0 = last)
+        uint32_t reserved;
+    };
+    struct LeafEntry {
+        int32_t transactionId;
+        int32_t userId;
+        int32_t bookId;
+        int32_t borrowDay;
+        int32_t dueDay;
+        int32_t returnDay;
+        double fine;
+    };
+    struct InnerEntry {
+        int32_t id;             // the first key in the child
+        int32_t borrowDay;
+        int32_t transactionId;
+        uint32_t child;
+    };
+    static constexpr size_t leafCapacity = (pageSize - sizeof(PageHeader)) / sizeof(LeafEntry);
+    static constexpr size_t innerCapacity = (pageSize - sizeof(PageHeader)) / sizeof(InnerEntry);
+
+    // Fixed-capacity page cache, least recently used page evicted first
+    struct Frame {
+        uint32_t page;
+        std::unique_ptr<unsigned char[]> bytes;
+    };
+    mutable std::ifstream file;
+    mutable std::list<Frame> frames;    // most recently used first
+    mutable std::unordered_map<uint32_t, std::list<Frame>::iterator> framesByPage;
+    mutable CacheStats stats;
+    mutable std::mutex poolMutex;
+
+    uint32_t pageCount = 0;
+    uint32_t roots[2] = {0, 0};         // 0 = empty tree
+    size_t loanCount = 0;
+    int maxId = 0;
+    double fines = 0.0;
+
+    // The page's bytes, valid until the next fetch; nullptr if unreadable or damaged
+    const unsigned char* fetch(uint32_t page) const;
+    static int32_t keyId(Key key, const LeafEntry& entry);
+    // Keys (id, fromDay, fromTransactionId) through (id, toDay, any), at most limit loans
+    bool scan(Key key, int id, int fromDay, int fromTransactionId, int toDay, size_t limit,
+              std::vector<LoanTransaction>& loans) const;
+    static void writeTree(std::ofstream& out, Key key, std::vector<LeafEntry>& entries, uint32_t& nextPage,
+                          uint32_t& root);
+};
+
+#endif // LOAN_HISTORY_TREE_H
@@ -4,7 +4,31 @@
 #include <sstream>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <climits>
 #include "../Utils/ini/GlobalConfiguration.h"
+#include "../Utils/concurrency/ThreadPool.h"
+#include "../Utils/metrics/LatencyHistogram.h"
+#include "../Utils/metrics/Tracer.h"
+#include "../Utils/metrics/MemoryTracker.h"
+#include "../Utils/analytics/DayNumber.h"
+
+// Below this many transactions a scan is cheaper than handing it to the pool
+static const size_t kParallelGrain = 16384;
+
+// Order of the per-user and per-book history lists and of the cold index
+static std::pair<int, int> historyKey(const LoanTransaction& loan) {
+    return {dayNumber(loan.borrowDate), loan.transactionId};
+}
+
+static bool historyBefore(const LoanTransaction* a, const LoanTransaction* b) {
+    return historyKey(*a) < historyKey(*b);
+}
+
+// New loans are borrowed today, so this is nearly always an append
+static void insertHistory(std::vector<const LoanTransaction*>& history, const LoanTransaction* loan) {
+    history.insert(std::upper_bound(history.begin(), history.end(), loan, historyBefore), loan);
+}
 
 // LoanTransaction constructor implementation
 LoanTransaction::LoanTransaction(int transId, int uId, int bId, const std::string& borrow, const std::string& due)
@@ -16,39 +40,14 @@ Reservation::Reservation(int uId, int bId, const std::string& date, const std::s
     : userId(uId), bookId(bId), reservationDate(date), expiryDate(expiry) {}
 Reservation::Reservation(int uId, int bId, const std::string& date)
     : userId(uId), bookId(bId), reservationDate(date) {}
-// StandardFineCalculator implementation
-double StandardFineCalculator::calculateFine(const std::string& dueDate, const std::string& returnDate) {
-    // Simple date comparison - in production, use proper date parsing
-    if (returnDate <= dueDate) return 0.0;
-
-    auto dueDateTime = parseDate(dueDate);
-    auto returnDateTime = parseDate(returnDate);
-
-    // Calculate days overdue (simplified)
-    int daysOverdue = (dueDateTime-returnDateTime)/60/60/24; // Simplified calculation
-    return daysOverdue * daily_fine_rate; // Use global configuration for fine rate
-}
-
-time_t FineCalculator::parseDate(const std::string& dateStr) const{
-    std::tm tm = {};
-    std::istringstream ss(dateStr);
-    ss >> std::get_time(&tm, "%Y-%m-%d");
-    if (ss.fail()) {
-        throw std::runtime_error("Failed to parse date");
-    }
-    // mktime expects tm_isdst to be set, -1 means mktime will attempt to determine whether DST is in effect
-    tm.tm_isdst = -1;
-    return std::mktime(&tm);
-}
-
-LoanManager::LoanManager() : nextTransactionId(1) {
-    fineCalculator = std::make_unique<StandardFineCalculator>();
-}
+LoanManager::LoanManager() : nextTransactionId(1) {}
 
 bool LoanManager::borrowBook(User* user, Book* book) {
+    ScopedLatencyTimer timer(MetricOperation::BorrowBook);
     if (!user || !book || !canUserBorrowBook(user, book)) {
         return false;
     }
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
 
     // Create new transaction
     auto transaction = std::make_unique<LoanTransaction>(
@@ -56,59 +55,99 @@ bool LoanManager::borrowBook(User* user, Book* book) {
         user->getUserId(),
         book->getId(),
         getCurrentDate(),
-        calculateDueDateAndExpiryDate(regular_user_loan_period) // configuration loan period
+        calculateDueDateAndExpiryDate(user->getLoanPeriod()) // loan period of the user's role
     );
 
+    openLoans[loanKey(user->getUserId(), book->getId())] = transaction.get();
+    ++activeLoanCounts[user->getUserId()];
+    trackOpenLoan(*transaction);
+    insertHistory(historyByUser[user->getUserId()], transaction.get());
+    insertHistory(historyByBook[book->getId()], transaction.get());
+    if (!accrual.stale) {
+        accrual.add(loanKey(user->getUserId(), book->getId()), dayNumber(transaction->dueDate),
+                    book->getBookType(), user->getRole(), user->getUserId());
+        ++lastAccrual.openLoans;
+    }
     transactions.push_back(std::move(transaction));
     book->setStatus(BookStatus::Borrowed);
+    for (LoanEventListener* listener : listeners) {
+        listener->onBorrow(*transactions.back(), *book);
+    }
     return true;
 }
 
 bool LoanManager::returnBook(User* user, Book* book) {
+    ScopedLatencyTimer timer(MetricOperation::ReturnBook);
     if (!user || !book) {
         return false;
     }
 
     // Find the loan transaction
-    auto it = std::find_if(transactions.begin(), transactions.end(),
-        [user, book](const auto& transaction) {
-            return transaction->userId == user->getUserId() &&
-                   transaction->bookId == book->getId() &&
-                   !transaction->isReturned;
-        });
-
-    if (it == transactions.end()) {
+    auto it = openLoans.find(loanKey(user->getUserId(), book->getId()));
+    if (it == openLoans.end()) {
         return false;
     }
+    LoanTransaction* loan = it->second;
+    openLoans.erase(it);
+    --activeLoanCounts[user->getUserId()];
+    untrackOpenLoan(*loan);
+    if (!accrual.stale) {
+        // The assessed fine below replaces what had accrued on this loan
+        const long long key = loanKey(user->getUserId(), book->getId());
+        auto row = accrual.rows.find(key);
+        if (row != accrual.rows.end()) {
+            if (accrual.overdue[row->second] && lastAccrual.overdueLoans > 0) {
+                --lastAccrual.overdueLoans;
+            }
+            if (lastAccrual.openLoans > 0) --lastAccrual.openLoans;
+        }
+        double accrued = accrual.remove(key);
+        lastAccrual.accruedTotal -= accrued;
+        user->setAccruedFines(std::max(0.0, user->getAccruedFines() - accrued));
+    }
 
     // Update transaction
-    (*it)->isReturned = true;
-    (*it)->returnDate = getCurrentDate();
+    loan->isReturned = true;
+    loan->returnDate = getCurrentDate();
     
     // Calculate fine if overdue
-    if (isDateOverdue((*it)->dueDate)) {
-        (*it)->fine = fineCalculator->calculateFine((*it)->dueDate, (*it)->returnDate);
-        user->addFine((*it)->fine);
+    int dueDay = dayNumber(loan->dueDate);
+    int returnDay = dayNumber(loan->returnDate);
+    if (dueDay != kInvalidDay && returnDay > dueDay) {
+        const std::shared_ptr<const ConfigSnapshot> settings = config();
+        loan->fine = std::min(settings->fine_policy.fine(book->getBookType(), user->getRole(), returnDay - dueDay),
+                              settings->max_fine);
+        totalFinesAssessed += loan->fine;
+        user->addFine(loan->fine);
     }
 
     book->setStatus(BookStatus::Available);
+    for (LoanEventListener* listener : listeners) {
+        listener->onReturn(*loan, *book);
+    }
 
     // Check if there are reservations for this book
-    auto& queue = reservations[book->getId()];
+    auto reserved = reservations.find(book->getId());
+    if (reserved == reservations.end()) {
+        return true;
+    }
+    auto& queue = reserved->second;
     cleanupExpiredReservations(queue);
-    if (queue.empty()) {
+    if (!queue.empty()) {
         auto& reservation = queue.front();
         std::cout << "Book is now available for user " << reservation.userId << " (next in reservation queue)" << std::endl;
-        reservation.expiryDate = calculateDueDateAndExpiryDate(reservation_period) ; // Update reservation date
+        reservation.expiryDate = calculateDueDateAndExpiryDate(config()->reservation_period) ; // Update reservation date
     }
 
     return true;
 }
 
 bool LoanManager::reserveBook(User* user, Book* book) {
+    ScopedLatencyTimer timer(MetricOperation::ReserveBook);
     if (!user || !book) {
         return false;
     }
+    ScopedMemoryTag tag(MemorySubsystem::Reservations);
 
     // Can only reserve borrowed books
     if (book->getStatus() != BookStatus::Borrowed) {
@@ -145,6 +184,7 @@ bool LoanManager::reserveBook(User* user, Book* book) {
 }
 
 bool LoanManager::payFine(User* user, double amount) {
+    ScopedLatencyTimer timer(MetricOperation::PayFine);
     if (!user || amount <= 0) {
         return false;
     }
@@ -158,26 +198,208 @@ bool LoanManager::payFine(User* user, double amount) {
     return true;
 }
 
+void LoanManager::AccrualTable::add(long long key, int dueDay, BookType bookType, UserRole role, int userId) {
+    rows[key] = static_cast<uint32_t>(keys.size());
+    dueDays.push_back(dueDay == kInvalidDay ? INT_MAX : dueDay); // an unparsable due date never accrues
+    bookTypes.push_back(bookType);
+    roles.push_back(role);
+    userIds.push_back(userId);
+    accrued.push_back(0.0);
+    overdue.push_back(0);
+    keys.push_back(key);
+}
+
+double LoanManager::AccrualTable::remove(long long key) {
+    auto it = rows.find(key);
+    if (it == rows.end()) return 0.0;
+    const uint32_t row = it->second;
+    const uint32_t last = static_cast<uint32_t>(keys.size() - 1);
+    const double removed = accrued[row];
+    // Swap with the last row so the arrays stay dense
+    dueDays[row] = dueDays[last];
+    bookTypes[row] = bookTypes[last];
+    roles[row] = roles[last];
+    userIds[row] = userIds[last];
+    accrued[row] = accrued[last];
+    overdue[row] = overdue[last];
+    keys[row] = keys[last];
+    rows[keys[row]] = row;
+    rows.erase(it);
+    dueDays.pop_back();
+    bookTypes.pop_back();
+    roles.pop_back();
+    userIds.pop_back();
+    accrued.pop_back();
+    overdue.pop_back();
+    keys.pop_back();
+    return removed;
+}
+
+void LoanManager::AccrualTable::clear() {
+    dueDays.clear();
+    bookTypes.clear();
+    roles.clear();
+    userIds.clear();
+    accrued.clear();
+    overdue.clear();
+    keys.clear();
+    rows.clear();
+    stale = true;
+}
+
+void LoanManager::fillAccrualTable(const std::vector<std::unique_ptr<Book>>& books,
+                                   const std::vector<std::unique_ptr<User>>& users) {
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    std::unordered_map<int, BookType> bookTypes;
+    bookTypes.reserve(books.size());
+    for (const auto& book : books) bookTypes[book->getId()] = book->getBookType();
+    std::unordered_map<int, UserRole> roles;
+    roles.reserve(users.size());
+    for (const auto& user : users) roles[user->getUserId()] = user->getRole();
+
+    accrual.clear();
+    accrual.rows.reserve(openLoans.size());
+    for (const auto& [key, loan] : openLoans) {
+        // Loans of books or users that no longer exist are charged as a regular user's textbook
+        auto type = bookTypes.find(loan->bookId);
+        auto role = roles.find(loan->userId);
+        accrual.add(key, dayNumber(loan->dueDate),
+                    type == bookTypes.end() ? BookType::TextBook : type->second,
+                    role == roles.end() ? UserRole::Regular : role->second, loan->userId);
+    }
+    accrual.stale = false;
+}
+
+FineAccrualSummary LoanManager::accrueFines(const std::vector<std::unique_ptr<Book>>& books,
+                                            const std::vector<std::unique_ptr<User>>& users) {
+    ScopedTraceSpan span("LoanManager::accrueFines");
+    auto start = std::chrono::steady_clock::now();
+    if (accrual.stale) fillAccrualTable(books, users);
+
+    // One snapshot for the whole pass; each fine is a lookup in its policy table
+    const uint64_t generation = configGeneration();
+    const std::shared_ptr<const ConfigSnapshot> settings = config();
+    const FinePolicy& policy = settings->fine_policy;
+    const double maxFine = settings->max_fine;
+    const size_t count = accrual.keys.size();
+    const int today = todayDayNumber();
+    const int32_t* dueDays = accrual.dueDays.data();
+    const BookType* bookTypes = accrual.bookTypes.data();
+    const UserRole* roles = accrual.roles.data();
+    double* accrued = accrual.accrued.data();
+    uint8_t* overdue = accrual.overdue.data();
+
+    struct Totals {
+        size_t overdue = 0;
+        double fines = 0.0;
+    };
+    Totals totals = parallelReduce(size_t(0), count, kParallelGrain, Totals{},
+        [&](size_t lo, size_t hi) {
+            Totals partial;
+            for (size_t i = lo; i < hi; ++i) {
+                int daysLate = std::max(today - dueDays[i], 0);
+                double fine = std::min(policy.fine(bookTypes[i], roles[i], daysLate), maxFine);
+                accrued[i] = fine;
+                overdue[i] = daysLate > 0;
+                partial.overdue += daysLate > 0;
+                partial.fines += fine;
+            }
+            return partial;
+        },
+        [](Totals a, const Totals& b) {
+            a.overdue += b.overdue;
+            a.fines += b.fines;
+            return a;
+        });
+
+    // User ids are small and dense, so the balances are summed in a flat array
+    int maxUserId = 0;
+    for (const auto& user : users) maxUserId = std::max(maxUserId, user->getUserId());
+    std::vector<double> balances(static_cast<size_t>(maxUserId) + 1, 0.0);
+    const int32_t* userIds = accrual.userIds.data();
+    for (size_t i = 0; i < count; ++i) {
+        if (userIds[i] >= 0 && userIds[i] <= maxUserId) balances[userIds[i]] += accrued[i];
+    }
+    for (const auto& user : users) {
+        user->setAccruedFines(user->getUserId() >= 0 ? balances[user->getUserId()] : 0.0);
+    }
+
+    FineAccrualSummary summary;
+    summary.openLoans = count;
+    summary.overdueLoans = totals.overdue;
+    summary.accruedTotal = totals.fines;
+    summary.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    lastAccrual = summary;
+    lastAccrualDay = today;
+    lastAccrualConfig = generation;
+    return summary;
+}
+
+double LoanManager::accrualFine(const ConfigSnapshot& settings, uint32_t row, int today) const {
+    const int daysLate = std::max(today - accrual.dueDays[row], 0);
+    return std::min(settings.fine_policy.fine(accrual.bookTypes[row], accrual.roles[row], daysLate), settings.max_fine);
+}
+
+bool LoanManager::accrueUserFines(User* user) {
+    if (!user || accrual.stale) return false;
+    const std::shared_ptr<const ConfigSnapshot> settings = config();
+    const int today = todayDayNumber();
+    double balance = 0.0;
+    // Open loans are always in the hot tier
+    auto history = historyByUser.find(user->getUserId());
+    if (history != historyByUser.end()) {
+        for (const LoanTransaction* loan : history->second) {
+            if (loan->isReturned) continue;
+            auto row = accrual.rows.find(loanKey(loan->userId, loan->bookId));
+            if (row == accrual.rows.end()) continue;
+            const double fine = accrualFine(*settings, row->second, today);
+            const uint8_t late = accrual.dueDays[row->second] < today;
+            lastAccrual.accruedTotal += fine - accrual.accrued[row->second];
+            if (late && !accrual.overdue[row->second]) {
+                ++lastAccrual.overdueLoans;
+            } else if (!late && accrual.overdue[row->second] && lastAccrual.overdueLoans > 0) {
+                --lastAccrual.overdueLoans;
+            }
+            accrual.accrued[row->second] = fine;
+            accrual.overdue[row->second] = late;
+            balance += fine;
+        }
+    }
+    user->setAccruedFines(balance);
+    return true;
+}
+
+FineAccrualSummary LoanManager::currentFineAccrual(const std::vector<std::unique_ptr<Book>>& books,
+                                                   const std::vector<std::unique_ptr<User>>& users) {
+    if (accrual.stale || lastAccrualDay != todayDayNumber() || lastAccrualConfig != configGeneration()) {
+        return accrueFines(books, users);
+    }
+    return lastAccrual;
+}
+
+double LoanManager::currentFine(const LoanTransaction& loan) const {
+    if (loan.isReturned || accrual.stale) return loan.fine;
+    auto row = accrual.rows.find(loanKey(loan.userId, loan.bookId));
+    if (row == accrual.rows.end()) return loan.fine;
+    return accrualFine(*config(), row->second, todayDayNumber());
+}
+
 bool LoanManager::isDateOverdue(const std::string& dueDate) const {
     return getCurrentDate() > dueDate;
 }
 
-void LoanManager::printOverdueBooks() const {
-    std::cout << "\n=== Overdue Books ===" << std::endl;
-    bool found = false;
-    
-    for (const auto& transaction : transactions) {
-        if (!transaction->isReturned && isDateOverdue(transaction->dueDate)) {
-            std::cout << "Book ID: " << transaction->bookId
-                     << ", User ID: " << transaction->userId
-                     << ", Due Date: " << transaction->dueDate
-                     << ", Fine: $" << transaction->fine << std::endl;
-            found = true;
-        }
+void LoanManager::printOverdueBooks(ReportFormat format, int fd) const {
+    static const std::vector<ReportColumn> columns = {
+        {"book_id", "Book ID: "}, {"user_id", "User ID: "}, {"due_date", "Due Date: "}, {"fine", "Fine: $"}};
+    ReportWriter out(fd, format, columns);
+    out.text("\n=== Overdue Books ===\n");
+    for (const LoanTransaction* transaction : getOverdueTransactions()) {
+        out.field(transaction->bookId).field(transaction->userId).field(transaction->dueDate)
+           .field(currentFine(*transaction));
+        out.endRow();
     }
-    
-    if (!found) {
-        std::cout << "No overdue books found." << std::endl;
+    if (out.getRowCount() == 0) {
+        out.text("No overdue books found.\n");
     }
 }
 
@@ -190,7 +412,7 @@ void LoanManager::printUserLoans(int userId) const {
             std::cout << "Book ID: " << transaction->bookId
                      << ", Borrowed: " << transaction->borrowDate
                      << ", Due: " << transaction->dueDate
-                     << ", Fine: $" << transaction->fine << std::endl;
+                     << ", Fine: $" << currentFine(*transaction) << std::endl;
             found = true;
         }
     }
@@ -224,23 +446,17 @@ void LoanManager::printUserReservations(int userId) {
     }
 }
 
-void LoanManager::printAllLoans() const {
-    std::cout << "\n=== All Current Loans ===" << std::endl;
-    bool found = false;
-    
+void LoanManager::printAllLoans(ReportFormat format, int fd) const {
+    ReportWriter out(fd, format, loanReportColumns());
+    out.text("\n=== All Current Loans ===\n");
     for (const auto& transaction : transactions) {
         if (!transaction->isReturned) {
-            std::cout << "User ID: " << transaction->userId
-                     << ", Book ID: " << transaction->bookId
-                     << ", Borrowed: " << transaction->borrowDate
-                     << ", Due: " << transaction->dueDate
-                     << ", Fine: $" << transaction->fine << std::endl;
-            found = true;
+            renderLoan(out, *transaction);
+            out.endRow();
         }
     }
-    
-    if (!found) {
-        std::cout << "No current loans." << std::endl;
+    if (out.getRowCount() == 0) {
+        out.text("No current loans.\n");
     }
 }
 
@@ -270,28 +486,485 @@ void LoanManager::printAllReservations() {
     }
 }
 
+const std::vector<ReportColumn>& LoanManager::loanReportColumns() {
+    static const std::vector<ReportColumn> columns = {
+        {"user_id", "User ID: "}, {"book_id", "Book ID: "}, {"borrow_date", "Borrowed: "},
+        {"due_date", "Due: "}, {"fine", "Fine: $"}};
+    return columns;
+}
+
+void LoanManager::renderLoan(ReportWriter& out, const LoanTransaction& loan) const {
+    out.field(loan.userId).field(loan.bookId).field(loan.borrowDate).field(loan.dueDate).field(currentFine(loan));
+}
+
+const std::vector<ReportColumn>& LoanManager::reservationReportColumns() {
+    static const std::vector<ReportColumn> columns = {
+        {"book_id", "Book ID: "}, {"position", "Position: "}, {"user_id", "User ID: "},
+        {"reserved", "Reserved: "}, {"expires", "Expires: "}};
+    return columns;
+}
+
+void LoanManager::renderReservation(ReportWriter& out, const ReservationEntry& entry) {
+    const Reservation& reservation = entry.reservation;
+    out.field(reservation.bookId).field(entry.position).field(reservation.userId)
+       .field(reservation.reservationDate);
+    if (reservation.expiryDate.empty()) out.skip();
+    else out.field(reservation.expiryDate);
+}
+
+// Clamps a cursor to the (int, int) keys of the loan indexes
+static std::pair<int, int> intKey(const PageCursor& cursor) {
+    auto clamp = [](long long value) {
+        return static_cast<int>(std::max<long long>(INT_MIN, std::min<long long>(INT_MAX, value)));
+    };
+    return {clamp(cursor.major), clamp(cursor.minor)};
+}
+
+Page<const LoanTransaction*> LoanManager::duePage(const PageCursor& after, size_t limit, bool overdueOnly) const {
+    Page<const LoanTransaction*> page;
+    const int today = todayDayNumber();
+    auto it = after.atStart() ? openLoansByDue.begin() : openLoansByDue.upper_bound(intKey(after));
+    // Unparsable due dates sort first and are never overdue
+    if (overdueOnly && it != openLoansByDue.end() && it->first.first == kInvalidDay) {
+        it = openLoansByDue.lower_bound({kInvalidDay + 1, INT_MIN});
+    }
+    auto inPage = [&](decltype(it) entry) {
+        return entry != openLoansByDue.end() && (!overdueOnly || entry->first.first < today);
+    };
+    for (; inPage(it) && page.items.size() < limit; ++it) {
+        page.items.push_back(it->second);
+        page.next = PageCursor{it->first.first, it->first.second};
+    }
+    page.more = inPage(it);
+    if (page.items.empty()) page.next = after;
+    return page;
+}
+
+Page<const LoanTransaction*> LoanManager::loansPage(const PageCursor& after, size_t limit) const {
+    return duePage(after, limit, false);
+}
+
+Page<const LoanTransaction*> LoanManager::overduePage(const PageCursor& after, size_t limit) const {
+    return duePage(after, limit, true);
+}
+
+Page<ReservationEntry> LoanManager::reservationsPage(const PageCursor& after, size_t limit) const {
+    Page<ReservationEntry> page;
+    const std::string today = getCurrentDate();
+    auto book = after.atStart() ? reservations.begin() : reservations.lower_bound(intKey(after).first);
+    std::vector<ReservationEntry> queued;
+    // One extra row is looked for, to tell whether another page follows
+    while (book != reservations.end() && page.items.size() <= limit) {
+        // Queues are short, so each one is copied and ordered by user id
+        queued.clear();
+        std::queue<Reservation> queue = book->second;
+        for (int position = 1; !queue.empty(); queue.pop()) {
+            const Reservation& reservation = queue.front();
+            if (!reservation.expiryDate.empty() && today > reservation.expiryDate) continue;
+            queued.push_back(ReservationEntry{reservation, position++});
+        }
+        std::sort(queued.begin(), queued.end(), [](const ReservationEntry& a, const ReservationEntry& b) {
+            return a.reservation.userId < b.reservation.userId;
+        });
+        for (const ReservationEntry& entry : queued) {
+            if (!after.atStart() && book->first == after.major && entry.reservation.userId <= after.minor) continue;
+            if (page.items.size() == limit) {
+                page.more = true;
+                break;
+            }
+            page.items.push_back(entry);
+            page.next = PageCursor{book->first, entry.reservation.userId};
+        }
+        if (page.more) break;
+        ++book;
+    }
+    if (page.items.empty()) page.next = after;
+    return page;
+}
+
+Page<LoanTransaction> LoanManager::userHistoryPage(int userId, const PageCursor& after, size_t limit) const {
+    Page<LoanTransaction> page;
+    const std::pair<int, int> start = intKey(after);   // a default cursor is before every loan
+
+    // Both tiers are read from the cursor on, one row past the page to tell whether there is more
+    std::vector<LoanTransaction> coldLoans;
+    if (cold.size() > 0) {
+        const bool indexed = coldIndex.matches(cold.size(), cold.maxTransactionId(), cold.totalFines()) &&
+                             coldIndex.findAfter(LoanHistoryTree::Key::User, userId, start.first, start.second,
+                                                 limit + 1, coldLoans);
+        if (!indexed) {
+            coldLoans = cold.userLoans(userId);
+            coldLoans.erase(std::remove_if(coldLoans.begin(), coldLoans.end(),
+                                           [&](const LoanTransaction& loan) { return historyKey(loan) <= start; }),
+                            coldLoans.end());
+            std::sort(coldLoans.begin(), coldLoans.end(), [](const LoanTransaction& a, const LoanTransaction& b) {
+                return historyKey(a) < historyKey(b);
+            });
+            if (coldLoans.size() > limit + 1) {
+                coldLoans.erase(coldLoans.begin() + static_cast<std::ptrdiff_t>(limit + 1), coldLoans.end());
+            }
+        }
+    }
+    static const std::vector<const LoanTransaction*> noLoans;
+    auto history = historyByUser.find(userId);
+    const std::vector<const LoanTransaction*>& hotLoans = history == historyByUser.end() ? noLoans : history->second;
+
+    auto coldIt = coldLoans.begin();
+    auto hotIt = std::upper_bound(hotLoans.begin(), hotLoans.end(), start,
+                                  [](const std::pair<int, int>& key, const LoanTransaction* loan) {
+                                      return key < historyKey(*loan);
+                                  });
+    while ((coldIt != coldLoans.end() || hotIt != hotLoans.end()) && page.items.size() < limit) {
+        const bool fromCold = hotIt == hotLoans.end() ||
+                              (coldIt != coldLoans.end() && historyKey(*coldIt) < historyKey(**hotIt));
+        page.items.push_back(fromCold ? *coldIt++ : **hotIt++);
+        const std::pair<int, int> key = historyKey(page.items.back());
+        page.next = PageCursor{key.first, key.second};
+    }
+    page.more = coldIt != coldLoans.end() || hotIt != hotLoans.end();
+    if (page.items.empty()) page.next = after;
+    return page;
+}
+
+bool LoanManager::openColdHistory(const std::string& filename, const std::string& indexFilename) {
+    coldHistoryFile = filename;
+    coldIndexFile = indexFilename;
+    const bool opened = cold.open(filename);
+    if (cold.size() > 0 &&
+        (!coldIndex.open(coldIndexFile, static_cast<size_t>(std::max(1, config()->history_cache_pages))) ||
+         !coldIndex.matches(cold.size(), cold.maxTransactionId(), cold.totalFines()))) {
+        rebuildColdIndex();
+    }
+    return opened;
+}
+
+// Without a usable index the lookups fall back to the segment's own directories
+void LoanManager::rebuildColdIndex() {
+    coldIndex.close();
+    if (coldIndexFile.empty()) return;
+    std::vector<LoanTransaction> coldLoans;
+    coldLoans.reserve(cold.size());
+    cold.forEach([&coldLoans](const LoanTransaction& loan) { coldLoans.push_back(loan); });
+    if (coldLoans.size() != cold.size()) return;
+    if (LoanHistoryTree::build(coldIndexFile, std::move(coldLoans), cold.maxTransactionId(), cold.totalFines())) {
+        coldIndex.open(coldIndexFile, static_cast<size_t>(std::max(1, config()->history_cache_pages)));
+    }
+}
+
+size_t LoanManager::tierHistory(int maxAgeDays) {
+    if (coldHistoryFile.empty() || maxAgeDays <= 0) return 0;
+    ScopedTraceSpan span("LoanManager::tierHistory");
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    const int cutoff = todayDayNumber() - maxAgeDays;
+    auto goesCold = [cutoff](const std::unique_ptr<LoanTransaction>& t) {
+        return ColdLoanSegment::encodable(*t) && dayNumber(t->returnDate) < cutoff;
+    };
+    const size_t moving = static_cast<size_t>(std::count_if(transactions.begin(), transactions.end(), goesCold));
+    if (moving == 0) return 0;
+
+    // The segment is rewritten whole with the loans it already had
+    std::vector<LoanTransaction> coldLoans;
+    coldLoans.reserve(cold.size() + moving);
+    cold.forEach([&coldLoans](const LoanTransaction& loan) { coldLoans.push_back(loan); });
+    if (coldLoans.size() != cold.size()) return 0; // damaged; keep everything where it is
+    for (const auto& t : transactions) {
+        if (goesCold(t)) coldLoans.push_back(*t);
+    }
+    if (!ColdLoanSegment::write(coldHistoryFile, std::move(coldLoans)) || !cold.open(coldHistoryFile)) {
+        return 0;
+    }
+    transactions.erase(std::remove_if(transactions.begin(), transactions.end(), goesCold), transactions.end());
+    rebuildHistoryIndexes();
+    rebuildColdIndex();
+    return moving;
+}
+
+LoanHistory LoanManager::fullHistory(std::vector<LoanTransaction>& coldCopies) const {
+    coldCopies.clear();
+    coldCopies.reserve(cold.size());
+    cold.forEach([&coldCopies](const LoanTransaction& loan) { coldCopies.push_back(loan); });
+    LoanHistory history;
+    history.reserve(coldCopies.size() + transactions.size());
+    for (const LoanTransaction& loan : coldCopies) history.push_back(&loan);
+    for (const auto& t : transactions) history.push_back(t.get());
+    auto byId = [](const LoanTransaction* a, const LoanTransaction* b) { return a->transactionId < b->transactionId; };
+    if (!std::is_sorted(history.begin(), history.end(), byId)) {
+        std::sort(history.begin(), history.end(), byId);
+    }
+    return history;
+}
+
+std::vector<LoanTransaction> LoanManager::transactionHistory(LoanHistoryTree::Key key, int id, const std::string& from,
+                                                             const std::string& to) const {
+    std::vector<LoanTransaction> loans;
+    const int fromDay = from.empty() ? INT_MIN : dayNumber(from);
+    const int toDay = to.empty() ? INT_MAX : dayNumber(to);
+    if ((!from.empty() && fromDay == kInvalidDay) || (!to.empty() && toDay == kInvalidDay)) return loans;
+    auto borrowedInRange = [fromDay, toDay](const LoanTransaction& loan) {
+        const int day = dayNumber(loan.borrowDate);   // kInvalidDay (INT_MIN) only passes without a lower limit
+        return fromDay <= day && day <= toDay;
+    };
+    const bool byUser = key == LoanHistoryTree::Key::User;
+
+    // Cold loans come back from the index already in order
+    if (cold.size() > 0) {
+        const bool indexed = coldIndex.matches(cold.size(), cold.maxTransactionId(), cold.totalFines()) &&
+                             coldIndex.find(key, id, fromDay, toDay, loans);
+        if (!indexed) {
+            loans = byUser ? cold.userLoans(id) : cold.bookLoans(id);
+            loans.erase(std::remove_if(loans.begin(), loans.end(),
+                                       [&](const LoanTransaction& loan) { return !borrowedInRange(loan); }),
+                        loans.end());
+        }
+    }
+    const size_t coldCount = loans.size();
+
+    const auto& hotIndex = byUser ? historyByUser : historyByBook;
+    auto history = hotIndex.find(id);
+    if (history != hotIndex.end()) {
+        for (const LoanTransaction* loan : history->second) {
+            if (borrowedInRange(*loan)) loans.push_back(*loan);
+        }
+    }
+
+    auto byBorrowDay = [](const LoanTransaction& a, const LoanTransaction& b) {
+        return std::make_pair(dayNumber(a.borrowDate), a.transactionId) <
+               std::make_pair(dayNumber(b.borrowDate), b.transactionId);
+    };
+    if (coldCount == 0 || coldCount == loans.size()) {
+        if (!std::is_sorted(loans.begin(), loans.end(), byBorrowDay)) {
+            std::sort(loans.begin(), loans.end(), byBorrowDay);
+        }
+    } else {
+        std::sort(loans.begin() + coldCount, loans.end(), byBorrowDay);
+        std::inplace_merge(loans.begin(), loans.begin() + coldCount, loans.end(), byBorrowDay);
+    }
+    return loans;
+}
+
+std::vector<LoanTransaction> LoanManager::getUserTransactions(int userId, const std::string& from,
+                                                              const std::string& to) const {
+    return transactionHistory(LoanHistoryTree::Key::User, userId, from, to);
+}
+
+std::vector<LoanTransaction> LoanManager::getBookTransactions(int bookId, const std::string& from,
+                                                              const std::string& to) const {
+    return transactionHistory(LoanHistoryTree::Key::Book, bookId, from, to);
+}
+
+void LoanManager::printTransactionHistory(int userId, ReportFormat format, int fd) const {
+    static const std::vector<ReportColumn> columns = {
+        {"transaction_id", "Loan #"}, {"book_id", "Book ID: "}, {"borrow_date", "Borrowed: "},
+        {"due_date", "Due: "}, {"return_date", "Returned: "}, {"fine", "Fine: $"}};
+    ReportWriter out(fd, format, columns);
+    out.text("\n=== Loan History ===\n");
+    for (const LoanTransaction& loan : getUserTransactions(userId)) {
+        out.field(loan.transactionId).field(loan.bookId).field(loan.borrowDate).field(loan.dueDate)
+           .field(loan.returnDate).field(loan.fine);
+        out.endRow();
+    }
+    if (out.getRowCount() == 0) {
+        out.text("No loans.\n");
+    }
+}
+
 int LoanManager::getTotalLoans() const {
-    return transactions.size();
+    return transactions.size() + cold.size();
 }
 
 int LoanManager::getActiveLoans() const {
-    return std::count_if(transactions.begin(), transactions.end(),
-        [](const auto& transaction) { return !transaction->isReturned; });
+    return openLoans.size();
 }
 
 int LoanManager::getOverdueCount() const {
-    return std::count_if(transactions.begin(), transactions.end(),
-        [this](const auto& transaction) {
-            return !transaction->isReturned && isDateOverdue(transaction->dueDate);
-        });
+    refreshOverdueCount();
+    return overdueLoans;
 }
 
 double LoanManager::getTotalFines() const {
-    double total = 0.0;
-    for (const auto& transaction : transactions) {
-        total += transaction->fine;
+    return totalFinesAssessed;
+}
+
+void LoanManager::trackOpenLoan(const LoanTransaction& loan) {
+    ++openLoansByDueDate[loan.dueDate];
+    openLoansByDue.emplace(std::make_pair(dayNumber(loan.dueDate), loan.transactionId), &loan);
+    if (!overdueAsOf.empty() && overdueAsOf > loan.dueDate) ++overdueLoans;
+}
+
+void LoanManager::untrackOpenLoan(const LoanTransaction& loan) {
+    openLoansByDue.erase(std::make_pair(dayNumber(loan.dueDate), loan.transactionId));
+    auto it = openLoansByDueDate.find(loan.dueDate);
+    if (it != openLoansByDueDate.end() && --it->second == 0) {
+        openLoansByDueDate.erase(it);
+    }
+    if (!overdueAsOf.empty() && overdueAsOf > loan.dueDate) --overdueLoans;
+}
+
+void LoanManager::refreshOverdueCount() const {
+    // Loans only become overdue when the date changes, so the count is
+    // advanced over the due dates passed since the last call
+    const std::string today = getCurrentDate();
+    if (today == overdueAsOf) return;
+
+    auto it = openLoansByDueDate.begin();
+    if (overdueAsOf.empty() || today < overdueAsOf) {
+        overdueLoans = 0; // first call, or the clock went back
+    } else {
+        it = openLoansByDueDate.lower_bound(overdueAsOf);
+    }
+    for (; it != openLoansByDueDate.end() && it->first < today; ++it) {
+        overdueLoans += it->second;
     }
-    return total;
+    overdueAsOf = today;
+}
+
+LoanStatistics LoanManager::getStatistics() const {
+    ScopedLatencyTimer timer(MetricOperation::Statistics);
+    LoanStatistics stats;
+    stats.totalLoans = getTotalLoans();
+    stats.activeLoans = getActiveLoans();
+    stats.overdueCount = getOverdueCount();
+    stats.totalFines = getTotalFines();
+    return stats;
+}
+
+bool LoanManager::checkStatistics(std::ostream& out) const {
+    LoanStatistics counted = getStatistics();
+    LoanStatistics scanned = computeStatistics();
+    bool consistent = true;
+    auto compare = [&out, &consistent](const char* name, double counter, double scan) {
+        // Fines are summed in a different order, so allow for rounding
+        if (std::abs(counter - scan) > 1e-6 * std::max(1.0, std::abs(scan))) {
+            out << "Statistics mismatch: " << name << " counter=" << counter << " scan=" << scan << std::endl;
+            consistent = false;
+        }
+    };
+    compare("totalLoans", counted.totalLoans, scanned.totalLoans);
+    compare("activeLoans", counted.activeLoans, scanned.activeLoans);
+    compare("overdueCount", counted.overdueCount, scanned.overdueCount);
+    compare("totalFines", counted.totalFines, scanned.totalFines);
+    return consistent;
+}
+
+LoanStatistics LoanManager::computeStatistics() const {
+    ScopedTraceSpan span("LoanManager::computeStatistics");
+    const std::string today = getCurrentDate();
+    LoanStatistics stats = parallelReduce(size_t(0), transactions.size(), kParallelGrain, LoanStatistics{},
+        [this, &today](size_t lo, size_t hi) {
+            LoanStatistics partial;
+            for (size_t i = lo; i < hi; ++i) {
+                const LoanTransaction& t = *transactions[i];
+                if (!t.isReturned) {
+                    ++partial.activeLoans;
+                    if (today > t.dueDate) ++partial.overdueCount;
+                }
+                partial.totalFines += t.fine;
+            }
+            return partial;
+        },
+        [](LoanStatistics a, const LoanStatistics& b) {
+            a.activeLoans += b.activeLoans;
+            a.overdueCount += b.overdueCount;
+            a.totalFines += b.totalFines;
+            return a;
+        });
+    stats.totalLoans = transactions.size() + cold.size();
+    cold.forEach([&stats](const LoanTransaction& loan) { stats.totalFines += loan.fine; });
+    return stats;
+}
+
+std::vector<LoanTransaction*> LoanManager::getOverdueTransactions() const {
+    ScopedLatencyTimer timer(MetricOperation::OverdueScan);
+    ScopedTraceSpan span("LoanManager::getOverdueTransactions");
+    // Only open loans can be overdue, so walk the open-loan index instead of the history
+    const std::string today = getCurrentDate();
+    std::vector<LoanTransaction*> overdue;
+    for (const auto& entry : openLoans) {
+        if (today > entry.second->dueDate) overdue.push_back(entry.second);
+    }
+    std::sort(overdue.begin(), overdue.end(), [](const LoanTransaction* a, const LoanTransaction* b) {
+        return a->transactionId < b->transactionId;
+    });
+    return overdue;
+}
+
+long long LoanManager::loanKey(int userId, int bookId) {
+    return (static_cast<long long>(userId) << 32) | static_cast<unsigned int>(bookId);
+}
+
+void LoanManager::rebuildIndexes() {
+    ScopedTraceSpan span("LoanManager::rebuildIndexes");
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    // A crash after tiering but before the next save leaves the moved loans in
+    // the file as well; the cold copies win
+    if (cold.size() > 0) {
+        transactions.erase(std::remove_if(transactions.begin(), transactions.end(),
+            [this](const std::unique_ptr<LoanTransaction>& t) {
+                return t->isReturned && cold.contains(t->bookId, t->transactionId);
+            }), transactions.end());
+    }
+    // Collect open loans, the highest id and the fine total in parallel, then fill the maps
+    struct Scan {
+        std::vector<LoanTransaction*> open;
+        int maxId = 0;
+        double fines = 0.0;
+    };
+    Scan scan = parallelReduce(size_t(0), transactions.size(), kParallelGrain, Scan{},
+        [this](size_t lo, size_t hi) {
+            Scan partial;
+            for (size_t i = lo; i < hi; ++i) {
+                LoanTransaction* t = transactions[i].get();
+                if (!t->isReturned) partial.open.push_back(t);
+                partial.maxId = std::max(partial.maxId, t->transactionId);
+                partial.fines += t->fine;
+            }
+            return partial;
+        },
+        [](Scan a, Scan b) {
+            a.open.insert(a.open.end(), b.open.begin(), b.open.end());
+            a.maxId = std::max(a.maxId, b.maxId);
+            a.fines += b.fines;
+            return a;
+        });
+
+    openLoans.clear();
+    activeLoanCounts.clear();
+    openLoansByDueDate.clear();
+    openLoansByDue.clear();
+    overdueAsOf.clear();
+    overdueLoans = 0;
+    openLoans.reserve(scan.open.size());
+    for (LoanTransaction* t : scan.open) {
+        openLoans[loanKey(t->userId, t->bookId)] = t;
+        ++activeLoanCounts[t->userId];
+        trackOpenLoan(*t);
+    }
+    rebuildHistoryIndexes();
+    totalFinesAssessed = scan.fines + cold.totalFines();
+    accrual.clear();
+    // Loaded ids (of either tier) must never be handed out again
+    nextTransactionId = std::max({nextTransactionId, scan.maxId + 1, cold.maxTransactionId() + 1});
+}
+
+void LoanManager::rebuildHistoryIndexes() {
+    historyByUser.clear();
+    historyByBook.clear();
+    for (const auto& t : transactions) {
+        historyByUser[t->userId].push_back(t.get());
+        historyByBook[t->bookId].push_back(t.get());
+    }
+    // The file is written in id order, which is nearly always borrow order too
+    for (auto* index : {&historyByUser, &historyByBook}) {
+        for (auto& entry : *index) {
+            if (!std::is_sorted(entry.second.begin(), entry.second.end(), historyBefore)) {
+                std::stable_sort(entry.second.begin(), entry.second.end(), historyBefore);
+            }
+        }
+    }
+}
+
+void LoanManager::addListener(LoanEventListener* listener) {
+    listeners.push_back(listener);
 }
 
 std::string LoanManager::getCurrentDate() const {
@@ -333,7 +1006,8 @@ void LoanManager::cleanupExpiredReservations(std::queue<Reservation>& queue) {
         std::queue<Reservation> activeQueue;
         while (!queue.empty()) {
             Reservation res = queue.front();
-            if (currentDate <= res.expiryDate) {
+            // No expiry yet means the reservation is still waiting for the book
+            if (res.expiryDate.empty() || currentDate <= res.expiryDate) {
                 activeQueue.push(res);
             }
             queue.pop();
@@ -344,8 +1018,6 @@ void LoanManager::cleanupExpiredReservations(std::queue<Reservation>& queue) {
 int LoanManager::getCurrentLoansCount(const User* user) const {
     if (!user) return 0;
     
-    return std::count_if(transactions.begin(), transactions.end(),
-        [user](const auto& transaction) {
-            return transaction->userId == user->getUserId() && !transaction->isReturned;
-        });
+    auto it = activeLoanCounts.find(user->getUserId());
+    return it == activeLoanCounts.end() ? 0 : it->second;
 }
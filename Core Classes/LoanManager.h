@@ -5,9 +5,16 @@
 #include <memory>
 #include <map>
 #include <queue>
+#include <unordered_map>
+#include <climits>
+#include <cstdint>
 #include <ctime>
+#include <ostream>
 #include "Book.h"
 #include "User.h"
+#include "Paging.h"
+#include "ColdLoanSegment.h"
+#include "LoanHistoryTree.h"
 
 // Forward declarations
 class Book;
@@ -27,6 +34,9 @@ struct LoanTransaction {
     LoanTransaction(int transId, int uId, int bId, const std::string& borrow, const std::string& due);
 };
 
+// Loans of both history tiers, for rebuilding the analytics
+using LoanHistory = std::vector<const LoanTransaction*>;
+
 // Reservation record
 struct Reservation {
     int userId;
@@ -39,38 +49,101 @@ struct Reservation {
 
 };
 
-// Fine calculation strategy (Strategy Pattern)
-class FineCalculator {
+// Observer for loan events, used to keep analytics up to date without
+// rescanning the history. Called synchronously from borrowBook/returnBook.
+class LoanEventListener {
 public:
+    virtual ~LoanEventListener() = default;
+    virtual void onBorrow(const LoanTransaction& loan, const Book& book) = 0;
+    virtual void onReturn(const LoanTransaction&, const Book&) {}
+};
 
-    virtual ~FineCalculator() = default;
-    virtual double calculateFine(const std::string& dueDate, const std::string& returnDate) = 0;
-    //helper
-    time_t parseDate(const std::string& dateStr) const;
+// A reservation with its place in the book's queue (1 = next in line)
+struct ReservationEntry {
+    Reservation reservation;
+    int position;
 };
 
-class StandardFineCalculator : public FineCalculator {
-public:
-    StandardFineCalculator() {}
-    double calculateFine(const std::string& dueDate, const std::string& returnDate) override;
+// Aggregate figures shown on the reports screen
+struct LoanStatistics {
+    int totalLoans = 0;
+    int activeLoans = 0;
+    int overdueCount = 0;
+    double totalFines = 0.0;
 };
 
-class BookTypeFineCalculator : public FineCalculator {
-private:
-    std::map<std::string, double> rates;
-public:
-    BookTypeFineCalculator();
-    double calculateFine(const std::string& dueDate, const std::string& returnDate) override;
-    void setRate(const std::string& bookType, double rate);
+// Result of an accrual pass
+struct FineAccrualSummary {
+    size_t openLoans = 0;
+    size_t overdueLoans = 0;
+    double accruedTotal = 0.0;
+    double elapsedMs = 0.0;
 };
 
 // Main Loan Manager Class
 class LoanManager {
 private:
-    std::vector<std::unique_ptr<LoanTransaction>> transactions;
+    std::vector<std::unique_ptr<LoanTransaction>> transactions;    // hot tier: open and recent loans
+    ColdLoanSegment cold;                                           // cold tier: older returned loans
+    std::string coldHistoryFile;
+    LoanHistoryTree coldIndex;                                      // cold tier by user and by book, on disk
+    std::string coldIndexFile;
     std::map<int, std::queue<Reservation>> reservations; // bookId -> queue of reservations
-    std::unique_ptr<FineCalculator> fineCalculator;
     int nextTransactionId;
+    std::vector<LoanEventListener*> listeners;
+
+    // Indexes over open loans, kept in sync by borrowBook/returnBook
+    std::unordered_map<int, int> activeLoanCounts;              // userId -> open loans
+    std::unordered_map<long long, LoanTransaction*> openLoans;  // (userId, bookId) -> open loan
+    static long long loanKey(int userId, int bookId);
+
+    // Running statistics, kept in sync by borrowBook/returnBook and rebuilt by rebuildIndexes
+    double totalFinesAssessed = 0.0;
+    std::map<std::string, int> openLoansByDueDate;  // dueDate -> open loans
+    mutable std::string overdueAsOf;                // date overdueLoans was counted for ("" = not yet)
+    mutable int overdueLoans = 0;
+    void trackOpenLoan(const LoanTransaction& loan);
+    void untrackOpenLoan(const LoanTransaction& loan);
+    void refreshOverdueCount() const;
+
+    // Keyset-pagination indexes, kept in sync by borrowBook/returnBook and rebuilt by rebuildIndexes
+    std::map<std::pair<int, int>, const LoanTransaction*> openLoansByDue;     // (due day, transactionId)
+    std::unordered_map<int, std::vector<const LoanTransaction*>> historyByUser; // by (borrow day, transactionId)
+    std::unordered_map<int, std::vector<const LoanTransaction*>> historyByBook; // by (borrow day, transactionId)
+    Page<const LoanTransaction*> duePage(const PageCursor& after, size_t limit, bool overdueOnly) const;
+    void rebuildHistoryIndexes();
+    void rebuildColdIndex();
+    std::vector<LoanTransaction> transactionHistory(LoanHistoryTree::Key key, int id, const std::string& from,
+                                                    const std::string& to) const;
+
+    // Open loans as flat arrays for the fine accrual pass, kept in sync by
+    // borrowBook/returnBook. Loaded loans only get a row on the first pass,
+    // since book types and user roles are not known until then.
+    struct AccrualTable {
+        std::vector<int32_t> dueDays;       // DayNumber.h day numbers
+        std::vector<BookType> bookTypes;
+        std::vector<UserRole> roles;
+        std::vector<int32_t> userIds;
+        std::vector<double> accrued;        // as of the last pass
+        std::vector<uint8_t> overdue;       // as of the last pass
+        std::vector<long long> keys;        // loanKey
+        std::unordered_map<long long, uint32_t> rows;
+        bool stale = true;
+
+        void add(long long key, int dueDay, BookType bookType, UserRole role, int userId);
+        double remove(long long key);       // returns the loan's accrued fine
+        void clear();
+    };
+    AccrualTable accrual;
+    // Totals of the last full pass, kept current by borrowBook, returnBook and
+    // accrueUserFines (both the fines and the overdue count); they hold until
+    // the day or the configuration changes
+    FineAccrualSummary lastAccrual;
+    int lastAccrualDay = INT_MIN;
+    uint64_t lastAccrualConfig = 0;
+    void fillAccrualTable(const std::vector<std::unique_ptr<Book>>& books,
+                          const std::vector<std::unique_ptr<User>>& users);
+    double accrualFine(const ConfigSnapshot& settings, uint32_t row, int today) const;
     
     // Helper methods
     std::string getCurrentDate() const;
@@ -89,7 +162,26 @@ public:
     ~LoanManager() = default;
 
     //  دسترسی به تراکنش‌ها برای ذخیرع در سی اس وی
+    // (the hot tier only; the cold tier lives in its own file)
     std::vector<std::unique_ptr<LoanTransaction>>& getTransactions() { return transactions; }
+    // Must be called after transactions were added through getTransactions()
+    void rebuildIndexes();
+
+    // Opens the cold tier of the history and its B+tree index, rebuilding
+    // the index if it is missing or was built for another segment. Call it
+    // before rebuildIndexes, which drops loaded loans that were already moved there.
+    bool openColdHistory(const std::string& filename, const std::string& indexFilename);
+    // Moves returned loans that came back more than maxAgeDays ago to the
+    // cold tier and returns how many moved (none if maxAgeDays <= 0)
+    size_t tierHistory(int maxAgeDays);
+    size_t getColdLoanCount() const { return cold.size(); }
+    LoanHistoryTree::CacheStats getColdIndexCacheStats() const { return coldIndex.cacheStats(); }
+    // Every loan of both tiers, in transactionId order. Cold loans are
+    // decoded into coldCopies, which must outlive the result.
+    LoanHistory fullHistory(std::vector<LoanTransaction>& coldCopies) const;
+
+    // Listeners are not owned and must outlive the LoanManager
+    void addListener(LoanEventListener* listener);
     
     // Core borrowing and returning functionality
     bool borrowBook(User* user, Book* book);
@@ -103,28 +195,68 @@ public:
     // Fine management
     double calculateUserFines(const User* user) const;
     bool payFine(User* user, double amount);
+    // Recomputes the fine accrued to date on every open loan (from the fine
+    // policy, capped at max_fine) and sets each user's accrued balance to the
+    // sum over their loans. Balances are set, not added, so repeating a pass
+    // changes nothing.
+    FineAccrualSummary accrueFines(const std::vector<std::unique_ptr<Book>>& books,
+                                   const std::vector<std::unique_ptr<User>>& users);
+    // The same for one user's open loans. Returns false (and changes nothing)
+    // if no full pass has filled the accrual table yet.
+    bool accrueUserFines(User* user);
+    // Totals as of now: the last pass's, unless the day or the configuration
+    // has changed since, in which case this runs a full pass
+    FineAccrualSummary currentFineAccrual(const std::vector<std::unique_ptr<Book>>& books,
+                                          const std::vector<std::unique_ptr<User>>& users);
+    // What a loan owes: the assessed fine once returned, the fine accrued to
+    // date while open
+    double currentFine(const LoanTransaction& loan) const;
     
-    // Transaction history
-    std::vector<LoanTransaction*> getUserTransactions(int userId) const;
-    std::vector<LoanTransaction*> getBookTransactions(int bookId) const;
+    // Transaction history of both tiers, by borrow date then transactionId.
+    // from and to ("YYYY-MM-DD", inclusive) limit the borrow dates; empty = no limit.
+    // Cold loans are read from the on-disk index, so the results are copies.
+    std::vector<LoanTransaction> getUserTransactions(int userId, const std::string& from = "",
+                                                     const std::string& to = "") const;
+    std::vector<LoanTransaction> getBookTransactions(int bookId, const std::string& from = "",
+                                                     const std::string& to = "") const;
     
+    // Keyset-paginated listings; pass the previous page's next cursor (or a
+    // default one) and get at most limit rows.
+    // Open loans, soonest due first; cursor = (due day, transactionId)
+    Page<const LoanTransaction*> loansPage(const PageCursor& after, size_t limit) const;
+    // Overdue loans, longest overdue first; cursor = (due day, transactionId)
+    Page<const LoanTransaction*> overduePage(const PageCursor& after, size_t limit) const;
+    // Unexpired reservations by book, then user; cursor = (bookId, userId)
+    Page<ReservationEntry> reservationsPage(const PageCursor& after, size_t limit) const;
+    // A user's loans from both tiers, oldest first; cursor = (borrow day, transactionId)
+    Page<LoanTransaction> userHistoryPage(int userId, const PageCursor& after, size_t limit) const;
+
+    // Row layouts shared by the listings
+    static const std::vector<ReportColumn>& loanReportColumns();
+    void renderLoan(ReportWriter& out, const LoanTransaction& loan) const;
+    static const std::vector<ReportColumn>& reservationReportColumns();
+    static void renderReservation(ReportWriter& out, const ReservationEntry& entry);
+
     // Display and reporting methods
     void printUserLoans(int userId) const;
     void printUserReservations(int userId);
-    void printAllLoans() const;
+    void printAllLoans(ReportFormat format = ReportFormat::Text, int fd = 1) const;
     void printAllReservations();
-    void printOverdueBooks() const;
+    void printOverdueBooks(ReportFormat format = ReportFormat::Text, int fd = 1) const;
     
     // Statistics methods
     int getTotalLoans() const;
     int getActiveLoans() const;
     int getOverdueCount() const;
     double getTotalFines() const;
+    LoanStatistics getStatistics() const;     // from the running counters, O(1) amortised
+    LoanStatistics computeStatistics() const; // full scan of the history
+    // Compares the running counters with a full scan; prints any difference to out
+    bool checkStatistics(std::ostream& out) const;
     std::vector<LoanTransaction*> getOverdueTransactions() const;
     
     // Utility methods
-    void setFineCalculator(std::unique_ptr<FineCalculator> calculator);
-    void printTransactionHistory(int userId) const;
+    void printTransactionHistory(int userId, ReportFormat format = ReportFormat::Text, int fd = 1) const;
 };
 
 #endif // LOAN_MANAGER_H 
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <climits>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Keyset pagination. A cursor holds the sort key of the last row a caller
+// has seen, so the next page starts right after it no matter what was
+// inserted or removed in between, and a page costs O(log n + page size).
+// What major and minor mean depends on the listing.
+struct PageCursor {
+    long long major = LLONG_MIN;
+    long long minor = LLONG_MIN;
+
+    bool atStart() const { return major == LLONG_MIN && minor == LLONG_MIN; }
+
+    // "major:minor", for callers that hand cursors out (scripts, RPC)
+    std::string toString() const {
+        return atStart() ? std::string() : std::to_string(major) + ":" + std::to_string(minor);
+    }
+    static bool parse(const std::string& text, PageCursor& cursor) {
+        if (text.empty()) {
+            cursor = PageCursor();
+            return true;
+        }
+        char* end = nullptr;
+        long long major = std::strtoll(text.c_str(), &end, 10);
+        if (end == text.c_str() || *end != ':') return false;
+        const char* minorText = end + 1;
+        long long minor = std::strtoll(minorText, &end, 10);
+        if (end == minorText || *end != '\0') return false;
+        cursor.major = major;
+        cursor.minor = minor;
+        return true;
+    }
+};
+
+template <typename T>
+struct Page {
+    std::vector<T> items;
+    PageCursor next;        // resumes after the last item
+    bool more = false;      // false on the last page
+};
+
+#endif // PAGING_H
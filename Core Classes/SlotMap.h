@@ -0,0 +1,71 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstdint>
+#include <vector>
+
+// Resolves entity ids to objects with two array loads: a table indexed by id
+// gives the id's slot, and the slot holds the object. Erasing an id frees its
+// slot for the next insert and leaves every other id where it was. Ids are
+// small and mostly dense (IdAllocator hands them out in order), so the id
+// table stays close to the entity count. The objects are not owned.
+template <typename T>
+class SlotMap {
+public:
+    T* find(int id) const {
+        if (id <= 0 || static_cast<size_t>(id) >= slotById.size()) return nullptr;
+        const uint32_t slot = slotById[id];
+        return slot == noSlot ? nullptr : slots[slot];
+    }
+
+    // False (and nothing stored) if the id is not positive or already taken
+    bool insert(int id, T* object) {
+        if (id <= 0 || !object) return false;
+        if (static_cast<size_t>(id) >= slotById.size()) {
+            slotById.resize(static_cast<size_t>(id) + 1, noSlot);
+        } else if (slotById[id] != noSlot) {
+            return false;
+        }
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot] = object;
+        } else {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back(object);
+        }
+        slotById[id] = slot;
+        return true;
+    }
+
+    void erase(int id) {
+        if (!find(id)) return;
+        const uint32_t slot = slotById[id];
+        slots[slot] = nullptr;
+        freeSlots.push_back(slot);
+        slotById[id] = noSlot;
+    }
+
+    void clear() {
+        slotById.clear();
+        slots.clear();
+        freeSlots.clear();
+    }
+
+    void reserve(int maxId, size_t count) {
+        if (maxId > 0) slotById.reserve(static_cast<size_t>(maxId) + 1);
+        slots.reserve(count);
+    }
+
+    size_t size() const { return slots.size() - freeSlots.size(); }
+
+private:
+    static constexpr uint32_t noSlot = UINT32_MAX;
+
+    std::vector<uint32_t> slotById;
+    std::vector<T*> slots;              // nullptr while on the free list
+    std::vector<uint32_t> freeSlots;
+};
+
+#endif // SLOT_MAP_H
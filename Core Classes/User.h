@@ -6,13 +6,37 @@
 #include <memory>
 #include <unordered_set>
 #include "Book.h"
+#include "LibraryEnums.h"
+#include "../Utils/ini/GlobalConfiguration.h"
 
-// Enum for user roles
-enum class UserRole {
-    Regular,
-    Librarian
+// What a role may do. Limits and loan periods are configurable, so the
+// policy names the ConfigSnapshot field to read rather than a value.
+struct RolePolicy {
+    const char* typeName;               // "Type" column of users.csv
+    int ConfigSnapshot::* borrowLimit;
+    int ConfigSnapshot::* loanPeriod;
+    bool needsGoodStanding;             // must be Active to borrow or reserve, and owe less than max_fine to borrow
+    bool canManageUsers;
+    bool canManageBooks;
+    bool canHandleFines;
+    bool canViewLogs;
+    bool usesLibrarianMenu;
 };
 
+// One entry per UserRole, in enum order. Adding a role is an enum value plus an entry here.
+constexpr RolePolicy rolePolicies[] = {
+    // typeName      borrowLimit                                    loanPeriod                                    standing users  books  fines  logs   librarian menu
+    {"RegularUser",  &ConfigSnapshot::regular_user_borrow_limit,    &ConfigSnapshot::regular_user_loan_period,    true,    false, false, false, false, false},
+    {"Librarian",    &ConfigSnapshot::librarian_borrow_limit,       &ConfigSnapshot::librarian_loan_period,       false,   true,  true,  true,  true,  true},
+};
+static_assert(sizeof(rolePolicies) / sizeof(rolePolicies[0]) == static_cast<size_t>(UserRole::Count),
+              "every UserRole needs a RolePolicy");
+
+constexpr const RolePolicy& rolePolicy(UserRole role) { return rolePolicies[static_cast<size_t>(role)]; }
+
+// Looks up a role by its users.csv type name
+bool roleFromTypeName(const std::string& typeName, UserRole& role);
+
 // Enum for user status
 enum class UserStatus {
     Active,
@@ -38,6 +62,7 @@ protected:
     UserStatus status;
     std::vector<LoanRecord> loanHistory;
     double totalFines;
+    double accruedFines = 0.0;  // on open overdue loans, set by LoanManager::accrueFines
 
 public:
     User(int userId, const std::string& username, const std::string& password, UserRole role);
@@ -48,60 +73,51 @@ public:
     UserRole getRole() const;
     UserStatus getStatus() const;
     double getTotalFines() const;
+    double getAccruedFines() const { return accruedFines; }
     const std::vector<LoanRecord>& getLoanHistory() const;
 
     void setStatus(UserStatus newStatus);
     void addLoanRecord(const LoanRecord& record);
     void addFine(double amount);
     void payFine(double amount);
+    void setAccruedFines(double amount) { accruedFines = amount; }
 
     // acces to password i know it 's not standard
     std::string getPassword() const { return password; }
 
-    virtual bool canBorrow() const = 0;
-    virtual int getBorrowLimit() const = 0;
-    virtual int getLoanPeriod() const = 0;
-    virtual bool canReserve() const = 0;
-    virtual bool canManageUsers() const = 0;
-    virtual bool canManageBooks() const = 0;
-    virtual bool canHandleFines() const = 0;
-    virtual bool canViewLogs() const = 0;
+    // Permission and limit checks are lookups in the role's policy
+    const RolePolicy& getPolicy() const { return rolePolicy(role); }
+    bool canBorrow() const {
+        const RolePolicy& policy = getPolicy();
+        return (!policy.needsGoodStanding) |
+               ((status == UserStatus::Active) & (totalFines + accruedFines < config()->max_fine));
+    }
+    bool canReserve() const { return (!getPolicy().needsGoodStanding) | (status == UserStatus::Active); }
+    int getBorrowLimit() const { return (*config()).*getPolicy().borrowLimit; }
+    int getLoanPeriod() const { return (*config()).*getPolicy().loanPeriod; } // days
+    bool canManageUsers() const { return getPolicy().canManageUsers; }
+    bool canManageBooks() const { return getPolicy().canManageBooks; }
+    bool canHandleFines() const { return getPolicy().canHandleFines; }
+    bool canViewLogs() const { return getPolicy().canViewLogs; }
+    bool usesLibrarianMenu() const { return getPolicy().usesLibrarianMenu; }
 
     // Authentication (simple, for demonstration)
     bool authenticate(const std::string& password) const;
 
     // For type identification
-    virtual std::string getType() const = 0;
+    std::string getType() const { return getPolicy().typeName; }
 };
 
 // RegularUser class
 class RegularUser : public User {
 public:
     RegularUser(int userId, const std::string& username, const std::string& password);
-    bool canBorrow() const override;
-    int getBorrowLimit() const override;
-    int getLoanPeriod() const override;
-    bool canReserve() const override;
-    bool canManageUsers() const override;
-    bool canManageBooks() const override;
-    bool canHandleFines() const override;
-    bool canViewLogs() const override;
-    std::string getType() const override;
 };
 
 // Librarian class
 class Librarian : public User {
 public:
     Librarian(int userId, const std::string& username, const std::string& password);
-    bool canBorrow() const override;
-    int getBorrowLimit() const override;
-    int getLoanPeriod() const override;
-    bool canReserve() const override;
-    bool canManageUsers() const override;
-    bool canManageBooks() const override;
-    bool canHandleFines() const override;
-    bool canViewLogs() const override;
-    std::string getType() const override;
 };
 
 #endif // USER_H
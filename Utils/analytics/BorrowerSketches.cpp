@@ -0,0 +1,299 @@
+#include "BorrowerSketches.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <unordered_set>
+#include "DayNumber.h"
+#include "../metrics/MemoryTracker.h"
+#include "../concurrency/ThreadPool.h"
+#include "../storage/AtomicFile.h"
+
+namespace {
+const char fileMagic[4] = {'H', 'L', 'L', 'S'};
+const uint32_t fileVersion = 1;
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+// Lower bound of the month keys for a window starting at fromDay
+int firstMonth(int fromDay) {
+    return fromDay > INT_MIN + 31 ? monthStart(fromDay) : INT_MIN;
+}
+}
+
+void BorrowerSketches::clear() {
+    bookSketches.clear();
+    categoryMonths.clear();
+    catalogMonths.clear();
+    watermark = 0;
+    loansFolded = 0;
+}
+
+int BorrowerSketches::categoryFor(const Book& book) {
+    auto it = bookCategories.find(book.getId());
+    if (it != bookCategories.end()) return it->second;
+    auto category = categoryIds.emplace(book.getCategory(), static_cast<int>(categoryNames.size()));
+    if (category.second) categoryNames.push_back(book.getCategory());
+    bookCategories.emplace(book.getId(), category.first->second);
+    return category.first->second;
+}
+
+void BorrowerSketches::internCategories(const std::vector<std::unique_ptr<Book>>& books) {
+    for (const auto& book : books) categoryFor(*book);
+}
+
+void BorrowerSketches::add(const LoanTransaction& loan, int category) {
+    uint64_t hash = HyperLogLog::hashId(static_cast<uint64_t>(loan.userId));
+    bookSketches[loan.bookId].add(hash);
+    int day = dayNumber(loan.borrowDate);
+    if (day != kInvalidDay) {
+        int month = monthStart(day);
+        if (category >= 0) categoryMonths[{category, month}].add(hash);
+        catalogMonths[month].add(hash);
+    }
+    watermark = std::max(watermark, loan.transactionId);
+    ++loansFolded;
+}
+
+void BorrowerSketches::onBorrow(const LoanTransaction& loan, const Book& book) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    add(loan, categoryFor(book));
+}
+
+void BorrowerSketches::rebuild(const LoanHistory& history,
+                               const std::vector<std::unique_ptr<Book>>& books) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    clear();
+    // Interning is serial; the scan below only reads bookCategories
+    internCategories(books);
+
+    struct Partial {
+        std::unordered_map<int, HyperLogLog> books;
+        std::map<std::pair<int, int>, HyperLogLog> categoryMonths;
+        std::map<int, HyperLogLog> catalogMonths;
+        int watermark = 0;
+        long long loans = 0;
+    };
+    Partial totals = parallelReduce(size_t(0), history.size(), size_t(65536), Partial{},
+        [&](size_t lo, size_t hi) {
+            ScopedMemoryTag workerTag(MemorySubsystem::Analytics);
+            Partial partial;
+            for (size_t i = lo; i < hi; ++i) {
+                const LoanTransaction& loan = *history[i];
+                uint64_t hash = HyperLogLog::hashId(static_cast<uint64_t>(loan.userId));
+                partial.books[loan.bookId].add(hash);
+                int day = dayNumber(loan.borrowDate);
+                if (day != kInvalidDay) {
+                    int month = monthStart(day);
+                    auto category = bookCategories.find(loan.bookId);
+                    if (category != bookCategories.end()) partial.categoryMonths[{category->second, month}].add(hash);
+                    partial.catalogMonths[month].add(hash);
+                }
+                partial.watermark = std::max(partial.watermark, loan.transactionId);
+                ++partial.loans;
+            }
+            return partial;
+        },
+        [](Partial a, const Partial& b) {
+            for (const auto& entry : b.books) a.books[entry.first].merge(entry.second);
+            for (const auto& entry : b.categoryMonths) a.categoryMonths[entry.first].merge(entry.second);
+            for (const auto& entry : b.catalogMonths) a.catalogMonths[entry.first].merge(entry.second);
+            a.watermark = std::max(a.watermark, b.watermark);
+            a.loans += b.loans;
+            return a;
+        });
+
+    bookSketches = std::move(totals.books);
+    categoryMonths = std::move(totals.categoryMonths);
+    catalogMonths = std::move(totals.catalogMonths);
+    watermark = totals.watermark;
+    loansFolded = totals.loans;
+}
+
+// Layout: magic, version, precision, watermark, loan count, then the book,
+// category-month and catalog-month sketches, each list prefixed by its size.
+// Categories are stored by name since the ids are per run.
+bool BorrowerSketches::save(const std::string& filename) const {
+    const std::string tempFile = filename + ".tmp";
+    {
+        std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(fileMagic, sizeof(fileMagic));
+        writeValue(out, fileVersion);
+        writeValue(out, static_cast<uint32_t>(HyperLogLog::precision));
+        writeValue(out, static_cast<int32_t>(watermark));
+        writeValue(out, static_cast<int64_t>(loansFolded));
+
+        writeValue(out, static_cast<uint32_t>(bookSketches.size()));
+        for (const auto& entry : bookSketches) {
+            writeValue(out, static_cast<int32_t>(entry.first));
+            entry.second.write(out);
+        }
+        writeValue(out, static_cast<uint32_t>(categoryMonths.size()));
+        for (const auto& entry : categoryMonths) {
+            const std::string& name = categoryNames[entry.first.first];
+            writeValue(out, static_cast<uint32_t>(name.size()));
+            out.write(name.data(), name.size());
+            writeValue(out, static_cast<int32_t>(entry.first.second));
+            entry.second.write(out);
+        }
+        writeValue(out, static_cast<uint32_t>(catalogMonths.size()));
+        for (const auto& entry : catalogMonths) {
+            writeValue(out, static_cast<int32_t>(entry.first));
+            entry.second.write(out);
+        }
+        if (!out.flush()) return false;
+    }
+    return replaceFile(tempFile, filename);
+}
+
+bool BorrowerSketches::load(const std::string& filename,
+                            const LoanHistory& history,
+                            const std::vector<std::unique_ptr<Book>>& books) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+
+    clear();
+    internCategories(books);
+    auto fail = [this] { clear(); return false; };
+
+    char magic[sizeof(fileMagic)];
+    uint32_t version = 0, precision = 0, count = 0;
+    int32_t savedWatermark = 0;
+    int64_t savedLoans = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, fileMagic, sizeof(magic)) != 0) return fail();
+    if (!readValue(in, version) || version != fileVersion) return fail();
+    if (!readValue(in, precision) || precision != static_cast<uint32_t>(HyperLogLog::precision)) return fail();
+    if (!readValue(in, savedWatermark) || !readValue(in, savedLoans)) return fail();
+
+    if (!readValue(in, count)) return fail();
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t bookId;
+        if (!readValue(in, bookId) || !bookSketches[bookId].read(in)) return fail();
+    }
+    if (!readValue(in, count)) return fail();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t length;
+        int32_t month;
+        if (!readValue(in, length) || length > 4096) return fail();
+        std::string name(length, '\0');
+        if (!in.read(&name[0], length) || !readValue(in, month)) return fail();
+        auto category = categoryIds.emplace(name, static_cast<int>(categoryNames.size()));
+        if (category.second) categoryNames.push_back(name);
+        if (!categoryMonths[{category.first->second, month}].read(in)) return fail();
+    }
+    if (!readValue(in, count)) return fail();
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t month;
+        if (!readValue(in, month) || !catalogMonths[month].read(in)) return fail();
+    }
+
+    // The saved sketches must cover exactly the loans up to the watermark
+    long long covered = 0;
+    for (const auto& loan : history) {
+        if (loan->transactionId <= savedWatermark) ++covered;
+    }
+    if (covered != savedLoans) return fail();
+    watermark = savedWatermark;
+    loansFolded = savedLoans;
+
+    for (const auto& loan : history) {
+        if (loan->transactionId <= savedWatermark) continue;
+        auto category = bookCategories.find(loan->bookId);
+        add(*loan, category == bookCategories.end() ? -1 : category->second);
+    }
+    return true;
+}
+
+double BorrowerSketches::book(int bookId) const {
+    auto it = bookSketches.find(bookId);
+    return it == bookSketches.end() ? 0.0 : it->second.estimate();
+}
+
+double BorrowerSketches::category(const std::string& name, int fromDay, int toDay) const {
+    auto id = categoryIds.find(name);
+    if (id == categoryIds.end()) return 0.0;
+    HyperLogLog merged;
+    for (auto it = categoryMonths.lower_bound({id->second, firstMonth(fromDay)});
+         it != categoryMonths.end() && it->first.first == id->second && it->first.second <= toDay; ++it) {
+        merged.merge(it->second);
+    }
+    return merged.estimate();
+}
+
+double BorrowerSketches::catalog(int fromDay, int toDay) const {
+    HyperLogLog merged;
+    for (auto it = catalogMonths.lower_bound(firstMonth(fromDay));
+         it != catalogMonths.end() && it->first <= toDay; ++it) {
+        merged.merge(it->second);
+    }
+    return merged.estimate();
+}
+
+bool BorrowerSketches::crossCheck(const LoanHistory& history,
+                                  const std::vector<std::unique_ptr<Book>>& books, std::ostream& out) const {
+    std::unordered_map<int, std::unordered_set<int>> exactBooks;
+    std::unordered_map<std::string, std::unordered_set<int>> exactCategories;
+    std::unordered_set<int> exactCatalog;
+    std::unordered_map<int, std::string> categoryOf;
+    for (const auto& book : books) categoryOf[book->getId()] = book->getCategory();
+    for (const auto& loan : history) {
+        exactBooks[loan->bookId].insert(loan->userId);
+        auto category = categoryOf.find(loan->bookId);
+        if (category != categoryOf.end()) exactCategories[category->second].insert(loan->userId);
+        exactCatalog.insert(loan->userId);
+    }
+
+    auto relativeError = [](double estimate, size_t exact) {
+        return exact == 0 ? estimate : std::fabs(estimate - exact) / exact;
+    };
+
+    double sumError = 0.0, maxError = 0.0;
+    int worstBook = 0;
+    for (const auto& entry : exactBooks) {
+        double error = relativeError(book(entry.first), entry.second.size());
+        sumError += error;
+        if (error > maxError) {
+            maxError = error;
+            worstBook = entry.first;
+        }
+    }
+    double meanError = exactBooks.empty() ? 0.0 : sumError / exactBooks.size();
+
+    out << std::fixed << std::setprecision(2)
+        << "Books: " << exactBooks.size() << " checked, mean error " << meanError * 100
+        << "%, max " << maxError * 100 << "% (book " << worstBook << ")\n";
+
+    double maxCategoryError = 0.0;
+    for (const auto& entry : exactCategories) {
+        double estimate = category(entry.first, INT_MIN, INT_MAX);
+        double error = relativeError(estimate, entry.second.size());
+        maxCategoryError = std::max(maxCategoryError, error);
+        out << "  " << std::left << std::setw(20) << entry.first << std::right
+            << std::setw(10) << entry.second.size() << " exact" << std::setw(12) << estimate
+            << " estimated (" << error * 100 << "%)\n";
+    }
+    double catalogEstimate = catalog(INT_MIN, INT_MAX);
+    double catalogError = relativeError(catalogEstimate, exactCatalog.size());
+    out << "Catalog: " << exactCatalog.size() << " exact, " << catalogEstimate
+        << " estimated (" << catalogError * 100 << "%)\n";
+    out.unsetf(std::ios::floatfield);
+
+    // About three standard errors of a 2^12-register sketch
+    const double tolerance = 0.05;
+    bool ok = meanError <= tolerance && maxCategoryError <= tolerance && catalogError <= tolerance;
+    if (!ok) out << "Sketch error exceeds " << tolerance * 100 << "%.\n";
+    return ok;
+}
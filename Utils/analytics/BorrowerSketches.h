@@ -0,0 +1,63 @@
+#ifndef BORROWER_SKETCHES_H
+#define BORROWER_SKETCHES_H
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "HyperLogLog.h"
+#include "../../Core Classes/LoanManager.h"
+
+// Approximate distinct-borrower counts ("how many patrons borrowed this")
+// per book over all time, and per category and for the whole catalog per
+// calendar month. Window queries merge the month sketches they cover, so a
+// window is rounded out to whole months.
+// The sketches are saved next to the database with a watermark (the highest
+// transaction id folded in); on startup only loans after it are replayed.
+// Not thread-safe: fed by LoanManager and queried from the same thread.
+class BorrowerSketches : public LoanEventListener {
+public:
+    void onBorrow(const LoanTransaction& loan, const Book& book) override;
+
+    // Replaces the sketches with those of a loaded history (in parallel)
+    void rebuild(const LoanHistory& history,
+                 const std::vector<std::unique_ptr<Book>>& books);
+
+    // Loads saved sketches and folds in the loans after their watermark.
+    // False if the file is missing, damaged or does not match the history.
+    bool load(const std::string& filename,
+              const LoanHistory& history,
+              const std::vector<std::unique_ptr<Book>>& books);
+    bool save(const std::string& filename) const;
+
+    double book(int bookId) const;
+    double category(const std::string& name, int fromDay, int toDay) const; // day numbers, inclusive
+    double catalog(int fromDay, int toDay) const;
+    const std::vector<std::string>& categories() const { return categoryNames; }
+
+    // Recounts exact borrower sets from the history and reports the sketch
+    // error. Keeps a set per book, so it is meant for small datasets.
+    bool crossCheck(const LoanHistory& history,
+                    const std::vector<std::unique_ptr<Book>>& books, std::ostream& out) const;
+
+private:
+    std::unordered_map<int, HyperLogLog> bookSketches;
+    std::map<std::pair<int, int>, HyperLogLog> categoryMonths;  // (category, month start) -> sketch
+    std::map<int, HyperLogLog> catalogMonths;                   // month start -> sketch
+    int watermark = 0;              // highest transaction id folded in
+    long long loansFolded = 0;
+
+    std::unordered_map<int, int> bookCategories;                // bookId -> category
+    std::unordered_map<std::string, int> categoryIds;
+    std::vector<std::string> categoryNames;
+
+    int categoryFor(const Book& book);
+    void internCategories(const std::vector<std::unique_ptr<Book>>& books);
+    void add(const LoanTransaction& loan, int category);
+    void clear();
+};
+
+#endif // BORROWER_SKETCHES_H
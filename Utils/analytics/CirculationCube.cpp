@@ -0,0 +1,218 @@
+#include "CirculationCube.h"
+#include <algorithm>
+#include "DayNumber.h"
+#include "../metrics/MemoryTracker.h"
+#include "../concurrency/ThreadPool.h"
+
+int CirculationCube::periodStart(CubeGranularity granularity, int day) {
+    switch (granularity) {
+        case CubeGranularity::Week:
+            // Day 0 (1970-01-01) was a Thursday
+            return day - ((day + 3) % 7 + 7) % 7;
+        case CubeGranularity::Month:
+            return monthStart(day);
+        default:
+            return day;
+    }
+}
+
+int CirculationCube::nextPeriod(CubeGranularity granularity, int start) {
+    switch (granularity) {
+        case CubeGranularity::Week:
+            return start + 7;
+        case CubeGranularity::Month: {
+            int year;
+            unsigned month, dayOfMonth;
+            civilFromDays(start, year, month, dayOfMonth);
+            return month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1);
+        }
+        default:
+            return start + 1;
+    }
+}
+
+uint32_t CirculationCube::cellFor(const Book& book) {
+    auto it = bookCells.find(book.getId());
+    if (it != bookCells.end()) return it->second;
+
+    auto category = categoryIds.emplace(book.getCategory(), static_cast<int>(categoryNames.size()));
+    if (category.second) categoryNames.push_back(book.getCategory());
+    auto type = typeIds.emplace(book.getType(), static_cast<int>(typeNames.size()));
+    if (type.second) typeNames.push_back(book.getType());
+
+    uint32_t cell = (static_cast<uint32_t>(category.first->second) << 8) | static_cast<uint32_t>(type.first->second);
+    bookCells.emplace(book.getId(), cell);
+    return cell;
+}
+
+int CirculationCube::findCategory(const std::string& name) const {
+    auto it = categoryIds.find(name);
+    return it == categoryIds.end() ? -1 : it->second;
+}
+
+void CirculationCube::addToSlice(Slice& slice, uint32_t cell, const CirculationMeasures& measures) {
+    auto it = std::lower_bound(slice.begin(), slice.end(), cell,
+        [](const std::pair<uint32_t, CirculationMeasures>& entry, uint32_t key) { return entry.first < key; });
+    if (it == slice.end() || it->first != cell) {
+        slice.insert(it, {cell, measures});
+    } else {
+        it->second += measures;
+    }
+}
+
+CirculationMeasures& CirculationCube::measuresAt(int day, uint32_t cell) {
+    weeks.dirty.insert(periodStart(CubeGranularity::Week, day));
+    months.dirty.insert(periodStart(CubeGranularity::Month, day));
+
+    Slice& slice = days[day];
+    auto it = std::lower_bound(slice.begin(), slice.end(), cell,
+        [](const std::pair<uint32_t, CirculationMeasures>& entry, uint32_t key) { return entry.first < key; });
+    if (it == slice.end() || it->first != cell) {
+        it = slice.insert(it, {cell, CirculationMeasures{}});
+    }
+    return it->second;
+}
+
+void CirculationCube::onBorrow(const LoanTransaction& loan, const Book& book) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    int day = dayNumber(loan.borrowDate);
+    if (day == kInvalidDay) return;
+    ++measuresAt(day, cellFor(book)).loans;
+}
+
+void CirculationCube::onReturn(const LoanTransaction& loan, const Book& book) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    int day = dayNumber(loan.returnDate);
+    if (day == kInvalidDay) return;
+    CirculationMeasures& measures = measuresAt(day, cellFor(book));
+    ++measures.returns;
+    if (loan.returnDate > loan.dueDate) ++measures.overdueReturns;
+    measures.fines += loan.fine;
+}
+
+void CirculationCube::rebuild(const LoanHistory& history,
+                              const std::vector<std::unique_ptr<Book>>& books) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    days.clear();
+    weeks = Rollup();
+    months = Rollup();
+    // Interning is serial; the scan below only reads bookCells
+    for (const auto& book : books) cellFor(*book);
+
+    using Partial = std::unordered_map<uint64_t, CirculationMeasures>; // (day, cell) -> measures
+    auto key = [](int day, uint32_t cell) { return (static_cast<uint64_t>(static_cast<uint32_t>(day)) << 32) | cell; };
+    Partial totals = parallelReduce(size_t(0), history.size(), size_t(65536), Partial{},
+        [&](size_t lo, size_t hi) {
+            ScopedMemoryTag workerTag(MemorySubsystem::Analytics);
+            Partial partial;
+            for (size_t i = lo; i < hi; ++i) {
+                const LoanTransaction& loan = *history[i];
+                auto cell = bookCells.find(loan.bookId);
+                if (cell == bookCells.end()) continue;
+
+                int borrowDay = dayNumber(loan.borrowDate);
+                if (borrowDay != kInvalidDay) ++partial[key(borrowDay, cell->second)].loans;
+                if (!loan.isReturned) continue;
+                int returnDay = dayNumber(loan.returnDate);
+                if (returnDay == kInvalidDay) continue;
+                CirculationMeasures& measures = partial[key(returnDay, cell->second)];
+                ++measures.returns;
+                if (loan.returnDate > loan.dueDate) ++measures.overdueReturns;
+                measures.fines += loan.fine;
+            }
+            return partial;
+        },
+        [](Partial a, const Partial& b) {
+            for (const auto& entry : b) a[entry.first] += entry.second;
+            return a;
+        });
+
+    for (const auto& entry : totals) {
+        int day = static_cast<int>(static_cast<uint32_t>(entry.first >> 32));
+        addToSlice(days[day], static_cast<uint32_t>(entry.first), entry.second);
+    }
+    for (const auto& day : days) {
+        weeks.dirty.insert(periodStart(CubeGranularity::Week, day.first));
+        months.dirty.insert(periodStart(CubeGranularity::Month, day.first));
+    }
+}
+
+CirculationCube::Rollup& CirculationCube::rollupFor(CubeGranularity granularity) {
+    return granularity == CubeGranularity::Week ? weeks : months;
+}
+
+CirculationCube::Slice CirculationCube::sumDays(int fromDay, int toDay) const {
+    Slice sum;
+    for (auto it = days.lower_bound(fromDay); it != days.end() && it->first <= toDay; ++it) {
+        for (const auto& entry : it->second) addToSlice(sum, entry.first, entry.second);
+    }
+    return sum;
+}
+
+void CirculationCube::refresh(CubeGranularity granularity, int fromDay, int toDay) {
+    Rollup& rollup = rollupFor(granularity);
+    auto it = rollup.dirty.lower_bound(periodStart(granularity, fromDay));
+    while (it != rollup.dirty.end() && *it <= toDay) {
+        Slice sum = sumDays(*it, nextPeriod(granularity, *it) - 1);
+        if (sum.empty()) {
+            rollup.periods.erase(*it);
+        } else {
+            rollup.periods[*it] = std::move(sum);
+        }
+        it = rollup.dirty.erase(it);
+    }
+}
+
+void CirculationCube::emit(int period, const Slice& slice, const CubeQuery& query, std::vector<CubeRow>& rows) const {
+    std::vector<CubeRow> groups;
+    for (const auto& entry : slice) {
+        int category = static_cast<int>(entry.first >> 8);
+        int bookType = static_cast<int>(entry.first & 0xff);
+        if (query.category >= 0 && category != query.category) continue;
+        if (query.bookType >= 0 && bookType != query.bookType) continue;
+
+        int groupCategory = query.groupByCategory ? category : -1;
+        int groupType = query.groupByType ? bookType : -1;
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const CubeRow& row) {
+            return row.category == groupCategory && row.bookType == groupType;
+        });
+        if (group == groups.end()) {
+            groups.push_back(CubeRow{period, groupCategory, groupType, entry.second});
+        } else {
+            group->measures += entry.second;
+        }
+    }
+    std::sort(groups.begin(), groups.end(), [](const CubeRow& a, const CubeRow& b) {
+        return a.category != b.category ? a.category < b.category : a.bookType < b.bookType;
+    });
+    rows.insert(rows.end(), groups.begin(), groups.end());
+}
+
+std::vector<CubeRow> CirculationCube::query(const CubeQuery& query) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    std::vector<CubeRow> rows;
+    if (query.fromDay > query.toDay) return rows;
+
+    if (query.granularity == CubeGranularity::Day) {
+        for (auto it = days.lower_bound(query.fromDay); it != days.end() && it->first <= query.toDay; ++it) {
+            emit(it->first, it->second, query, rows);
+        }
+        return rows;
+    }
+
+    refresh(query.granularity, query.fromDay, query.toDay);
+    const Rollup& rollup = rollupFor(query.granularity);
+    for (int period = periodStart(query.granularity, query.fromDay); period <= query.toDay;) {
+        int next = nextPeriod(query.granularity, period);
+        if (period >= query.fromDay && next - 1 <= query.toDay) {
+            auto it = rollup.periods.find(period);
+            if (it != rollup.periods.end()) emit(period, it->second, query, rows);
+        } else {
+            // A period cut by the range is summed from its days
+            Slice partial = sumDays(std::max(period, query.fromDay), std::min(next - 1, query.toDay));
+            if (!partial.empty()) emit(period, partial, query, rows);
+        }
+        period = next;
+    }
+    return rows;
+}
@@ -0,0 +1,106 @@
+#ifndef CIRCULATION_CUBE_H
+#define CIRCULATION_CUBE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../../Core Classes/LoanManager.h"
+
+enum class CubeGranularity {
+    Day,
+    Week,   // starting on Monday
+    Month
+};
+
+struct CirculationMeasures {
+    long long loans = 0;
+    long long returns = 0;
+    long long overdueReturns = 0;   // returned after the due date
+    double fines = 0.0;             // assessed at return
+
+    CirculationMeasures& operator+=(const CirculationMeasures& other) {
+        loans += other.loans;
+        returns += other.returns;
+        overdueReturns += other.overdueReturns;
+        fines += other.fines;
+        return *this;
+    }
+};
+
+struct CubeQuery {
+    int fromDay;                    // day numbers (DayNumber.h), inclusive
+    int toDay;
+    CubeGranularity granularity = CubeGranularity::Day;
+    int category = -1;              // filter; -1 for all
+    int bookType = -1;              // filter; -1 for all
+    bool groupByCategory = false;
+    bool groupByType = false;
+};
+
+struct CubeRow {
+    int periodStart;                // first day of the day/week/month
+    int category;                   // -1 unless grouped by category
+    int bookType;                   // -1 unless grouped by type
+    CirculationMeasures measures;
+};
+
+// Pre-aggregated circulation figures keyed by (day, category, book type).
+// Loans count on their borrow date; returns, overdue returns and fines on
+// their return date. Week and month buckets are rolled up from the days on
+// first use and recomputed only for periods that changed since, so slices
+// over years of history touch a few hundred buckets instead of the loans.
+// Not thread-safe: fed by LoanManager and queried from the same thread.
+class CirculationCube : public LoanEventListener {
+public:
+    void onBorrow(const LoanTransaction& loan, const Book& book) override;
+    void onReturn(const LoanTransaction& loan, const Book& book) override;
+
+    // Replaces the cube with the aggregate of a loaded history (in parallel)
+    void rebuild(const LoanHistory& history,
+                 const std::vector<std::unique_ptr<Book>>& books);
+
+    // One row per period (and per category/type when grouped), in period order
+    std::vector<CubeRow> query(const CubeQuery& query);
+
+    int findCategory(const std::string& name) const; // -1 if unknown
+    const std::string& categoryName(int category) const { return categoryNames[category]; }
+    const std::string& typeName(int bookType) const { return typeNames[bookType]; }
+    int firstDay() const { return days.empty() ? 0 : days.begin()->first; }
+
+    static int periodStart(CubeGranularity granularity, int day);
+    static int nextPeriod(CubeGranularity granularity, int periodStart);
+
+private:
+    // Non-empty cells of one bucket, sorted by cell (category << 8 | type)
+    using Slice = std::vector<std::pair<uint32_t, CirculationMeasures>>;
+
+    struct Rollup {
+        std::map<int, Slice> periods;
+        std::set<int> dirty;        // periods whose days changed since they were rolled up
+    };
+
+    std::map<int, Slice> days;
+    Rollup weeks;
+    Rollup months;
+
+    std::unordered_map<int, uint32_t> bookCells;   // bookId -> cell
+    std::unordered_map<std::string, int> categoryIds;
+    std::unordered_map<std::string, int> typeIds;
+    std::vector<std::string> categoryNames;
+    std::vector<std::string> typeNames;
+
+    uint32_t cellFor(const Book& book);
+    CirculationMeasures& measuresAt(int day, uint32_t cell);
+    static void addToSlice(Slice& slice, uint32_t cell, const CirculationMeasures& measures);
+    Rollup& rollupFor(CubeGranularity granularity);
+    void refresh(CubeGranularity granularity, int fromDay, int toDay);
+    Slice sumDays(int fromDay, int toDay) const;
+    void emit(int period, const Slice& slice, const CubeQuery& query, std::vector<CubeRow>& rows) const;
+};
+
+#endif // CIRCULATION_CUBE_H
@@ -0,0 +1,178 @@
+#include "CoBorrowingModel.h"
+#include <algorithm>
+#include <cmath>
+#include "../metrics/MemoryTracker.h"
+#include "../concurrency/ThreadPool.h"
+
+uint32_t CoBorrowingModel::intern(int id, std::unordered_map<int, uint32_t>& index,
+                                  std::vector<std::vector<uint32_t>>& lists) {
+    auto inserted = index.emplace(id, static_cast<uint32_t>(lists.size()));
+    if (inserted.second) lists.emplace_back();
+    return inserted.first->second;
+}
+
+bool CoBorrowingModel::insertSorted(std::vector<uint32_t>& list, uint32_t value) {
+    auto it = std::lower_bound(list.begin(), list.end(), value);
+    if (it != list.end() && *it == value) return false;
+    list.insert(it, value);
+    return true;
+}
+
+// Leaves the top neighbors in row (which is also the candidate scratch).
+// counts must be zero and sized to the book count; it is left zeroed
+void CoBorrowingModel::computeRow(uint32_t book, std::vector<uint32_t>& counts, std::vector<uint32_t>& touched,
+                                  std::vector<Entry>& row) const {
+    touched.clear();
+    for (uint32_t patron : bookPatrons[book]) {
+        const std::vector<uint32_t>& others = patronBooks[patron];
+        if (others.size() > maxBooksPerPatron) continue;
+        for (uint32_t other : others) {
+            if (other == book) continue;
+            if (counts[other]++ == 0) touched.push_back(other);
+        }
+    }
+
+    row.clear();
+    const double borrowers = static_cast<double>(bookPatrons[book].size());
+    for (uint32_t other : touched) {
+        float score = static_cast<float>(counts[other] / std::sqrt(borrowers * bookPatrons[other].size()));
+        row.push_back(Entry{other, counts[other], score});
+        counts[other] = 0;
+    }
+    auto better = [this](const Entry& a, const Entry& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.coBorrowers != b.coBorrowers) return a.coBorrowers > b.coBorrowers;
+        return bookIds[a.book] < bookIds[b.book];
+    };
+    if (row.size() > neighborsPerBook) {
+        std::partial_sort(row.begin(), row.begin() + neighborsPerBook, row.end(), better);
+        row.resize(neighborsPerBook);
+    } else {
+        std::sort(row.begin(), row.end(), better);
+    }
+}
+
+void CoBorrowingModel::rebuild(const LoanHistory& history) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    bookIndex.clear();
+    bookIds.clear();
+    patronIndex.clear();
+    bookPatrons.clear();
+    patronBooks.clear();
+    patchedRows.clear();
+    dirtyRows.clear();
+
+    for (const auto& loan : history) {
+        uint32_t book = intern(loan->bookId, bookIndex, bookPatrons);
+        if (book == bookIds.size()) bookIds.push_back(loan->bookId);
+        uint32_t patron = intern(loan->userId, patronIndex, patronBooks);
+        patronBooks[patron].push_back(book);
+        bookPatrons[book].push_back(patron);
+    }
+    auto sortUnique = [](std::vector<uint32_t>& list) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    };
+    parallelFor(size_t(0), patronBooks.size(), size_t(1024), [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) sortUnique(patronBooks[i]);
+    });
+    parallelFor(size_t(0), bookPatrons.size(), size_t(1024), [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) sortUnique(bookPatrons[i]);
+    });
+
+    // Rows are independent, so each chunk fills its own rows with its own scratch
+    const size_t books = bookIds.size();
+    std::vector<std::vector<Entry>> rows(books);
+    parallelFor(size_t(0), books, size_t(256), [&](size_t lo, size_t hi) {
+        ScopedMemoryTag workerTag(MemorySubsystem::Analytics);
+        std::vector<uint32_t> counts(books, 0);
+        std::vector<uint32_t> touched;
+        std::vector<Entry> candidates;
+        for (size_t book = lo; book < hi; ++book) {
+            computeRow(static_cast<uint32_t>(book), counts, touched, candidates);
+            rows[book].assign(candidates.begin(), candidates.end());
+        }
+    });
+
+    rowOffsets.assign(books + 1, 0);
+    for (size_t book = 0; book < books; ++book) {
+        rowOffsets[book + 1] = rowOffsets[book] + static_cast<uint32_t>(rows[book].size());
+    }
+    entries.clear();
+    entries.reserve(rowOffsets[books]);
+    for (const auto& row : rows) entries.insert(entries.end(), row.begin(), row.end());
+}
+
+void CoBorrowingModel::onBorrow(const LoanTransaction& loan, const Book&) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    uint32_t bookSlot = intern(loan.bookId, bookIndex, bookPatrons);
+    if (bookSlot == bookIds.size()) bookIds.push_back(loan.bookId);
+    uint32_t patron = intern(loan.userId, patronIndex, patronBooks);
+    if (!insertSorted(patronBooks[patron], bookSlot)) return; // a repeat borrow links nothing new
+    insertSorted(bookPatrons[bookSlot], patron);
+
+    // The new book's row and the rows of everything else this patron borrowed
+    // change; scores of other rows drift slightly and are refreshed when next dirtied
+    dirtyRows.insert(bookSlot);
+    if (patronBooks[patron].size() <= maxBooksPerPatron) {
+        for (uint32_t other : patronBooks[patron]) dirtyRows.insert(other);
+    }
+}
+
+const std::vector<CoBorrowingModel::Entry>* CoBorrowingModel::patchedRow(uint32_t book) {
+    if (dirtyRows.erase(book)) {
+        scratchCounts.resize(bookIds.size(), 0);
+        std::vector<uint32_t> touched;
+        std::vector<Entry> candidates;
+        computeRow(book, scratchCounts, touched, candidates);
+        patchedRows[book].assign(candidates.begin(), candidates.end());
+        if (patchedRows.size() > rowOffsets.size() / 8 + 64) {
+            compact();
+            return nullptr;
+        }
+    }
+    auto it = patchedRows.find(book);
+    return it == patchedRows.end() ? nullptr : &it->second;
+}
+
+// Folds the patched rows (and books added since the build) into a new CSR
+void CoBorrowingModel::compact() {
+    const size_t books = bookIds.size();
+    const size_t built = rowOffsets.empty() ? 0 : rowOffsets.size() - 1;
+    std::vector<uint32_t> offsets(books + 1, 0);
+    std::vector<Entry> packed;
+    packed.reserve(entries.size() + patchedRows.size() * neighborsPerBook);
+    for (size_t book = 0; book < books; ++book) {
+        auto patch = patchedRows.find(static_cast<uint32_t>(book));
+        if (patch != patchedRows.end()) {
+            packed.insert(packed.end(), patch->second.begin(), patch->second.end());
+        } else if (book < built) {
+            packed.insert(packed.end(), entries.begin() + rowOffsets[book], entries.begin() + rowOffsets[book + 1]);
+        }
+        offsets[book + 1] = static_cast<uint32_t>(packed.size());
+    }
+    rowOffsets = std::move(offsets);
+    entries = std::move(packed);
+    patchedRows.clear();
+}
+
+std::vector<BookNeighbor> CoBorrowingModel::neighbors(int bookId, size_t k) {
+    std::vector<BookNeighbor> result;
+    auto slot = bookIndex.find(bookId);
+    if (slot == bookIndex.end()) return result;
+    const uint32_t book = slot->second;
+
+    const Entry* begin = nullptr;
+    const Entry* end = nullptr;
+    if (const std::vector<Entry>* patch = patchedRow(book)) {
+        begin = patch->data();
+        end = begin + patch->size();
+    } else if (book + 1 < rowOffsets.size()) {
+        begin = entries.data() + rowOffsets[book];
+        end = entries.data() + rowOffsets[book + 1];
+    }
+    for (const Entry* entry = begin; entry != end && result.size() < k; ++entry) {
+        result.push_back(BookNeighbor{bookIds[entry->book], static_cast<int>(entry->coBorrowers), entry->score});
+    }
+    return result;
+}
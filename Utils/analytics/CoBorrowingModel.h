@@ -0,0 +1,67 @@
+#ifndef CO_BORROWING_MODEL_H
+#define CO_BORROWING_MODEL_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../../Core Classes/LoanManager.h"
+
+struct BookNeighbor {
+    int bookId;
+    int coBorrowers;    // patrons who borrowed both books
+    float score;        // cosine similarity of the two borrower sets
+};
+
+// Item-item "patrons who borrowed this also borrowed" model. Each book keeps
+// its top neighbors by cosine similarity of borrower sets, stored in one CSR
+// array (row offsets + neighbor entries). A borrow that adds a new
+// (patron, book) pair marks the rows it affects dirty; a dirty row is
+// recomputed on its next lookup into a patch, and patches are folded back
+// into the CSR once there are many of them.
+// Not thread-safe: fed by LoanManager and queried from the same thread.
+class CoBorrowingModel : public LoanEventListener {
+public:
+    static const size_t neighborsPerBook = 10;
+    // Patrons with more distinct books than this (bulk or staff accounts)
+    // would add quadratic noise, so they do not link books together
+    static const size_t maxBooksPerPatron = 500;
+
+    void onBorrow(const LoanTransaction& loan, const Book& book) override;
+
+    // Replaces the model with one built from a loaded history (rows in parallel)
+    void rebuild(const LoanHistory& history);
+
+    // Best first, at most k (and at most neighborsPerBook)
+    std::vector<BookNeighbor> neighbors(int bookId, size_t k);
+
+private:
+    struct Entry {
+        uint32_t book;      // dense book index
+        uint32_t coBorrowers;
+        float score;
+    };
+
+    std::unordered_map<int, uint32_t> bookIndex;
+    std::vector<int> bookIds;
+    std::unordered_map<int, uint32_t> patronIndex;
+    std::vector<std::vector<uint32_t>> bookPatrons;     // sorted dense patron indexes
+    std::vector<std::vector<uint32_t>> patronBooks;     // sorted dense book indexes
+
+    std::vector<uint32_t> rowOffsets;                   // CSR rows for the books at build time
+    std::vector<Entry> entries;
+    std::unordered_map<uint32_t, std::vector<Entry>> patchedRows;
+    std::unordered_set<uint32_t> dirtyRows;
+    std::vector<uint32_t> scratchCounts;
+
+    static uint32_t intern(int id, std::unordered_map<int, uint32_t>& index,
+                           std::vector<std::vector<uint32_t>>& lists);
+    static bool insertSorted(std::vector<uint32_t>& list, uint32_t value);
+    void computeRow(uint32_t book, std::vector<uint32_t>& counts, std::vector<uint32_t>& touched,
+                    std::vector<Entry>& row) const;
+    const std::vector<Entry>* patchedRow(uint32_t book);
+    void compact();
+};
+
+#endif // CO_BORROWING_MODEL_H
@@ -0,0 +1,90 @@
+#ifndef DAY_NUMBER_H
+#define DAY_NUMBER_H
+
+#include <climits>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// Dates as days since 1970-01-01, for bucketing loans by day without
+// going through mktime. Conversions use Hinnant's civil calendar algorithms.
+
+const int kInvalidDay = INT_MIN;
+
+inline int daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int>(doe) - 719468;
+}
+
+// "YYYY-MM-DD" -> day number, or kInvalidDay
+inline int dayNumber(std::string_view date) {
+    if (date.size() < 10 || date[4] != '-' || date[7] != '-') return kInvalidDay;
+    auto digits = [&date](size_t pos, size_t count, int& value) {
+        value = 0;
+        for (size_t i = pos; i < pos + count; ++i) {
+            if (date[i] < '0' || date[i] > '9') return false;
+            value = value * 10 + (date[i] - '0');
+        }
+        return true;
+    };
+    int year, month, day;
+    if (!digits(0, 4, year) || !digits(5, 2, month) || !digits(8, 2, day)) return kInvalidDay;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return kInvalidDay;
+    return daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+}
+
+// Day number -> calendar date
+inline void civilFromDays(int days, int& year, unsigned& month, unsigned& day) {
+    const int z = days + 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int>(yoe) + era * 400 + (month <= 2);
+}
+
+// First day of the month containing a day number
+inline int monthStart(int days) {
+    int year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    return daysFromCivil(year, month, 1);
+}
+
+// Day number -> "YYYY-MM-DD"
+inline std::string dateFromDayNumber(int days) {
+    int year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+
+    char text[11];
+    text[0] = char('0' + year / 1000 % 10);
+    text[1] = char('0' + year / 100 % 10);
+    text[2] = char('0' + year / 10 % 10);
+    text[3] = char('0' + year % 10);
+    text[4] = '-';
+    text[5] = char('0' + month / 10);
+    text[6] = char('0' + month % 10);
+    text[7] = '-';
+    text[8] = char('0' + day / 10);
+    text[9] = char('0' + day % 10);
+    text[10] = '\0';
+    return text;
+}
+
+// Today's local date, the same calendar LoanManager writes dates in
+inline int todayDayNumber() {
+    std::time_t now = std::time(nullptr);
+    std::tm local = *std::localtime(&now);
+    return daysFromCivil(local.tm_year + 1900, static_cast<unsigned>(local.tm_mon + 1),
+                         static_cast<unsigned>(local.tm_mday));
+}
+
+#endif // DAY_NUMBER_H
@@ -0,0 +1,160 @@
+#include "HyperLogLog.h"
+#include <algorithm>
+#include <cmath>
+
+uint64_t HyperLogLog::hashId(uint64_t id) {
+    uint64_t z = id + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+namespace {
+// Ertl, "New cardinality estimation algorithms for HyperLogLog sketches" (2017)
+double sigma(double x) {
+    double y = 1.0, z = x, previous;
+    do {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (z != previous);
+    return z;
+}
+
+double tau(double x) {
+    if (x == 0.0 || x == 1.0) return 0.0;
+    double y = 1.0, z = 1.0 - x, previous;
+    do {
+        x = std::sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    } while (z != previous);
+    return z / 3.0;
+}
+}
+
+// Position of the first set bit after the index bits; the sentinel caps it at 65 - indexBits
+uint8_t HyperLogLog::rankOf(uint64_t hash, int indexBits) {
+    uint64_t rest = (hash << indexBits) | (1ULL << (indexBits - 1));
+    uint8_t rank = 1;
+    while (!(rest & (1ULL << 63))) {
+        rest <<= 1;
+        ++rank;
+    }
+    return rank;
+}
+
+void HyperLogLog::add(uint64_t hash) {
+    if (dense) {
+        setRegister(static_cast<uint32_t>(hash >> (64 - precision)), rankOf(hash, precision));
+        return;
+    }
+    uint32_t index = static_cast<uint32_t>(hash >> (64 - sparsePrecision));
+    setSparse((index << 6) | rankOf(hash, sparsePrecision));
+}
+
+void HyperLogLog::setRegister(uint32_t index, uint8_t rank) {
+    registers[index] = std::max(registers[index], rank);
+}
+
+void HyperLogLog::setSparse(uint32_t entry) {
+    auto it = std::lower_bound(sparse.begin(), sparse.end(), entry & ~0x3fu);
+    if (it != sparse.end() && (*it >> 6) == (entry >> 6)) {
+        *it = std::max(*it, entry);
+        return;
+    }
+    sparse.insert(it, entry);
+    // Four bytes per sparse entry against one per dense register
+    if (sparse.size() * sizeof(uint32_t) > registerCount) toDense();
+}
+
+// The bits of the sparse index below the dense index come first in the rank
+void HyperLogLog::setFromSparse(uint32_t entry) {
+    const int extraBits = sparsePrecision - precision;
+    uint32_t sparseIndex = entry >> 6;
+    uint32_t extra = sparseIndex & ((1u << extraBits) - 1);
+    uint8_t rank;
+    if (extra != 0) {
+        rank = 1;
+        for (uint32_t bit = 1u << (extraBits - 1); !(extra & bit); bit >>= 1) ++rank;
+    } else {
+        rank = static_cast<uint8_t>(extraBits + (entry & 0x3f));
+    }
+    setRegister(sparseIndex >> extraBits, rank);
+}
+
+void HyperLogLog::toDense() {
+    registers.assign(registerCount, 0);
+    dense = true;
+    for (uint32_t entry : sparse) setFromSparse(entry);
+    sparse.clear();
+    sparse.shrink_to_fit();
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.dense) {
+        if (!dense) toDense();
+        for (uint32_t i = 0; i < registerCount; ++i) {
+            setRegister(i, other.registers[i]);
+        }
+        return;
+    }
+    for (uint32_t entry : other.sparse) {
+        if (dense) {
+            setFromSparse(entry);
+        } else {
+            setSparse(entry);
+        }
+    }
+}
+
+double HyperLogLog::estimate() const {
+    if (!dense) {
+        // Linear counting over 2^25 slots is near exact at sparse sizes
+        const double slots = 1u << sparsePrecision;
+        return slots * std::log(slots / (slots - static_cast<double>(sparse.size())));
+    }
+
+    const int maxRank = 64 - precision + 1;
+    uint32_t counts[maxRank + 1] = {};
+    for (uint8_t rank : registers) ++counts[rank];
+    const double m = registerCount;
+    if (counts[0] == registerCount) return 0.0;
+
+    double z = m * tau(1.0 - counts[maxRank] / m);
+    for (int rank = maxRank - 1; rank >= 1; --rank) {
+        z = 0.5 * (z + counts[rank]);
+    }
+    z += m * sigma(counts[0] / m);
+    return 0.5 / std::log(2.0) * m * m / z;
+}
+
+void HyperLogLog::write(std::ostream& out) const {
+    uint8_t mode = dense ? 1 : 0;
+    out.write(reinterpret_cast<const char*>(&mode), 1);
+    if (dense) {
+        out.write(reinterpret_cast<const char*>(registers.data()), registers.size());
+        return;
+    }
+    uint32_t count = static_cast<uint32_t>(sparse.size());
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(sparse.data()), count * sizeof(uint32_t));
+}
+
+bool HyperLogLog::read(std::istream& in) {
+    uint8_t mode = 0;
+    if (!in.read(reinterpret_cast<char*>(&mode), 1)) return false;
+    dense = mode == 1;
+    sparse.clear();
+    registers.clear();
+    if (dense) {
+        registers.resize(registerCount);
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(registers.data()), registerCount));
+    }
+    uint32_t count = 0;
+    if (!in.read(reinterpret_cast<char*>(&count), sizeof(count)) || count > registerCount / sizeof(uint32_t)) return false;
+    sparse.resize(count);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(sparse.data()), count * sizeof(uint32_t)));
+}
@@ -0,0 +1,45 @@
+#ifndef HYPER_LOG_LOG_H
+#define HYPER_LOG_LOG_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// HyperLogLog distinct counter with 2^12 registers (about 1.6% standard error).
+// A sketch starts sparse (sorted index/rank pairs at 2^25 precision, four
+// bytes per distinct value and near exact) and switches to 4 KB of dense
+// registers once that is smaller, so the many rarely borrowed books stay
+// cheap. Dense sketches use Ertl's improved estimator, which needs no bias
+// tables. Sketches merge losslessly.
+class HyperLogLog {
+public:
+    static const int precision = 12;
+    static const uint32_t registerCount = 1u << precision;
+    static const int sparsePrecision = 25;
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+    bool empty() const { return !dense && sparse.empty(); }
+    bool isDense() const { return dense; }
+
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+
+    // 64-bit mix of an integer id (splitmix64 finalizer)
+    static uint64_t hashId(uint64_t id);
+
+private:
+    bool dense = false;
+    std::vector<uint32_t> sparse;       // (sparse index << 6 | rank), sorted, one per index
+    std::vector<uint8_t> registers;     // dense mode
+
+    static uint8_t rankOf(uint64_t hash, int indexBits);
+    void setRegister(uint32_t index, uint8_t rank);
+    void setSparse(uint32_t entry);
+    void setFromSparse(uint32_t entry);
+    void toDense();
+};
+
+#endif // HYPER_LOG_LOG_H
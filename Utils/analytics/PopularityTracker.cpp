@@ -0,0 +1,190 @@
+#include "PopularityTracker.h"
+#include <algorithm>
+#include "DayNumber.h"
+#include "../metrics/MemoryTracker.h"
+#include "../concurrency/ThreadPool.h"
+
+void PopularityTracker::RankedCounts::add(int id, long long delta) {
+    auto it = counts.find(id);
+    long long previous = it == counts.end() ? 0 : it->second;
+    long long current = previous + delta;
+
+    if (ranked && previous != 0) ranking.erase({-previous, id});
+    if (current == 0) {
+        if (it != counts.end()) counts.erase(it);
+        return;
+    }
+    if (it == counts.end()) {
+        counts.emplace(id, current);
+    } else {
+        it->second = current;
+    }
+    if (ranked) ranking.insert({-current, id});
+}
+
+long long PopularityTracker::RankedCounts::get(int id) const {
+    auto it = counts.find(id);
+    return it == counts.end() ? 0 : it->second;
+}
+
+std::vector<std::pair<int, long long>> PopularityTracker::RankedCounts::top(size_t k) {
+    if (!ranked) {
+        for (const auto& entry : counts) ranking.insert({-entry.second, entry.first});
+        ranked = true;
+    }
+    std::vector<std::pair<int, long long>> result;
+    for (auto it = ranking.begin(); it != ranking.end() && result.size() < k; ++it) {
+        result.emplace_back(it->second, -it->first);
+    }
+    return result;
+}
+
+PopularityTracker::PopularityTracker() : today(todayDayNumber()) {}
+
+int PopularityTracker::windowDays(PopularityWindow window) {
+    switch (window) {
+        case PopularityWindow::Last30Days: return 30;
+        case PopularityWindow::Last90Days: return 90;
+        case PopularityWindow::Last365Days: return 365;
+        default: return 0;
+    }
+}
+
+const char* PopularityTracker::windowName(PopularityWindow window) {
+    switch (window) {
+        case PopularityWindow::Last30Days: return "Last 30 days";
+        case PopularityWindow::Last90Days: return "Last 90 days";
+        case PopularityWindow::Last365Days: return "Last 365 days";
+        default: return "All time";
+    }
+}
+
+int PopularityTracker::intern(const std::string& name, std::unordered_map<std::string, int>& ids,
+                              std::vector<std::string>& names) {
+    auto inserted = ids.emplace(name, static_cast<int>(names.size()));
+    if (inserted.second) names.push_back(name);
+    return inserted.first->second;
+}
+
+const PopularityTracker::BookKeys& PopularityTracker::keysFor(const Book& book) {
+    auto it = bookKeys.find(book.getId());
+    if (it != bookKeys.end()) return it->second;
+    BookKeys keys{intern(book.getCategory(), categoryIds, categoryNames),
+                  intern(book.getAuthor(), authorIds, authorNames)};
+    return bookKeys.emplace(book.getId(), keys).first->second;
+}
+
+void PopularityTracker::addToWindow(int window, int bookId, long long delta) {
+    const BookKeys& keys = bookKeys.at(bookId);
+    counters[static_cast<int>(PopularityDimension::Book)][window].add(bookId, delta);
+    counters[static_cast<int>(PopularityDimension::Category)][window].add(keys.category, delta);
+    counters[static_cast<int>(PopularityDimension::Author)][window].add(keys.author, delta);
+}
+
+void PopularityTracker::onBorrow(const LoanTransaction& loan, const Book& book) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    keysFor(book);
+    addToWindow(static_cast<int>(PopularityWindow::AllTime), book.getId(), 1);
+
+    int day = dayNumber(loan.borrowDate);
+    if (day == kInvalidDay) return;
+    if (day > today) advanceTo(day);
+    if (day <= today - windowDays(PopularityWindow::Last365Days)) return;
+
+    dayBuckets[day][book.getId()] += 1;
+    addToWindows(day, book.getId(), 1);
+}
+
+void PopularityTracker::addToWindows(int day, int bookId, long long delta) {
+    for (int window = 0; window < static_cast<int>(PopularityWindow::AllTime); ++window) {
+        if (day > today - windowDays(static_cast<PopularityWindow>(window))) {
+            addToWindow(window, bookId, delta);
+        }
+    }
+}
+
+void PopularityTracker::rebuild(const LoanHistory& history,
+                                const std::function<const Book*(int)>& findBook) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    for (auto& dimension : counters) {
+        for (auto& counter : dimension) counter = RankedCounts();
+    }
+    dayBuckets.clear();
+    today = std::max(today, todayDayNumber());
+    const int oldestDay = today - windowDays(PopularityWindow::Last365Days);
+
+    struct Partial {
+        std::unordered_map<int, long long> allTime;       // bookId -> borrows
+        std::unordered_map<long long, int> recent;        // (day, bookId) -> borrows
+    };
+    auto dayBookKey = [](int day, int bookId) {
+        return (static_cast<long long>(day) << 32) | static_cast<unsigned int>(bookId);
+    };
+    Partial totals = parallelReduce(size_t(0), history.size(), size_t(65536), Partial{},
+        [&](size_t lo, size_t hi) {
+            ScopedMemoryTag workerTag(MemorySubsystem::Analytics);
+            Partial partial;
+            for (size_t i = lo; i < hi; ++i) {
+                const LoanTransaction& loan = *history[i];
+                ++partial.allTime[loan.bookId];
+                int day = dayNumber(loan.borrowDate);
+                if (day != kInvalidDay && day > oldestDay) ++partial.recent[dayBookKey(day, loan.bookId)];
+            }
+            return partial;
+        },
+        [](Partial a, const Partial& b) {
+            for (const auto& entry : b.allTime) a.allTime[entry.first] += entry.second;
+            for (const auto& entry : b.recent) a.recent[entry.first] += entry.second;
+            return a;
+        });
+
+    for (const auto& entry : totals.allTime) {
+        const Book* book = findBook(entry.first);
+        if (!book) continue;
+        keysFor(*book);
+        addToWindow(static_cast<int>(PopularityWindow::AllTime), entry.first, entry.second);
+    }
+    for (const auto& entry : totals.recent) {
+        int day = static_cast<int>(entry.first >> 32);
+        int bookId = static_cast<int>(entry.first & 0xffffffff);
+        if (!bookKeys.count(bookId)) continue; // unknown book
+        dayBuckets[day][bookId] += entry.second;
+        addToWindows(day, bookId, entry.second);
+    }
+}
+
+void PopularityTracker::advanceTo(int day) {
+    if (day <= today) return;
+    // Days in (today - length, day - length] drop out of a window of that length
+    for (int window = 0; window < static_cast<int>(PopularityWindow::AllTime); ++window) {
+        int length = windowDays(static_cast<PopularityWindow>(window));
+        for (auto it = dayBuckets.upper_bound(today - length);
+             it != dayBuckets.end() && it->first <= day - length; ++it) {
+            for (const auto& entry : it->second) {
+                addToWindow(window, entry.first, -entry.second);
+            }
+        }
+    }
+    today = day;
+    dayBuckets.erase(dayBuckets.begin(),
+                     dayBuckets.upper_bound(today - windowDays(PopularityWindow::Last365Days)));
+}
+
+std::vector<PopularityEntry> PopularityTracker::top(PopularityDimension dimension, PopularityWindow window, size_t k) {
+    ScopedMemoryTag tag(MemorySubsystem::Analytics);
+    advanceTo(todayDayNumber());
+
+    std::vector<PopularityEntry> result;
+    for (const auto& entry : counters[static_cast<int>(dimension)][static_cast<int>(window)].top(k)) {
+        std::string name;
+        if (dimension == PopularityDimension::Category) name = categoryNames[entry.first];
+        if (dimension == PopularityDimension::Author) name = authorNames[entry.first];
+        result.push_back(PopularityEntry{entry.first, name, entry.second});
+    }
+    return result;
+}
+
+long long PopularityTracker::borrows(PopularityDimension dimension, PopularityWindow window, int id) {
+    advanceTo(todayDayNumber());
+    return counters[static_cast<int>(dimension)][static_cast<int>(window)].get(id);
+}
@@ -0,0 +1,100 @@
+#ifndef POPULARITY_TRACKER_H
+#define POPULARITY_TRACKER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../../Core Classes/LoanManager.h"
+
+enum class PopularityDimension {
+    Book,
+    Category,
+    Author,
+    Count
+};
+
+enum class PopularityWindow {
+    Last30Days,
+    Last90Days,
+    Last365Days,
+    AllTime,
+    Count
+};
+
+struct PopularityEntry {
+    int id;             // book id, or the tracker's id for a category/author
+    std::string name;   // category or author name; empty for books
+    long long borrows;
+};
+
+// Borrow counts per book, category and author, over sliding 30/90/365-day
+// windows and all time. Counts are exact and updated per borrow; a window
+// moves forward by subtracting the day buckets that fall out of it, so the
+// history is never rescanned. The top-k ranking of a counter is built on its
+// first query and maintained incrementally after that.
+// Not thread-safe: fed by LoanManager and queried from the same thread.
+class PopularityTracker : public LoanEventListener {
+public:
+    PopularityTracker();
+
+    void onBorrow(const LoanTransaction& loan, const Book& book) override;
+
+    // Replaces all counts with those of a loaded history. Borrows are
+    // aggregated per book (and per day within the last year) in parallel and
+    // applied once per book, which is much cheaper than one event per loan.
+    void rebuild(const LoanHistory& history,
+                 const std::function<const Book*(int)>& findBook);
+
+    // Highest counts first; ties by id
+    std::vector<PopularityEntry> top(PopularityDimension dimension, PopularityWindow window, size_t k);
+    long long borrows(PopularityDimension dimension, PopularityWindow window, int id);
+
+    static int windowDays(PopularityWindow window); // 0 for AllTime
+    static const char* windowName(PopularityWindow window);
+
+private:
+    // Exact counts with an ordered index for top-k queries
+    class RankedCounts {
+    public:
+        void add(int id, long long delta);
+        long long get(int id) const;
+        std::vector<std::pair<int, long long>> top(size_t k);
+    private:
+        std::unordered_map<int, long long> counts;
+        std::set<std::pair<long long, int>> ranking; // (-count, id), so begin() is the highest
+        bool ranked = false;
+    };
+
+    struct BookKeys {
+        int category;
+        int author;
+    };
+
+    static const int dimensions = static_cast<int>(PopularityDimension::Count);
+    static const int windows = static_cast<int>(PopularityWindow::Count);
+
+    RankedCounts counters[dimensions][windows];
+    // Borrows per book for each of the last 365 days (day number -> book -> borrows)
+    std::map<int, std::unordered_map<int, int>> dayBuckets;
+    int today;
+
+    std::unordered_map<int, BookKeys> bookKeys;
+    std::unordered_map<std::string, int> categoryIds;
+    std::unordered_map<std::string, int> authorIds;
+    std::vector<std::string> categoryNames;
+    std::vector<std::string> authorNames;
+
+    const BookKeys& keysFor(const Book& book);
+    static int intern(const std::string& name, std::unordered_map<std::string, int>& ids,
+                      std::vector<std::string>& names);
+    void addToWindow(int window, int bookId, long long delta);
+    void addToWindows(int day, int bookId, long long delta);
+    void advanceTo(int day);
+};
+
+#endif // POPULARITY_TRACKER_H
@@ -0,0 +1,393 @@
+#include "TransactionArchive.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+#include "Varint.h"
+#include "../analytics/DayNumber.h"
+#include "../checksum/Crc32c.h"
+#include "../concurrency/ThreadPool.h"
+#include "../metrics/LatencyHistogram.h"
+#include "../metrics/MemoryTracker.h"
+#include "../metrics/Tracer.h"
+#include "../storage/AtomicFile.h"
+
+namespace {
+const char fileMagic[8] = {'L', 'O', 'A', 'N', 'A', 'R', 'C', 'H'};
+const uint32_t fileVersion = 1;
+const uint32_t idsAscendingFlag = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t rowCount;
+    uint64_t indexOffset;
+    uint32_t blockCount;
+    uint32_t indexCrc;
+    uint32_t reserved;
+    uint32_t headerCrc;     // of the bytes before it
+};
+static_assert(sizeof(Header) == 48, "the header is part of the file format");
+
+enum Column { IdColumn, UserColumn, BookColumn, BorrowColumn, DueColumn, ReturnColumn, FineColumn, ReturnedColumn,
+              ColumnCount };
+
+// The day number of a date that dateFromDayNumber writes back identically
+int plainDay(const std::string& text) {
+    if (text.size() != 10) return kInvalidDay;
+    const int day = dayNumber(text);
+    if (day == kInvalidDay) return kInvalidDay;
+    int year;
+    unsigned month, dayOfMonth;
+    civilFromDays(day, year, month, dayOfMonth);
+    const bool roundTrips = static_cast<unsigned>((text[5] - '0') * 10 + (text[6] - '0')) == month &&
+                            static_cast<unsigned>((text[8] - '0') * 10 + (text[9] - '0')) == dayOfMonth;
+    return roundTrips ? day : kInvalidDay;
+}
+
+// 0 = empty, 1 = verbatim text, otherwise days from anchor (zigzag) + 2
+void putDate(std::string& out, const std::string& text, int day, int64_t anchor) {
+    if (text.empty()) {
+        putVarint(out, 0);
+    } else if (day == kInvalidDay) {
+        putVarint(out, 1);
+        putVarint(out, text.size());
+        out += text;
+    } else {
+        putVarint(out, zigzag(day - anchor) + 2);
+    }
+}
+
+// The day read, or kInvalidDay for an empty or verbatim date
+int readDate(VarintReader& in, int64_t anchor, std::string& text) {
+    const uint64_t code = in.varint();
+    if (code == 0) {
+        text.clear();
+        return kInvalidDay;
+    }
+    if (code == 1) {
+        const size_t length = static_cast<size_t>(in.varint());
+        const unsigned char* bytes = in.bytes(length);
+        text.assign(bytes ? reinterpret_cast<const char*>(bytes) : "", bytes ? length : 0);
+        return kInvalidDay;
+    }
+    const int day = static_cast<int>(anchor + unzigzag(code - 2));
+    text = dateFromDayNumber(day);
+    return day;
+}
+
+bool wholeCents(double fine, int64_t& cents) {
+    const double rounded = std::round(fine * 100.0);
+    if (!(std::abs(rounded) < 1e15) || rounded / 100.0 != fine) return false;
+    cents = static_cast<int64_t>(rounded);
+    return true;
+}
+
+// The block payload: each column as a varint length and its bytes
+std::string encodeBlock(const TransactionArchive::Rows& rows, size_t first, size_t last, int32_t& minBorrowDay,
+                        int32_t& maxBorrowDay) {
+    std::string columns[ColumnCount];
+    minBorrowDay = INT_MAX;
+    maxBorrowDay = INT_MIN;
+
+    // Fines are stored in units of the largest amount that divides them all
+    int64_t fineUnit = 0;
+    bool centsOnly = true;
+    for (size_t i = first; i < last && centsOnly; ++i) {
+        int64_t cents = 0;
+        centsOnly = wholeCents(rows[i]->fine, cents);
+        fineUnit = std::gcd(fineUnit, cents < 0 ? -cents : cents);
+    }
+    if (!centsOnly) fineUnit = 0;           // raw doubles
+    else if (fineUnit == 0) fineUnit = 1;   // all zero
+    putVarint(columns[FineColumn], static_cast<uint64_t>(fineUnit));
+
+    int64_t previousId = 0;
+    int64_t anchor = 0;     // the last plain borrow day
+    bool plainBorrowDates = true;
+    columns[ReturnedColumn].assign((last - first + 7) / 8, '\0');
+    for (size_t i = first; i < last; ++i) {
+        const LoanTransaction& t = *rows[i];
+        putVarint(columns[IdColumn], zigzag(static_cast<int64_t>(t.transactionId) - previousId));
+        previousId = t.transactionId;
+        putVarint(columns[UserColumn], zigzag(t.userId));
+        putVarint(columns[BookColumn], zigzag(t.bookId));
+
+        const int borrowDay = plainDay(t.borrowDate);
+        putDate(columns[BorrowColumn], t.borrowDate, borrowDay, anchor);
+        if (borrowDay != kInvalidDay) {
+            anchor = borrowDay;
+            minBorrowDay = std::min(minBorrowDay, borrowDay);
+            maxBorrowDay = std::max(maxBorrowDay, borrowDay);
+        } else {
+            plainBorrowDates = false;
+        }
+        putDate(columns[DueColumn], t.dueDate, plainDay(t.dueDate), anchor);
+        putDate(columns[ReturnColumn], t.returnDate, plainDay(t.returnDate), anchor);
+
+        if (fineUnit == 0) {
+            char raw[sizeof(double)];
+            std::memcpy(raw, &t.fine, sizeof(raw));
+            columns[FineColumn].append(raw, sizeof(raw));
+        } else {
+            int64_t cents = 0;
+            wholeCents(t.fine, cents);
+            putVarint(columns[FineColumn], zigzag(cents / fineUnit));
+        }
+        if (t.isReturned) columns[ReturnedColumn][(i - first) / 8] |= static_cast<char>(1 << ((i - first) % 8));
+    }
+    // A block with unparsable borrow dates is searched for every date range
+    if (!plainBorrowDates || minBorrowDay == INT_MAX) {
+        minBorrowDay = INT_MIN;
+        maxBorrowDay = INT_MAX;
+    }
+
+    std::string payload;
+    for (const std::string& column : columns) {
+        putVarint(payload, column.size());
+        payload += column;
+    }
+    return payload;
+}
+}
+
+bool TransactionArchive::write(const std::string& filename, const Rows& transactions) {
+    ScopedTraceSpan span("TransactionArchive::write");
+    ScopedLatencyTimer timer(MetricOperation::SaveTransactions);
+    const std::string tempFile = filename + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    Header header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.rowCount = transactions.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));   // filled in at the end
+
+    std::vector<BlockEntry> entries;
+    uint64_t offset = sizeof(header);
+    bool ascending = true;
+    for (size_t first = 0; first < transactions.size(); first += rowsPerBlock) {
+        const size_t last = std::min(transactions.size(), first + rowsPerBlock);
+        BlockEntry entry{};
+        const std::string payload = encodeBlock(transactions, first, last, entry.minBorrowDay, entry.maxBorrowDay);
+        entry.offset = offset;
+        entry.length = static_cast<uint32_t>(payload.size());
+        entry.rows = static_cast<uint32_t>(last - first);
+        entry.crc = crc32c(payload.data(), payload.size());
+        entry.minId = INT_MAX;
+        entry.maxId = INT_MIN;
+        for (size_t i = first; i < last; ++i) {
+            const int id = transactions[i]->transactionId;
+            if (i > 0 && id <= transactions[i - 1]->transactionId) ascending = false;
+            entry.minId = std::min(entry.minId, id);
+            entry.maxId = std::max(entry.maxId, id);
+        }
+        out.write(payload.data(), payload.size());
+        offset += payload.size();
+        entries.push_back(entry);
+    }
+
+    header.flags = ascending ? idsAscendingFlag : 0;
+    header.indexOffset = offset;
+    header.blockCount = static_cast<uint32_t>(entries.size());
+    header.indexCrc = crc32c(entries.data(), entries.size() * sizeof(BlockEntry));
+    header.headerCrc = crc32c(&header, offsetof(Header, headerCrc));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(BlockEntry));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (out.fail()) {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return replaceFile(tempFile, filename);
+}
+
+bool TransactionArchive::open(const std::string& filename, std::string* error) {
+    auto fail = [&](const char* reason) {
+        if (error) *error = reason;
+        file.close();
+        index.clear();
+        rowCount = 0;
+        return false;
+    };
+    file.close();
+    file.clear();
+    file.open(filename, std::ios::binary);
+    if (!file) return fail("cannot open file");
+
+    Header header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return fail("truncated header");
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0) return fail("not a transaction archive");
+    if (header.version != fileVersion) return fail("unsupported archive version");
+    if (header.headerCrc != crc32c(&header, offsetof(Header, headerCrc))) return fail("header checksum mismatch");
+
+    index.resize(header.blockCount);
+    file.seekg(static_cast<std::streamoff>(header.indexOffset));
+    if (!file.read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(BlockEntry))) {
+        return fail("truncated block index");
+    }
+    if (header.indexCrc != crc32c(index.data(), index.size() * sizeof(BlockEntry))) {
+        return fail("block index checksum mismatch");
+    }
+    uint64_t rows = 0;
+    for (const BlockEntry& entry : index) {
+        if (entry.offset < sizeof(Header) || entry.offset + entry.length > header.indexOffset) {
+            return fail("block index points outside the file");
+        }
+        rows += entry.rows;
+    }
+    if (rows != header.rowCount) return fail("block index does not add up to the row count");
+    rowCount = static_cast<size_t>(header.rowCount);
+    idsAscending = (header.flags & idsAscendingFlag) != 0;
+    return true;
+}
+
+bool TransactionArchive::decodeBlock(const BlockEntry& entry, const unsigned char* payload, Rows& rows) {
+    if (crc32c(payload, entry.length) != entry.crc) return false;
+    VarintReader in(payload, payload + entry.length);
+    VarintReader columns[ColumnCount];
+    for (VarintReader& column : columns) {
+        const size_t length = static_cast<size_t>(in.varint());
+        const unsigned char* bytes = in.bytes(length);
+        if (!bytes) return false;
+        column = VarintReader(bytes, bytes + length);
+    }
+    const unsigned char* returned = columns[ReturnedColumn].bytes((entry.rows + 7) / 8);
+    const int64_t fineUnit = static_cast<int64_t>(columns[FineColumn].varint());
+    if (!returned) return false;
+
+    rows.reserve(rows.size() + entry.rows);
+    int64_t id = 0;
+    int64_t anchor = 0;
+    std::string borrow, due, returnDate;
+    for (uint32_t i = 0; i < entry.rows; ++i) {
+        id += columns[IdColumn].signedVarint();
+        const int userId = static_cast<int>(columns[UserColumn].signedVarint());
+        const int bookId = static_cast<int>(columns[BookColumn].signedVarint());
+        const int borrowDay = readDate(columns[BorrowColumn], anchor, borrow);
+        if (borrowDay != kInvalidDay) anchor = borrowDay;
+        readDate(columns[DueColumn], anchor, due);
+        readDate(columns[ReturnColumn], anchor, returnDate);
+        double fine = 0.0;
+        if (fineUnit == 0) {
+            if (const unsigned char* raw = columns[FineColumn].bytes(sizeof(fine))) std::memcpy(&fine, raw, sizeof(fine));
+        } else {
+            fine = static_cast<double>(columns[FineColumn].signedVarint() * fineUnit) / 100.0;
+        }
+
+        auto transaction = std::make_unique<LoanTransaction>(static_cast<int>(id), userId, bookId, borrow, due);
+        transaction->returnDate = returnDate;
+        transaction->fine = fine;
+        transaction->isReturned = (returned[i / 8] >> (i % 8)) & 1;
+        rows.push_back(std::move(transaction));
+    }
+    for (const VarintReader& column : columns) {
+        if (!column.ok()) return false;
+    }
+    return true;
+}
+
+bool TransactionArchive::readAll(Rows& rows, std::string* error) {
+    ScopedTraceSpan span("TransactionArchive::readAll");
+    ScopedLatencyTimer timer(MetricOperation::LoadTransactions);
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    rows.clear();
+    if (index.empty()) return true;
+
+    // One read for every block, then each block is checked and decoded on its own
+    uint64_t begin = UINT64_MAX;
+    uint64_t end = 0;
+    for (const BlockEntry& entry : index) {
+        begin = std::min(begin, entry.offset);
+        end = std::max(end, entry.offset + entry.length);
+    }
+    std::string bytes(static_cast<size_t>(end - begin), '\0');
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(begin));
+    if (!file.read(&bytes[0], static_cast<std::streamsize>(bytes.size()))) {
+        if (error) *error = "truncated blocks";
+        return false;
+    }
+    const unsigned char* blockBytes = reinterpret_cast<const unsigned char*>(bytes.data());
+
+    std::vector<Rows> blocks(index.size());
+    std::vector<char> decoded(index.size(), 0);
+    parallelFor(0, index.size(), 1, [&](size_t lo, size_t hi) {
+        ScopedMemoryTag blockTag(MemorySubsystem::Transactions);
+        for (size_t block = lo; block < hi; ++block) {
+            const BlockEntry& entry = index[block];
+            decoded[block] = decodeBlock(entry, blockBytes + (entry.offset - begin), blocks[block]);
+        }
+    });
+    for (size_t block = 0; block < index.size(); ++block) {
+        if (!decoded[block]) {
+            if (error) *error = "block " + std::to_string(block) + " is damaged (checksum or encoding)";
+            return false;
+        }
+    }
+    rows.reserve(rowCount);
+    for (Rows& block : blocks) {
+        std::move(block.begin(), block.end(), std::back_inserter(rows));
+    }
+    return true;
+}
+
+bool TransactionArchive::readBlock(size_t block, Rows& rows) {
+    const BlockEntry& entry = index[block];
+    blockBytes.resize(entry.length);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(entry.offset));
+    if (!file.read(&blockBytes[0], entry.length)) return false;
+    return decodeBlock(entry, reinterpret_cast<const unsigned char*>(blockBytes.data()), rows);
+}
+
+std::unique_ptr<LoanTransaction> TransactionArchive::findById(int transactionId) {
+    auto covers = [transactionId](const BlockEntry& entry) {
+        return entry.minId <= transactionId && transactionId <= entry.maxId;
+    };
+    size_t first = 0;
+    size_t last = index.size();
+    if (idsAscending) {
+        // Blocks hold consecutive id ranges, so at most one can contain the id
+        first = std::lower_bound(index.begin(), index.end(), transactionId,
+            [](const BlockEntry& entry, int id) { return entry.maxId < id; }) - index.begin();
+        last = std::min(last, first + 1);
+    }
+    Rows rows;
+    for (size_t block = first; block < last; ++block) {
+        if (!covers(index[block])) continue;
+        rows.clear();
+        if (!readBlock(block, rows)) continue;
+        for (auto& row : rows) {
+            if (row->transactionId == transactionId) return std::move(row);
+        }
+    }
+    return nullptr;
+}
+
+TransactionArchive::Rows TransactionArchive::borrowedBetween(const std::string& from, const std::string& to) {
+    Rows result;
+    const int fromDay = dayNumber(from);
+    const int toDay = dayNumber(to);
+    if (fromDay == kInvalidDay || toDay == kInvalidDay) return result;
+    Rows rows;
+    for (size_t block = 0; block < index.size(); ++block) {
+        const BlockEntry& entry = index[block];
+        if (entry.maxBorrowDay < fromDay || entry.minBorrowDay > toDay) continue;
+        rows.clear();
+        if (!readBlock(block, rows)) continue;
+        for (auto& row : rows) {
+            const int day = dayNumber(row->borrowDate);
+            if (day != kInvalidDay && fromDay <= day && day <= toDay) result.push_back(std::move(row));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,71 @@
+#ifndef TRANSACTION_ARCHIVE_H
+#define TRANSACTION_ARCHIVE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../../Core Classes/LoanManager.h"
+
+// Compact file format for loan transactions, an alternative to the CSV.
+// Rows are stored in their original order in blocks of up to rowsPerBlock.
+// Each block is laid out column by column, and every column is delta/varint
+// encoded: ids as deltas from the previous row, borrow dates as day deltas,
+// due and return dates as days after the borrow date, fines as multiples of
+// the block's largest common cent amount. Dates that do not round-trip
+// through a day number are stored verbatim, so any file converts back
+// exactly.
+//
+// Each block has a CRC-32C, so blocks are checked and decoded independently
+// (and in parallel). The index at the end records, for every block, where
+// it is, its checksum, and its id and borrow-date ranges. Lookups by
+// transaction id or by borrow date therefore decode only the blocks that
+// can match.
+class TransactionArchive {
+public:
+    static constexpr uint32_t rowsPerBlock = 4096;
+
+    using Rows = std::vector<std::unique_ptr<LoanTransaction>>;
+
+    static bool write(const std::string& filename, const Rows& transactions);
+
+    // Reads the header and block index; error says what was wrong
+    bool open(const std::string& filename, std::string* error = nullptr);
+    size_t size() const { return rowCount; }
+    size_t blockCount() const { return index.size(); }
+
+    // Every row in file order. A damaged block fails the whole read.
+    bool readAll(Rows& rows, std::string* error = nullptr);
+    // nullptr if no row has the id (or its block is damaged)
+    std::unique_ptr<LoanTransaction> findById(int transactionId);
+    // Rows borrowed on days from..to inclusive ("YYYY-MM-DD"), in file order.
+    // Damaged blocks are skipped.
+    Rows borrowedBetween(const std::string& from, const std::string& to);
+
+private:
+    struct BlockEntry {
+        uint64_t offset;
+        uint32_t length;
+        uint32_t rows;
+        uint32_t crc;
+        int32_t minId;
+        int32_t maxId;
+        int32_t minBorrowDay;   // INT_MIN..INT_MAX if some borrow date is not a plain date
+        int32_t maxBorrowDay;
+        uint32_t reserved;
+    };
+
+    std::ifstream file;
+    std::vector<BlockEntry> index;
+    size_t rowCount = 0;
+    bool idsAscending = false;
+    std::string blockBytes;     // scratch for readBlock
+
+    // Checks the block's checksum and appends its rows
+    static bool decodeBlock(const BlockEntry& entry, const unsigned char* payload, Rows& rows);
+    // Reads one block from the file and decodes it
+    bool readBlock(size_t block, Rows& rows);
+};
+
+#endif // TRANSACTION_ARCHIVE_H
@@ -0,0 +1,69 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// LEB128 varints, with zigzag mapping for signed values, as used by the
+// binary history formats (TransactionArchive, ColdLoanSegment)
+
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Reads from [begin, end); running past the end (or a varint longer than
+// ten bytes) sets the failed flag and returns zeros from then on
+class VarintReader {
+public:
+    VarintReader() = default;
+    VarintReader(const unsigned char* begin, const unsigned char* end) : pos(begin), end(end) {}
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+            const unsigned char byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed = true;
+        pos = end;
+        return 0;
+    }
+
+    int64_t signedVarint() { return unzigzag(varint()); }
+
+    // The next count bytes, or nullptr if there are fewer left
+    const unsigned char* bytes(size_t count) {
+        if (static_cast<size_t>(end - pos) < count) {
+            failed = true;
+            pos = end;
+            return nullptr;
+        }
+        const unsigned char* start = pos;
+        pos += count;
+        return start;
+    }
+
+    bool ok() const { return !failed; }
+    bool atEnd() const { return pos == end; }
+
+private:
+    const unsigned char* pos = nullptr;
+    const unsigned char* end = nullptr;
+    bool failed = false;
+};
+
+#endif // VARINT_H
@@ -0,0 +1,62 @@
+#include "BatchScript.h"
+
+namespace {
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool splitFields(const std::string& text, std::vector<std::string>& fields, std::string& error) {
+    size_t i = 0;
+    while (true) {
+        while (i < text.size() && isBlank(text[i])) ++i;
+        if (i == text.size()) return true;
+
+        std::string field;
+        if (text[i] == '"') {
+            ++i;
+            while (true) {
+                if (i == text.size()) {
+                    error = "unterminated quote";
+                    return false;
+                }
+                if (text[i] == '"') {
+                    if (i + 1 < text.size() && text[i + 1] == '"') {
+                        field += '"';
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                field += text[i++];
+            }
+            if (i < text.size() && !isBlank(text[i])) {
+                error = "expected a space after a quoted argument";
+                return false;
+            }
+        } else {
+            while (i < text.size() && !isBlank(text[i])) field += text[i++];
+        }
+        fields.push_back(std::move(field));
+    }
+}
+}
+
+bool BatchScriptReader::next(BatchCommand& command, std::string& error) {
+    while (std::getline(in, text)) {
+        ++lineNumber;
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == std::string::npos || text[start] == '#') continue;
+
+        command.line = lineNumber;
+        command.name.clear();
+        command.args.clear();
+        error.clear();
+        if (!splitFields(text, command.args, error)) {
+            command.args.clear();
+            return true;
+        }
+        command.name = std::move(command.args.front());
+        command.args.erase(command.args.begin());
+        return true;
+    }
+    return false;
+}
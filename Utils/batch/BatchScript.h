@@ -0,0 +1,34 @@
+#ifndef BATCH_SCRIPT_H
+#define BATCH_SCRIPT_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// A batch script has one command per line: a name followed by arguments
+// separated by spaces or tabs. Arguments containing spaces are written in
+// double quotes, with "" for a literal quote. Blank lines and lines starting
+// with # are skipped.
+//   add-book textbook "Linear Algebra" "G. Strang" Mathematics 2016-01-01 584 Undergraduate Mathematics
+//   borrow user17 20001
+struct BatchCommand {
+    int line = 0;
+    std::string name;
+    std::vector<std::string> args;
+};
+
+class BatchScriptReader {
+public:
+    explicit BatchScriptReader(std::istream& in) : in(in) {}
+
+    // Returns false at the end of the script. A malformed line is returned
+    // with error set and no name.
+    bool next(BatchCommand& command, std::string& error);
+
+private:
+    std::istream& in;
+    std::string text;
+    int lineNumber = 0;
+};
+
+#endif // BATCH_SCRIPT_H
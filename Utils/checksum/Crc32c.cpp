@@ -0,0 +1,99 @@
+#include "Crc32c.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+// tables[k][b]: the CRC of byte b followed by k zero bytes
+struct Tables {
+    uint32_t entries[8][256];
+
+    Tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+            entries[0][i] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                const uint32_t previous = entries[k - 1][i];
+                entries[k][i] = (previous >> 8) ^ entries[0][previous & 0xff];
+            }
+        }
+    }
+};
+
+// crc is the running (inverted) register in both implementations
+uint32_t softwareCrc(const unsigned char* bytes, size_t size, uint32_t crc) {
+    static const Tables tables;
+    const auto& t = tables.entries;
+    while (size >= 8) {
+        const uint32_t low = crc ^ (bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+              t[3][bytes[4]] ^ t[2][bytes[5]] ^ t[1][bytes[6]] ^ t[0][bytes[7]];
+        bytes += 8;
+        size -= 8;
+    }
+    while (size--) crc = t[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_X86
+#ifdef __GNUC__
+__attribute__((target("sse4.2")))
+#endif
+uint32_t hardwareCrc(const unsigned char* bytes, size_t size, uint32_t crc) {
+    uint64_t wide = crc;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+    }
+    crc = static_cast<uint32_t>(wide);
+    while (size--) crc = _mm_crc32_u8(crc, *bytes++);
+    return crc;
+}
+
+bool cpuHasSse42() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif
+
+using CrcFunction = uint32_t (*)(const unsigned char*, size_t, uint32_t);
+
+CrcFunction pickCrc() {
+#ifdef CRC32C_X86
+    if (cpuHasSse42()) return hardwareCrc;
+#endif
+    return softwareCrc;
+}
+
+// Chosen on first use, so checksums taken during static initialisation work too
+CrcFunction crcFunction() {
+    static const CrcFunction chosen = pickCrc();
+    return chosen;
+}
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    return ~crcFunction()(static_cast<const unsigned char*>(data), size, ~crc);
+}
+
+bool crc32cIsHardwareAccelerated() {
+#ifdef CRC32C_X86
+    return crcFunction() == hardwareCrc;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,15 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli). Pass the previous result as crc to continue a
+// checksum over data that arrives in pieces. Uses the SSE4.2 CRC32
+// instruction where the CPU has it, and slice-by-8 tables otherwise.
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+// Whether crc32c runs on the CPU's CRC instruction
+bool crc32cIsHardwareAccelerated();
+
+#endif // CRC32C_H
@@ -0,0 +1,205 @@
+#include "ThreadPool.h"
+
+namespace {
+    // Identifies the pool/queue of the current worker thread so that nested
+    // submissions go to the local deque instead of a random one.
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local size_t currentQueue = 0;
+
+    std::unique_ptr<ThreadPool>& globalPool() {
+        static std::unique_ptr<ThreadPool> pool = std::make_unique<ThreadPool>();
+        return pool;
+    }
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : sleepingHelpers(0), pendingTasks(0), nextQueue(0), stopping(false) {
+    if (threadCount == 0) threadCount = 1;
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    return *globalPool();
+}
+
+void ThreadPool::resizeGlobal(size_t threadCount) {
+    std::unique_ptr<ThreadPool>& pool = globalPool();
+    pool.reset();   // joins the old workers first
+    pool = std::make_unique<ThreadPool>(threadCount);
+}
+
+void ThreadPool::submit(Task task) {
+    size_t index = (currentPool == this)
+        ? currentQueue
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        // Count before publishing so that a thief can never decrement first.
+        // Taking the sleep lock orders the increment with a worker that is
+        // about to wait, so the notification cannot be lost.
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pendingTasks.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    sleepCondition.notify_one();
+    if (sleepingHelpers.load(std::memory_order_acquire) > 0) {
+        helperCondition.notify_all();
+    }
+}
+
+bool ThreadPool::popTask(size_t preferred, Task& task) {
+    // Own queue first (newest task), then steal the oldest task of the others
+    {
+        WorkQueue& own = *queues[preferred];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        WorkQueue& victim = *queues[(preferred + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    if (pendingTasks.load(std::memory_order_acquire) == 0) return false;
+
+    size_t preferred = (currentPool == this) ? currentQueue : 0;
+    Task task;
+    if (!popTask(preferred, task)) return false;
+    pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::helpUntil(const std::function<bool()>& done) {
+    while (!done()) {
+        if (runPendingTask()) continue;
+
+        // Nothing to run: sleep until the caller is done or more work arrives.
+        // Both are published under the sleep lock (see submit and
+        // notifyHelpers), so neither wakeup can be missed.
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingHelpers.fetch_add(1, std::memory_order_relaxed);
+        helperCondition.wait(lock, [this, &done] {
+            return done() || pendingTasks.load(std::memory_order_acquire) > 0;
+        });
+        sleepingHelpers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void ThreadPool::notifyHelpers() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        if (sleepingHelpers.load(std::memory_order_relaxed) == 0) return;
+    }
+    helperCondition.notify_all();
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+
+    while (true) {
+        Task task;
+        if (popTask(index, task)) {
+            pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this] {
+            return stopping || pendingTasks.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping && pendingTasks.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+// TaskGroup implementation
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), outstanding(0) {}
+
+TaskGroup::~TaskGroup() {
+    // Never leave tasks running that reference this group
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::run(ThreadPool::Task task) {
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+    pool.submit([this, owner = &pool, task = std::move(task)] {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!firstError) firstError = std::current_exception();
+        }
+        // The group may be gone as soon as the count reaches zero; the pool is not
+        if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            owner->notifyHelpers();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    pool.helpUntil([this] { return outstanding.load(std::memory_order_acquire) == 0; });
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        std::swap(error, firstError);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void parallelFor(size_t begin, size_t end, size_t grain,
+                 const std::function<void(size_t, size_t)>& body,
+                 ThreadPool& pool) {
+    if (end <= begin) return;
+    const size_t count = end - begin;
+    if (grain == 0) {
+        grain = count / (pool.size() * 4) + 1;
+    }
+    if (count <= grain) {
+        body(begin, end);
+        return;
+    }
+
+    TaskGroup group(pool);
+    for (size_t lo = begin; lo < end; lo += grain) {
+        size_t hi = std::min(end, lo + grain);
+        group.run([&body, lo, hi] { body(lo, hi); });
+    }
+    group.wait();
+}
@@ -0,0 +1,129 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pushes and pops its own work at the back
+// (LIFO, cache friendly) and steals from the front of other workers' deques
+// when it runs dry. Tasks submitted from outside the pool are spread
+// round-robin over the workers.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Shared pool used by the library (reports, scans, CSV loading, ...)
+    static ThreadPool& global();
+    // Replaces the shared pool with one of threadCount workers. Only call it
+    // while no task is queued or running (the benchmark's thread sweep does).
+    static void resizeGlobal(size_t threadCount);
+
+    void submit(Task task);
+    size_t size() const { return workers.size(); }
+
+    // Runs one queued task on the calling thread, if any.
+    bool runPendingTask();
+
+    // Runs queued tasks on the calling thread until done() returns true, and
+    // sleeps while there is nothing to run. Used by TaskGroup::wait() so that
+    // waiting threads help instead of blocking, without spinning when idle.
+    void helpUntil(const std::function<bool()>& done);
+    // Wakes the threads sleeping in helpUntil so they check done() again
+    void notifyHelpers();
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::condition_variable helperCondition;    // threads in helpUntil
+    std::atomic<size_t> sleepingHelpers;        // changed under sleepMutex
+    std::atomic<size_t> pendingTasks;
+    std::atomic<size_t> nextQueue;
+    std::atomic<bool> stopping;
+
+    void workerLoop(size_t index);
+    bool popTask(size_t preferred, Task& task);
+};
+
+// A set of tasks that can be waited on together.
+// The first exception thrown by a task is rethrown from wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::global());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(ThreadPool::Task task);
+    void wait();
+
+private:
+    ThreadPool& pool;
+    std::atomic<size_t> outstanding;
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+};
+
+// Calls body(lo, hi) on consecutive sub-ranges of [begin, end) in parallel.
+// grain is the smallest range handed to a single task (0 = choose automatically).
+void parallelFor(size_t begin, size_t end, size_t grain,
+                 const std::function<void(size_t, size_t)>& body,
+                 ThreadPool& pool = ThreadPool::global());
+
+// Maps every sub-range of [begin, end) to a partial result and combines the
+// partial results in range order, so non-commutative combines are fine.
+// T must be default constructible; it may be move-only.
+template <typename T, typename MapFn, typename CombineFn>
+T parallelReduce(size_t begin, size_t end, size_t grain, T identity,
+                 MapFn map, CombineFn combine,
+                 ThreadPool& pool = ThreadPool::global()) {
+    if (end <= begin) return identity;
+    const size_t count = end - begin;
+    if (grain == 0) {
+        grain = count / (pool.size() * 4) + 1;
+    }
+    const size_t chunks = (count + grain - 1) / grain;
+    if (chunks <= 1) {
+        return combine(std::move(identity), map(begin, end));
+    }
+
+    std::vector<T> partials(chunks); // every slot is overwritten by map()
+    parallelFor(0, chunks, 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; ++c) {
+            size_t first = begin + c * grain;
+            size_t last = std::min(end, first + grain);
+            partials[c] = map(first, last);
+        }
+    }, pool);
+
+    T result = std::move(identity);
+    for (auto& partial : partials) {
+        result = combine(std::move(result), std::move(partial));
+    }
+    return result;
+}
+
+#endif // THREAD_POOL_H
@@ -1,59 +1,139 @@
 #include "CSVStorageManager.h"
 #include <fstream>
+#include <iostream>
 #include <sstream>
+#include <iterator>
+#include <string_view>
+#include "../concurrency/ThreadPool.h"
+#include "../storage/AtomicFile.h"
+#include "../metrics/LatencyHistogram.h"
+#include "../metrics/Tracer.h"
+#include "../metrics/MemoryTracker.h"
+
+namespace {
+    // Lines handed to one parsing task
+    const size_t kLinesPerTask = 8192;
+
+    // Saved files end with a checksum line (AtomicFileWriter::commitWithChecksum).
+    // A mismatch means the file was damaged or edited after it was saved; its
+    // rows are still loaded as far as they parse, with a warning.
+    void verifyChecksum(const std::string& filename, std::string& content) {
+        if (!checkChecksumLine(content)) {
+            std::cerr << "Warning: " << filename << " does not match its checksum; it was damaged or edited "
+                      << "after it was saved, and rows that do not parse will be skipped\n";
+        }
+    }
+
+    // Reads the whole file into memory and returns views of its data lines (header skipped)
+    bool readDataLines(const std::string& filename, std::string& content, std::vector<std::string_view>& lines) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        verifyChecksum(filename, content);
+
+        size_t pos = content.find('\n');
+        if (pos == std::string::npos) return true; // header only
+        ++pos;
+        while (pos < content.size()) {
+            size_t end = content.find('\n', pos);
+            if (end == std::string::npos) end = content.size();
+            lines.emplace_back(content.data() + pos, end - pos);
+            pos = end + 1;
+        }
+        return true;
+    }
+
+    // Same result as repeated std::getline(ss, item, ','): a trailing empty field is dropped
+    void splitFields(std::string_view line, std::vector<std::string>& fields) {
+        fields.clear();
+        size_t pos = 0;
+        while (pos < line.size()) {
+            size_t comma = line.find(',', pos);
+            if (comma == std::string_view::npos) {
+                fields.emplace_back(line.substr(pos));
+                return;
+            }
+            fields.emplace_back(line.substr(pos, comma - pos));
+            pos = comma + 1;
+        }
+    }
+
+    // Parses the lines of a CSV file in parallel; rows keep their file order.
+    // parseRow(fields, out) appends zero or one record to out. The records'
+    // memory is attributed to subsystem on every worker thread.
+    template <typename T, typename ParseRow>
+    std::vector<T> parseRows(const std::vector<std::string_view>& lines, MemorySubsystem subsystem, ParseRow parseRow) {
+        return parallelReduce(size_t(0), lines.size(), kLinesPerTask, std::vector<T>{},
+            [&lines, &parseRow, subsystem](size_t lo, size_t hi) {
+                ScopedMemoryTag tag(subsystem);
+                std::vector<T> rows;
+                rows.reserve(hi - lo);
+                std::vector<std::string> fields;
+                for (size_t i = lo; i < hi; ++i) {
+                    splitFields(lines[i], fields);
+                    parseRow(fields, rows);
+                }
+                return rows;
+            },
+            [](std::vector<T> a, std::vector<T> b) {
+                if (a.empty()) return b;
+                a.insert(a.end(), std::make_move_iterator(b.begin()), std::make_move_iterator(b.end()));
+                return a;
+            });
+    }
+}
+
 bool CSVStorageManager::saveReservations(const std::vector<Reservation>& reservations, const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) return false;
+    ScopedTraceSpan span("CSVStorageManager::saveReservations");
+    ScopedLatencyTimer timer(MetricOperation::SaveReservations);
+    AtomicFileWriter writer(filename);
+    if (!writer.isOpen()) return false;
+    std::ostream& file = writer.stream();
 
     // Header
-    file << "UserId,BookId,ReservationDate,ExpiryDate\n";
+    file << reservationsHeader << "\n";
     for (const auto& r : reservations) {
         file << r.userId << ","
              << r.bookId << ","
              << r.reservationDate << ","
              << r.expiryDate << "\n";
     }
-    file.close();
-    return true;
+    return writer.commitWithChecksum();
 }
 
 std::vector<Reservation> CSVStorageManager::loadReservations(const std::string& filename) {
-    std::vector<Reservation> reservations;
-    std::ifstream file(filename);
-    if (!file.is_open()) return reservations;
-
-    std::string line;
-    std::getline(file, line); // header
-
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string item;
-        std::vector<std::string> fields;
-        while (std::getline(ss, item, ',')) {
-            fields.push_back(item);
-        }
-        if (fields.size() < 4) continue;
+    ScopedTraceSpan span("CSVStorageManager::loadReservations");
+    ScopedLatencyTimer timer(MetricOperation::LoadReservations);
+    ScopedMemoryTag tag(MemorySubsystem::Reservations);
+    std::string content;
+    std::vector<std::string_view> lines;
+    if (!readDataLines(filename, content, lines)) return {};
+
+    return parseRows<Reservation>(lines, MemorySubsystem::Reservations, [](const std::vector<std::string>& fields, std::vector<Reservation>& out) {
+        // A waiting reservation has no expiry yet, so its last column is empty
+        if (fields.size() < 3) return;
 
         int userId = std::stoi(fields[0]);
         int bookId = std::stoi(fields[1]);
-        std::string reservationDate = fields[2];
-        std::string expiryDate = fields[3];
+        const std::string& reservationDate = fields[2];
+        std::string expiryDate = fields.size() > 3 ? fields[3] : "";
 
-        reservations.emplace_back(userId, bookId, reservationDate, expiryDate);
-    }
-    file.close();
-    return reservations;
+        out.emplace_back(userId, bookId, reservationDate, expiryDate);
+    });
 }
 #include "CSVStorageManager.h"
 #include "../../Core Classes/LoanManager.h"
 #include <fstream>
 #include <sstream>
 bool CSVStorageManager::saveLoanTransactions(const std::vector<std::unique_ptr<LoanTransaction>>& transactions, const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) return false;
+    ScopedTraceSpan span("CSVStorageManager::saveLoanTransactions");
+    ScopedLatencyTimer timer(MetricOperation::SaveTransactions);
+    AtomicFileWriter writer(filename);
+    if (!writer.isOpen()) return false;
+    std::ostream& file = writer.stream();
 
     // Header
-    file << "TransactionId,UserId,BookId,BorrowDate,DueDate,ReturnDate,Fine,IsReturned\n";
+    file << transactionsHeader << "\n";
     for (const auto& t : transactions) {
         file << t->transactionId << ","
              << t->userId << ","
@@ -64,26 +144,20 @@ bool CSVStorageManager::saveLoanTransactions(const std::vector<std::unique_ptr<L
              << t->fine << ","
              << (t->isReturned ? "1" : "0") << "\n";
     }
-    file.close();
-    return true;
+    return writer.commitWithChecksum();
 }
 
 std::vector<std::unique_ptr<LoanTransaction>> CSVStorageManager::loadLoanTransactions(const std::string& filename) {
-    std::vector<std::unique_ptr<LoanTransaction>> transactions;
-    std::ifstream file(filename);
-    if (!file.is_open()) return transactions;
-
-    std::string line;
-    std::getline(file, line); // header
-
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string item;
-        std::vector<std::string> fields;
-        while (std::getline(ss, item, ',')) {
-            fields.push_back(item);
-        }
-        if (fields.size() < 8) continue;
+    ScopedTraceSpan span("CSVStorageManager::loadLoanTransactions");
+    ScopedLatencyTimer timer(MetricOperation::LoadTransactions);
+    ScopedMemoryTag tag(MemorySubsystem::Transactions);
+    std::string content;
+    std::vector<std::string_view> lines;
+    if (!readDataLines(filename, content, lines)) return {};
+
+    using Row = std::unique_ptr<LoanTransaction>;
+    return parseRows<Row>(lines, MemorySubsystem::Transactions, [](const std::vector<std::string>& fields, std::vector<Row>& out) {
+        if (fields.size() < 8) return;
 
         int transactionId = std::stoi(fields[0]);
         int userId = std::stoi(fields[1]);
@@ -98,10 +172,8 @@ std::vector<std::unique_ptr<LoanTransaction>> CSVStorageManager::loadLoanTransac
         transaction->returnDate = returnDate;
         transaction->fine = fine;
         transaction->isReturned = isReturned;
-        transactions.push_back(std::move(transaction));
-    }
-    file.close();
-    return transactions;
+        out.push_back(std::move(transaction));
+    });
 }
 #include "CSVStorageManager.h"
 #include <fstream>
@@ -109,11 +181,14 @@ std::vector<std::unique_ptr<LoanTransaction>> CSVStorageManager::loadLoanTransac
 #include <filesystem>
 #include "../../Core Classes/Book.h"
 bool CSVStorageManager::saveBooks(const std::vector<std::unique_ptr<Book>>& books, const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) return false;
+    ScopedTraceSpan span("CSVStorageManager::saveBooks");
+    ScopedLatencyTimer timer(MetricOperation::SaveBooks);
+    AtomicFileWriter writer(filename);
+    if (!writer.isOpen()) return false;
+    std::ostream& file = writer.stream();
 
     // Header
-    file << "Id,Title,Author,Category,PublicationDate,PageCount,Status,Type,AcademicLevel,Field,IssueNumber\n";
+    file << booksHeader << "\n";
     for (const auto& book : books) {
         file << book->getId() << ","
              << book->getTitle() << ","
@@ -136,26 +211,20 @@ bool CSVStorageManager::saveBooks(const std::vector<std::unique_ptr<Book>>& book
             file << "" << "," << "" << "," << "" << "\n";
         }
     }
-    file.close();
-    return true;
+    return writer.commitWithChecksum();
 }
 
 std::vector<std::unique_ptr<Book>> CSVStorageManager::loadBooks(const std::string& filename) {
-    std::vector<std::unique_ptr<Book>> books;
-    std::ifstream file(filename);
-    if (!file.is_open()) return books;
-
-    std::string line;
-    std::getline(file, line); // header
-
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string item;
-        std::vector<std::string> fields;
-        while (std::getline(ss, item, ',')) {
-            fields.push_back(item);
-        }
-        if (fields.size() < 8) continue;
+    ScopedTraceSpan span("CSVStorageManager::loadBooks");
+    ScopedLatencyTimer timer(MetricOperation::LoadBooks);
+    ScopedMemoryTag tag(MemorySubsystem::Catalog);
+    std::string content;
+    std::vector<std::string_view> lines;
+    if (!readDataLines(filename, content, lines)) return {};
+
+    using Row = std::unique_ptr<Book>;
+    return parseRows<Row>(lines, MemorySubsystem::Catalog, [](const std::vector<std::string>& fields, std::vector<Row>& books) {
+        if (fields.size() < 8) return;
 
         int id = std::stoi(fields[0]);
         std::string title = fields[1];
@@ -177,19 +246,20 @@ std::vector<std::unique_ptr<Book>> CSVStorageManager::loadBooks(const std::strin
             books.push_back(std::make_unique<ReferenceBook>(id, title, author, category, publicationDate, pageCount));
         } else {
             // اگر نوع ناشناخته بود، کتاب را نادیده بگیر
-            continue;
+            return;
         }
-    }
-    file.close();
-    return books;
+    });
 }
 
 bool CSVStorageManager::saveUsers(const std::vector<std::unique_ptr<User>>& users, const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) return false;
+    ScopedTraceSpan span("CSVStorageManager::saveUsers");
+    ScopedLatencyTimer timer(MetricOperation::SaveUsers);
+    AtomicFileWriter writer(filename);
+    if (!writer.isOpen()) return false;
+    std::ostream& file = writer.stream();
 
     // Header
-    file << "UserId,Username,Password,Type,Status,TotalFines,BorrowLimit,LoanPeriod,CanManageUsers,CanManageBooks,CanHandleFines,CanViewLogs\n";
+    file << usersHeader << "\n";
     for (const auto& user : users) {
         file << user->getUserId() << ","
              << user->getUsername() << ","
@@ -204,27 +274,20 @@ bool CSVStorageManager::saveUsers(const std::vector<std::unique_ptr<User>>& user
              << (user->canHandleFines() ? "true" : "false") << ","
              << (user->canViewLogs() ? "true" : "false") << "\n";
     }
-    file.close();
-    return true;
+    return writer.commitWithChecksum();
 }
 
 std::vector<std::unique_ptr<User>> CSVStorageManager::loadUsers(const std::string& filename) {
-    std::vector<std::unique_ptr<User>> users;
-    std::ifstream file(filename);
-    if (!file.is_open()) return users;
-
-    std::string line;
-    // خواندن هدر
-    std::getline(file, line);
-
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string item;
-        std::vector<std::string> fields;
-        while (std::getline(ss, item, ',')) {
-            fields.push_back(item);
-        }
-        if (fields.size() < 13 && fields.size() < 12) continue; // تعداد ستون‌ها
+    ScopedTraceSpan span("CSVStorageManager::loadUsers");
+    ScopedLatencyTimer timer(MetricOperation::LoadUsers);
+    ScopedMemoryTag tag(MemorySubsystem::Users);
+    std::string content;
+    std::vector<std::string_view> lines;
+    if (!readDataLines(filename, content, lines)) return {};
+
+    using Row = std::unique_ptr<User>;
+    return parseRows<Row>(lines, MemorySubsystem::Users, [](const std::vector<std::string>& fields, std::vector<Row>& users) {
+        if (fields.size() < 13 && fields.size() < 12) return; // تعداد ستون‌ها
 
         int userId = std::stoi(fields[0]);
         std::string username = fields[1];
@@ -232,23 +295,18 @@ std::vector<std::unique_ptr<User>> CSVStorageManager::loadUsers(const std::strin
         std::string type = fields[3];
         // سایر فیلدها در صورت نیاز قابل استفاده‌اند
 
-        if (type == "RegularUser") {
-            users.push_back(std::make_unique<RegularUser>(userId, username, password));
-        } else if (type == "Librarian") {
-            users.push_back(std::make_unique<Librarian>(userId, username, password));
+        UserRole role;
+        if (roleFromTypeName(type, role)) {
+            users.push_back(std::make_unique<User>(userId, username, password, role));
         }
-        // اگر نوع دیگری اضافه شد، اینجا هندل شود
-    }
-    file.close();
-    return users;
+    });
 }
 
-void CSVStorageManager::checkOrCreateCSVFile(const std::string& filename) {
+void CSVStorageManager::checkOrCreateCSVFile(const std::string& filename, const char* header) {
+    ScopedTraceSpan span("CSVStorageManager::checkOrCreateCSVFile");
     if (!std::filesystem::exists(filename)) {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << "UserId,Username,Password,Type,Status,TotalFines,BorrowLimit,LoanPeriod,CanManageUsers,CanManageBooks,CanHandleFines,CanViewLogs\n";
-            file.close();
-        }
+        AtomicFileWriter writer(filename);
+        writer.stream() << header << "\n";
+        writer.commitWithChecksum();
     }
 }
@@ -7,6 +7,16 @@
 
 class CSVStorageManager {
 public:
+    // سرستون فایل‌ها (the header line of each file)
+    static constexpr const char* usersHeader =
+        "UserId,Username,Password,Type,Status,TotalFines,BorrowLimit,LoanPeriod,CanManageUsers,CanManageBooks,CanHandleFines,CanViewLogs";
+    static constexpr const char* booksHeader =
+        "Id,Title,Author,Category,PublicationDate,PageCount,Status,Type,AcademicLevel,Field,IssueNumber";
+    static constexpr const char* transactionsHeader =
+        "TransactionId,UserId,BookId,BorrowDate,DueDate,ReturnDate,Fine,IsReturned";
+    static constexpr const char* reservationsHeader =
+        "UserId,BookId,ReservationDate,ExpiryDate";
+
     // ذخیره کاربران در فایل CSV
     static bool saveUsers(const std::vector<std::unique_ptr<User>>& users, const std::string& filename);
 
@@ -14,7 +24,7 @@ public:
     static std::vector<std::unique_ptr<User>> loadUsers(const std::string& filename);
 
     // بررسی وجود فایل و ساخت آن در صورت عدم وجود
-    static void checkOrCreateCSVFile(const std::string& filename);
+    static void checkOrCreateCSVFile(const std::string& filename, const char* header);
 
     // ذخیره کتاب‌ها در فایل CSV
     static bool saveBooks(const std::vector<std::unique_ptr<Book>>& books, const std::string& filename);
@@ -1,15 +1,25 @@
 #include "ConfigManager.h"
-#include "iniReader\\INIReader.h"
+#include "iniReader/INIReader.h"
 #include "GlobalConfiguration.h"
+#include "../metrics/MemoryTracker.h"
+#include "../storage/AtomicFile.h"
+#include <cstdio>
 #include <stdexcept>
 #include <fstream>
+#include <iostream>
 
 // Static member definitions
 std::unique_ptr<INIReader> ConfigManager::reader = nullptr;
 std::string ConfigManager::configFile = "Config.ini";
+std::mutex ConfigManager::mutex;
+bool ConfigManager::saved = false;
+std::filesystem::file_time_type ConfigManager::savedWriteTime;
+std::uintmax_t ConfigManager::savedSize = 0;
 
 bool ConfigManager::loadConfig(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex);
     configFile = filename;
+    ScopedMemoryTag tag(MemorySubsystem::Config);
     reader = std::make_unique<INIReader>(configFile);
     return reader->ParseError() == 0;
 }
@@ -26,52 +36,121 @@ double ConfigManager::getReal(const std::string& section, const std::string& key
     return reader->GetReal(section, key, defaultValue);
 }
 
-void ConfigManager::getBorrowLimit() {
-    librarian_borrow_limit = static_cast<int>(getInt("UserLimits", "librarian_borrow_limit", 100));
-    regular_user_borrow_limit = static_cast<int>(getInt("UserLimits", "regular_user_borrow_limit", 5));
+std::string ConfigManager::getConfigFile() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return configFile;
 }
 
-void ConfigManager::getLoanPeriod() {
-    librarian_loan_period = static_cast<int>(getInt("LoanPeriods", "librarian_loan_period", 60));
-    regular_user_loan_period = static_cast<int>(getInt("LoanPeriods", "regular_user_loan_period", 14));
+bool ConfigManager::unchangedSinceSave() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!saved) return false;
+    std::error_code error;
+    const auto writeTime = std::filesystem::last_write_time(configFile, error);
+    if (error || writeTime != savedWriteTime) return false;
+    const std::uintmax_t size = std::filesystem::file_size(configFile, error);
+    return !error && size == savedSize;
 }
 
-void ConfigManager::getReservationPeriod() {
-    reservation_period = static_cast<int>(getInt("LoanPeriods", "reservation_period", 7));
-}
+ConfigSnapshot ConfigManager::readSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ConfigSnapshot defaults;
+    ConfigSnapshot snapshot;
 
-void ConfigManager::getDailyFineRate() {
-    daily_fine_rate = getReal("Fines", "daily_fine_rate", 1.0);
-}
+    snapshot.librarian_borrow_limit = static_cast<int>(getInt("UserLimits", "librarian_borrow_limit", defaults.librarian_borrow_limit));
+    snapshot.regular_user_borrow_limit = static_cast<int>(getInt("UserLimits", "regular_user_borrow_limit", defaults.regular_user_borrow_limit));
+
+    snapshot.librarian_loan_period = static_cast<int>(getInt("LoanPeriods", "librarian_loan_period", defaults.librarian_loan_period));
+    snapshot.regular_user_loan_period = static_cast<int>(getInt("LoanPeriods", "regular_user_loan_period", defaults.regular_user_loan_period));
+    snapshot.reservation_period = static_cast<int>(getInt("LoanPeriods", "reservation_period", defaults.reservation_period));
+
+    snapshot.daily_fine_rate = getReal("Fines", "daily_fine_rate", defaults.daily_fine_rate);
+    snapshot.max_fine = getReal("Fines", "max_fine", defaults.max_fine);
+    if (isLoaded()) {
+        for (const std::string& key : reader->Keys("FineRules")) {
+            snapshot.fine_rules.push_back({key, reader->Get("FineRules", key, "")});
+        }
+    }
+    std::string errors;
+    snapshot.fine_policy = FinePolicy::compile(snapshot.daily_fine_rate, snapshot.fine_rules, &errors);
+    if (!errors.empty()) std::cerr << errors;
+
+    snapshot.page_size = static_cast<int>(getInt("Display", "page_size", defaults.page_size));
+
+    snapshot.cold_loan_age_days = static_cast<int>(getInt("Storage", "cold_loan_age_days", defaults.cold_loan_age_days));
+    snapshot.history_cache_pages = static_cast<int>(getInt("Storage", "history_cache_pages", defaults.history_cache_pages));
+    if (isLoaded()) {
+        snapshot.transactions_format = reader->Get("Storage", "transactions_format", defaults.transactions_format);
+    }
 
-void ConfigManager::getMaxFine() {
-    max_fine = getReal("Fines", "max_fine", 50.0);
+    snapshot.latency_metrics_enabled = getInt("Diagnostics", "latency_metrics", defaults.latency_metrics_enabled) != 0;
+    snapshot.tracing_enabled = getInt("Diagnostics", "tracing", defaults.tracing_enabled) != 0;
+    snapshot.check_statistics = getInt("Diagnostics", "check_statistics", defaults.check_statistics) != 0;
+    return snapshot;
 }
 
-bool ConfigManager::saveConfig() {
-    std::ofstream configStream("Config.ini");
+bool ConfigManager::saveConfig(const ConfigSnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Write a temporary file and rename it over the config, so the file
+    // watcher never reloads a half-written file
+    const std::string tempFile = configFile + ".tmp";
+    std::ofstream configStream(tempFile);
     if (!configStream.is_open()) {
         return false;
     }
 
     // Write User Limits section
     configStream << "[UserLimits]\n";
-    configStream << "regular_user_borrow_limit=" << regular_user_borrow_limit << "\n";
-    configStream << "librarian_borrow_limit=" << librarian_borrow_limit << "\n\n";
+    configStream << "regular_user_borrow_limit=" << snapshot.regular_user_borrow_limit << "\n";
+    configStream << "librarian_borrow_limit=" << snapshot.librarian_borrow_limit << "\n\n";
 
     // Write Loan Periods section
     configStream << "[LoanPeriods]\n";
-    configStream << "regular_user_loan_period=" << regular_user_loan_period << "\n";
-    configStream << "librarian_loan_period=" << librarian_loan_period << "\n";
-    configStream << "reservation_period=" << reservation_period << "\n\n";
+    configStream << "regular_user_loan_period=" << snapshot.regular_user_loan_period << "\n";
+    configStream << "librarian_loan_period=" << snapshot.librarian_loan_period << "\n";
+    configStream << "reservation_period=" << snapshot.reservation_period << "\n\n";
 
     // Write Fines section
     configStream << "[Fines]\n";
-    configStream << "daily_fine_rate=" << daily_fine_rate << "\n";
-    configStream << "max_fine=" << max_fine << "\n";
+    configStream << "daily_fine_rate=" << snapshot.daily_fine_rate << "\n";
+    configStream << "max_fine=" << snapshot.max_fine << "\n\n";
+
+    // Write Fine Rules section
+    configStream << "[FineRules]\n";
+    for (const auto& rule : snapshot.fine_rules) {
+        configStream << rule.key << "=" << rule.value << "\n";
+    }
+    configStream << "\n";
+
+    // Write Display section
+    configStream << "[Display]\n";
+    configStream << "page_size=" << snapshot.page_size << "\n\n";
+
+    // Write Storage section
+    configStream << "[Storage]\n";
+    configStream << "cold_loan_age_days=" << snapshot.cold_loan_age_days << "\n";
+    configStream << "transactions_format=" << snapshot.transactions_format << "\n";
+    configStream << "history_cache_pages=" << snapshot.history_cache_pages << "\n\n";
+
+    // Write Diagnostics section
+    configStream << "[Diagnostics]\n";
+    configStream << "latency_metrics=" << (snapshot.latency_metrics_enabled ? 1 : 0) << "\n";
+    configStream << "tracing=" << (snapshot.tracing_enabled ? 1 : 0) << "\n";
+    configStream << "check_statistics=" << (snapshot.check_statistics ? 1 : 0) << "\n";
 
     configStream.close();
+    if (configStream.fail()) {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    if (!replaceFile(tempFile, configFile)) return false;
+    std::error_code error;
+    savedWriteTime = std::filesystem::last_write_time(configFile, error);
+    if (!error) savedSize = std::filesystem::file_size(configFile, error);
+    saved = !error;
 
-    // Reload the configuration to ensure consistency
-    return loadConfig(configFile);
-}
\ No newline at end of file
+    // The rate may have changed, so the table is recompiled for the published copy
+    ConfigSnapshot published = snapshot;
+    published.fine_policy = FinePolicy::compile(published.daily_fine_rate, published.fine_rules);
+    publishConfig(published);
+    return true;
+}
@@ -1,14 +1,24 @@
 // ConfigManager.h
 #pragma once
+#include <cstdint>
+#include <filesystem>
 #include <string>
 #include <memory>
-#include "iniReader\\INIReader.h"
+#include <mutex>
+#include "iniReader/INIReader.h"
+
+struct ConfigSnapshot;
 
 // Static ConfigManager class
 class ConfigManager {
 private:
     static std::unique_ptr<INIReader> reader;
     static std::string configFile;
+    static std::mutex mutex; // the file watcher reloads from its own thread
+    // The file as saveConfig last left it, so the watcher can skip that change
+    static bool saved;
+    static std::filesystem::file_time_type savedWriteTime;
+    static std::uintmax_t savedSize;
 
     ConfigManager() = delete;
     ~ConfigManager() = delete;
@@ -16,14 +26,14 @@ private:
 public:
     // All methods are static
     static bool loadConfig(const std::string& filename = "Config.ini");
-    static bool saveConfig();
+    // Writes snapshot to the loaded config file and publishes it
+    static bool saveConfig(const ConfigSnapshot& snapshot);
+    static std::string getConfigFile();
+    // Whether the file is still the one saveConfig last wrote (and published)
+    static bool unchangedSinceSave();
 
-    // Specific getters for LibrarySystem
-    static void getBorrowLimit();
-    static void getLoanPeriod();
-    static void getReservationPeriod();
-    static void getDailyFineRate();
-    static void getMaxFine();
+    // Values of the loaded file; missing keys keep their defaults
+    static ConfigSnapshot readSnapshot();
 
     // Helper methods
 private:
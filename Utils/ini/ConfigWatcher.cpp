@@ -0,0 +1,85 @@
+#include "ConfigWatcher.h"
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+bool ConfigWatcher::start(const std::string& file, std::function<void()> callback) {
+    if (isRunning()) return false;
+    filename = file;
+    onChange = std::move(callback);
+    stopping = false;
+    worker = std::thread([this] {
+#ifdef __linux__
+        if (watchWithInotify()) return;
+#endif
+        watchWithPolling();
+    });
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (!isRunning()) return;
+    stopping = true;
+    worker.join();
+}
+
+void ConfigWatcher::watchWithPolling() {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::file_time_type lastWrite = fs::last_write_time(filename, error);
+
+    while (!stopping) {
+        for (int waited = 0; waited < pollIntervalMs && !stopping; waited += 50) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        if (stopping) break;
+
+        fs::file_time_type current = fs::last_write_time(filename, error);
+        if (!error && current != lastWrite) {
+            lastWrite = current;
+            onChange();
+        }
+    }
+}
+
+#ifdef __linux__
+bool ConfigWatcher::watchWithInotify() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return false;
+
+    // Watch the directory: editors and saveConfig replace the file by renaming
+    // a new one over it, which would drop a watch on the file itself
+    std::filesystem::path path(filename);
+    std::string directory = path.has_parent_path() ? path.parent_path().string() : ".";
+    std::string name = path.filename().string();
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return false;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (!stopping) {
+        pollfd descriptor{fd, POLLIN, 0};
+        if (poll(&descriptor, 1, pollIntervalMs) <= 0) continue;
+
+        // Several events for the file in one batch trigger one reload
+        bool changed = false;
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                if (event->len > 0 && name == event->name) changed = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (changed) onChange();
+    }
+    close(fd);
+    return true;
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Watches a config file and calls onChange (on the watcher thread) after it
+// has been written or replaced. Uses inotify on Linux and polls the file's
+// modification time elsewhere, or when inotify is unavailable.
+class ConfigWatcher {
+public:
+    ConfigWatcher() = default;
+    ~ConfigWatcher() { stop(); }
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    bool start(const std::string& filename, std::function<void()> onChange);
+    void stop();
+    bool isRunning() const { return worker.joinable(); }
+
+    static const int pollIntervalMs = 500;
+
+private:
+    void watchWithPolling();
+#ifdef __linux__
+    bool watchWithInotify();
+#endif
+
+    std::string filename;
+    std::function<void()> onChange;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
@@ -1,28 +1,58 @@
 // filepath: c:\Users\Farnam\Documents\CodeBlocks\LibrarySystem\LibrarySystem\LibrarySystem\LibrarySystem\Utils\ini\GlobalConfiguration.cpp
 #include "GlobalConfiguration.h"
 #include "ConfigManager.h"
+#include "../metrics/MemoryTracker.h"
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
-int librarian_borrow_limit = 100;
-int regular_user_borrow_limit = 5;
-int librarian_loan_period = 60;
-int regular_user_loan_period = 14;
-int reservation_period = 7;
-double daily_fine_rate = 1.0;
-double max_fine = 50.0;
+namespace {
+    // Replaced snapshots are freed once the last reader lets go of them
+    std::mutex publishMutex;
+    std::shared_ptr<const ConfigSnapshot> currentSnapshot = std::make_shared<const ConfigSnapshot>();
+    std::atomic<uint64_t> generation{0};
+
+    // Each thread keeps the snapshot it last read, so a read is one atomic
+    // load and a reference count increment until the next publish
+    struct CachedSnapshot {
+        uint64_t generation = UINT64_MAX;
+        std::shared_ptr<const ConfigSnapshot> snapshot;
+    };
+    thread_local CachedSnapshot cached;
+}
+
+std::shared_ptr<const ConfigSnapshot> config() {
+    if (cached.generation != generation.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        cached.snapshot = currentSnapshot;
+        cached.generation = generation.load(std::memory_order_relaxed);
+    }
+    return cached.snapshot;
+}
+
+uint64_t configGeneration() {
+    return generation.load(std::memory_order_acquire);
+}
+
+void publishConfig(const ConfigSnapshot& snapshot) {
+    ScopedMemoryTag tag(MemorySubsystem::Config);
+    auto next = std::make_shared<const ConfigSnapshot>(snapshot);
+    std::lock_guard<std::mutex> lock(publishMutex);
+    currentSnapshot = std::move(next);
+    generation.fetch_add(1, std::memory_order_release);
+}
 
 bool loadGlobalConfigurationFromIni() {
-    try{ 
-        ConfigManager::loadConfig("Config.ini");
-        ConfigManager::getBorrowLimit();
-        ConfigManager::getLoanPeriod();
-        ConfigManager::getReservationPeriod();
-        ConfigManager::getDailyFineRate();
-        ConfigManager::getMaxFine();
+    try{
+        if (!ConfigManager::loadConfig(ConfigManager::getConfigFile())) {
+            return false;
+        }
+        publishConfig(ConfigManager::readSnapshot());
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Error loading configuration: " << e.what() << std::endl;
         return false;
     }
 
-}
\ No newline at end of file
+}
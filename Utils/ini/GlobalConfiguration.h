@@ -1,14 +1,53 @@
-//[UserLimits]
-extern int regular_user_borrow_limit;
-extern int librarian_borrow_limit;
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "../../Core Classes/FinePolicy.h"
 
-//[LoanPeriods]
-extern int regular_user_loan_period;
-extern int librarian_loan_period;
-extern int reservation_period;
+// Immutable configuration snapshot. A new one is published whenever Config.ini
+// is loaded, saved or changed on disk; published snapshots are never modified,
+// so a reader always sees one consistent set of values.
+struct ConfigSnapshot {
+    //[UserLimits]
+    int regular_user_borrow_limit = 5;
+    int librarian_borrow_limit = 100;
 
-//[Fines]
-extern double daily_fine_rate;
-extern double max_fine;
+    //[LoanPeriods]
+    int regular_user_loan_period = 14;
+    int librarian_loan_period = 60;
+    int reservation_period = 7;
 
-bool loadGlobalConfigurationFromIni();
\ No newline at end of file
+    //[Fines]
+    double daily_fine_rate = 1.0;
+    double max_fine = 50.0;
+
+    //[FineRules], compiled with daily_fine_rate into fine_policy
+    std::vector<FinePolicy::Rule> fine_rules;
+    FinePolicy fine_policy{daily_fine_rate};
+
+    //[Display]
+    int page_size = 20;             // rows per page in the interactive listings
+
+    //[Storage]
+    int cold_loan_age_days = 365;   // returned loans older than this leave memory (0 = never)
+    std::string transactions_format = "csv";  // "csv" or "archive"
+    int history_cache_pages = 256;  // 4 KiB pages of the loan history index kept in memory
+
+    //[Diagnostics]
+    bool latency_metrics_enabled = true;
+    bool tracing_enabled = false;
+    bool check_statistics = false;  // verify the report counters against a full scan
+};
+
+// Current configuration. The snapshot stays alive as long as the returned
+// pointer does, however many reloads happen meanwhile; take it once per
+// operation so all values come from the same snapshot. Reads take no lock
+// unless a new snapshot was published since this thread's last read.
+std::shared_ptr<const ConfigSnapshot> config();
+
+// Makes a copy of snapshot the current configuration
+void publishConfig(const ConfigSnapshot& snapshot);
+// Number of snapshots published so far; changes whenever config() does
+uint64_t configGeneration();
+
+bool loadGlobalConfigurationFromIni();
@@ -0,0 +1,167 @@
+#include "LatencyHistogram.h"
+#include <fstream>
+#include <iomanip>
+
+// LatencyHistogram implementation
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    const uint64_t limit = (uint64_t(1) << maxMagnitude) - 1;
+    if (value > limit) value = limit;
+    if (value < 2 * subBucketCount) return static_cast<int>(value);
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - subBucketBits;
+    uint64_t sub = value >> shift; // in [subBucketCount, 2 * subBucketCount)
+    return (shift + 1) * subBucketCount + static_cast<int>(sub - subBucketCount);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < 2 * subBucketCount) return index;
+    int shift = index / subBucketCount - 1;
+    uint64_t sub = index % subBucketCount + subBucketCount;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    counts[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t seen = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > seen &&
+           !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * n + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // Never report more than the largest recorded value
+            uint64_t bound = bucketUpperBound(i);
+            uint64_t top = maxValue();
+            return bound < top ? bound : top;
+        }
+    }
+    return maxValue();
+}
+
+// OperationMetrics implementation
+std::atomic<bool> OperationMetrics::enabled{true};
+
+namespace {
+    LatencyHistogram histograms[static_cast<int>(MetricOperation::Count)];
+
+    const char* operationNames[] = {
+        "borrowBook",
+        "returnBook",
+        "reserveBook",
+        "payFine",
+        "statistics",
+        "overdueScan",
+        "searchBooks",
+        "loadUsers",
+        "saveUsers",
+        "loadBooks",
+        "saveBooks",
+        "loadTransactions",
+        "saveTransactions",
+        "loadReservations",
+        "saveReservations",
+    };
+    static_assert(sizeof(operationNames) / sizeof(operationNames[0]) == static_cast<size_t>(MetricOperation::Count),
+                  "every MetricOperation needs a name");
+}
+
+LatencyHistogram& OperationMetrics::histogram(MetricOperation op) {
+    return histograms[static_cast<int>(op)];
+}
+
+const char* OperationMetrics::name(MetricOperation op) {
+    return operationNames[static_cast<int>(op)];
+}
+
+void OperationMetrics::writeText(std::ostream& out) {
+    auto micros = [](uint64_t ns) { return ns / 1000.0; };
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    out << std::left << std::setw(18) << "Operation" << std::right
+        << std::setw(10) << "Count"
+        << std::setw(12) << "p50 (us)"
+        << std::setw(12) << "p99 (us)"
+        << std::setw(12) << "p999 (us)"
+        << std::setw(12) << "max (us)" << "\n";
+    out << std::fixed << std::setprecision(2);
+    bool any = false;
+    for (int i = 0; i < static_cast<int>(MetricOperation::Count); ++i) {
+        const LatencyHistogram& h = histograms[i];
+        if (h.count() == 0) continue;
+        any = true;
+        out << std::left << std::setw(18) << operationNames[i] << std::right
+            << std::setw(10) << h.count()
+            << std::setw(12) << micros(h.percentile(50.0))
+            << std::setw(12) << micros(h.percentile(99.0))
+            << std::setw(12) << micros(h.percentile(99.9))
+            << std::setw(12) << micros(h.maxValue()) << "\n";
+    }
+    if (!any) {
+        out << (isEnabled() ? "No operations recorded yet.\n" : "Latency metrics are disabled.\n");
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void OperationMetrics::writeJson(std::ostream& out) {
+    out << "{\"enabled\":" << (isEnabled() ? "true" : "false") << ",\"operations\":[";
+    bool first = true;
+    for (int i = 0; i < static_cast<int>(MetricOperation::Count); ++i) {
+        const LatencyHistogram& h = histograms[i];
+        if (h.count() == 0) continue;
+        out << (first ? "" : ",")
+            << "{\"name\":\"" << operationNames[i] << "\""
+            << ",\"count\":" << h.count()
+            << ",\"mean_ns\":" << static_cast<uint64_t>(h.mean())
+            << ",\"p50_ns\":" << h.percentile(50.0)
+            << ",\"p99_ns\":" << h.percentile(99.0)
+            << ",\"p999_ns\":" << h.percentile(99.9)
+            << ",\"max_ns\":" << h.maxValue() << "}";
+        first = false;
+    }
+    out << "]}\n";
+}
+
+bool OperationMetrics::dump(const std::string& basePath) {
+    std::ofstream text(basePath + ".txt");
+    std::ofstream json(basePath + ".json");
+    if (!text.is_open() || !json.is_open()) return false;
+    writeText(text);
+    writeJson(json);
+    return true;
+}
+
+void OperationMetrics::reset() {
+    for (auto& h : histograms) h.reset();
+}
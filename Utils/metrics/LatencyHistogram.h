@@ -0,0 +1,106 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// HDR-style log-linear histogram of nanosecond latencies.
+// Every power of two is split into 32 linear sub-buckets, so a recorded value
+// is reported within ~3% of its true value. Recording is a couple of relaxed
+// atomic increments, safe from any number of threads without locks.
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 5;
+    static const int subBucketCount = 1 << subBucketBits;
+    static const int maxMagnitude = 44;  // ~4.9 hours in ns; larger values are clamped
+    static const int bucketCount = (maxMagnitude - subBucketBits + 2) * subBucketCount;
+
+    LatencyHistogram();
+
+    void record(uint64_t nanoseconds);
+    void reset();
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t maxValue() const { return maximum.load(std::memory_order_relaxed); }
+    double mean() const;
+    // Value at the given percentile (0-100), as the upper bound of its bucket
+    uint64_t percentile(double p) const;
+
+private:
+    std::atomic<uint64_t> counts[bucketCount];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maximum;
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+};
+
+// Operations that are timed
+enum class MetricOperation {
+    BorrowBook,
+    ReturnBook,
+    ReserveBook,
+    PayFine,
+    Statistics,
+    OverdueScan,
+    SearchBooks,
+    LoadUsers,
+    SaveUsers,
+    LoadBooks,
+    SaveBooks,
+    LoadTransactions,
+    SaveTransactions,
+    LoadReservations,
+    SaveReservations,
+    Count
+};
+
+// Process-wide latency registry, one histogram per operation
+class OperationMetrics {
+public:
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    static LatencyHistogram& histogram(MetricOperation op);
+    static const char* name(MetricOperation op);
+
+    static void writeText(std::ostream& out);
+    static void writeJson(std::ostream& out);
+    // Writes <basePath>.txt and <basePath>.json
+    static bool dump(const std::string& basePath);
+    static void reset();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records the lifetime of the scope into the operation's histogram.
+// When metrics are disabled the clock is never read.
+class ScopedLatencyTimer {
+public:
+    explicit ScopedLatencyTimer(MetricOperation op)
+        : op(op), active(OperationMetrics::isEnabled()) {
+        if (active) start = std::chrono::steady_clock::now();
+    }
+    ~ScopedLatencyTimer() {
+        if (active) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            OperationMetrics::histogram(op).record(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    ScopedLatencyTimer(const ScopedLatencyTimer&) = delete;
+    ScopedLatencyTimer& operator=(const ScopedLatencyTimer&) = delete;
+
+private:
+    MetricOperation op;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // LATENCY_HISTOGRAM_H
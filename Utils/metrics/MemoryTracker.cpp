@@ -0,0 +1,154 @@
+#include "MemoryTracker.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+namespace {
+    struct Counters {
+        std::atomic<uint64_t> live{0};
+        std::atomic<uint64_t> peak{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> allocatedBytes{0};
+    };
+
+    // Constant-initialised, so usable by allocations made during static initialisation
+    Counters counters[static_cast<int>(MemorySubsystem::Count)];
+    thread_local MemorySubsystem currentSubsystem = MemorySubsystem::Other;
+
+    // Prefix stored in front of every block; keeps the user pointer max-aligned
+    struct alignas(alignof(std::max_align_t)) BlockHeader {
+        uint64_t size;
+        MemorySubsystem subsystem;
+    };
+
+    const char* subsystemNames[] = {"Other", "Catalog", "Transactions", "Reservations", "Users", "Config", "Analytics"};
+    static_assert(sizeof(subsystemNames) / sizeof(subsystemNames[0]) == static_cast<size_t>(MemorySubsystem::Count),
+                  "every MemorySubsystem needs a name");
+
+    void* trackedAllocate(std::size_t size) {
+        void* raw = std::malloc(sizeof(BlockHeader) + size);
+        if (!raw) return nullptr;
+
+        BlockHeader* header = static_cast<BlockHeader*>(raw);
+        header->size = size;
+        header->subsystem = currentSubsystem;
+
+        Counters& c = counters[static_cast<int>(header->subsystem)];
+        uint64_t live = c.live.fetch_add(size, std::memory_order_relaxed) + size;
+        c.allocations.fetch_add(1, std::memory_order_relaxed);
+        c.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        uint64_t peak = c.peak.load(std::memory_order_relaxed);
+        while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+        return header + 1;
+    }
+
+    void trackedFree(void* p) noexcept {
+        if (!p) return;
+        BlockHeader* header = static_cast<BlockHeader*>(p) - 1;
+        counters[static_cast<int>(header->subsystem)].live.fetch_sub(header->size, std::memory_order_relaxed);
+        std::free(header);
+    }
+
+    // For the "since last report" rates
+    std::mutex reportMutex;
+    const auto processStart = std::chrono::steady_clock::now();
+    auto lastReport = processStart;
+    uint64_t lastAllocations[static_cast<int>(MemorySubsystem::Count)] = {};
+
+    std::string formatBytes(uint64_t bytes) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        if (bytes >= (1ULL << 30)) ss << bytes / double(1ULL << 30) << " GiB";
+        else if (bytes >= (1ULL << 20)) ss << bytes / double(1ULL << 20) << " MiB";
+        else if (bytes >= (1ULL << 10)) ss << bytes / double(1ULL << 10) << " KiB";
+        else ss << bytes << " B";
+        return ss.str();
+    }
+}
+
+void* operator new(std::size_t size) {
+    if (void* p = trackedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* p = trackedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size); }
+void operator delete(void* p) noexcept { trackedFree(p); }
+void operator delete[](void* p) noexcept { trackedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { trackedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { trackedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { trackedFree(p); }
+
+MemoryTracker::Usage MemoryTracker::usage(MemorySubsystem subsystem) {
+    const Counters& c = counters[static_cast<int>(subsystem)];
+    return Usage{c.live.load(std::memory_order_relaxed), c.peak.load(std::memory_order_relaxed),
+                 c.allocations.load(std::memory_order_relaxed), c.allocatedBytes.load(std::memory_order_relaxed)};
+}
+
+const char* MemoryTracker::name(MemorySubsystem subsystem) {
+    return subsystemNames[static_cast<int>(subsystem)];
+}
+
+uint64_t MemoryTracker::totalAllocations() {
+    uint64_t total = 0;
+    for (const auto& c : counters) total += c.allocations.load(std::memory_order_relaxed);
+    return total;
+}
+
+MemorySubsystem MemoryTracker::current() { return currentSubsystem; }
+void MemoryTracker::setCurrent(MemorySubsystem subsystem) { currentSubsystem = subsystem; }
+
+void MemoryTracker::writeReport(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    auto now = std::chrono::steady_clock::now();
+    double uptime = std::chrono::duration<double>(now - processStart).count();
+    double sinceLast = std::chrono::duration<double>(now - lastReport).count();
+    lastReport = now;
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::left << std::setw(14) << "Subsystem" << std::right
+        << std::setw(12) << "Live"
+        << std::setw(12) << "Peak"
+        << std::setw(14) << "Allocations"
+        << std::setw(14) << "Allocs/s"
+        << std::setw(16) << "Allocs/s (new)" << "\n";
+
+    uint64_t totalLive = 0;
+    for (int i = 0; i < static_cast<int>(MemorySubsystem::Count); ++i) {
+        Usage u = usage(static_cast<MemorySubsystem>(i));
+        uint64_t recent = u.allocations - lastAllocations[i];
+        lastAllocations[i] = u.allocations;
+        totalLive += u.liveBytes;
+
+        out << std::left << std::setw(14) << subsystemNames[i] << std::right
+            << std::setw(12) << formatBytes(u.liveBytes)
+            << std::setw(12) << formatBytes(u.peakBytes)
+            << std::setw(14) << u.allocations
+            << std::setw(14) << static_cast<uint64_t>(uptime > 0 ? u.allocations / uptime : 0)
+            << std::setw(16) << static_cast<uint64_t>(sinceLast > 0 ? recent / sinceLast : 0) << "\n";
+    }
+    out << std::left << std::setw(14) << "Total" << std::right
+        << std::setw(12) << formatBytes(totalLive) << "\n";
+    out << "(Allocs/s (new) is the rate since the previous report)\n";
+    out.flags(flags);
+}
+
+bool MemoryTracker::dump(const std::string& filename) {
+    std::ofstream out(filename);
+    if (!out.is_open()) return false;
+    writeReport(out);
+    return out.good();
+}
@@ -0,0 +1,61 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Parts of the program that heap memory is attributed to
+enum class MemorySubsystem : uint8_t {
+    Other,
+    Catalog,        // Book objects and their strings
+    Transactions,   // LoanTransaction records and loan indexes
+    Reservations,   // reservation queues
+    Users,          // User objects and loan history
+    Config,         // INIReader values
+    Analytics,      // popularity counts and other derived indexes
+    Count
+};
+
+// Per-subsystem heap accounting.
+// The global operator new/delete are replaced (MemoryTracker.cpp): every
+// allocation carries a small header with its size and the subsystem that was
+// active on the allocating thread, so frees are attributed correctly no matter
+// where they happen.
+class MemoryTracker {
+public:
+    struct Usage {
+        uint64_t liveBytes;
+        uint64_t peakBytes;
+        uint64_t allocations;     // since start
+        uint64_t allocatedBytes;  // since start
+    };
+
+    static Usage usage(MemorySubsystem subsystem);
+    static const char* name(MemorySubsystem subsystem);
+    static uint64_t totalAllocations();
+
+    static MemorySubsystem current();
+    static void setCurrent(MemorySubsystem subsystem);
+
+    // Table with live/peak bytes and allocation rates (overall and since the previous report)
+    static void writeReport(std::ostream& out);
+    static bool dump(const std::string& filename);
+};
+
+// Attributes allocations made by this thread in the enclosing scope
+class ScopedMemoryTag {
+public:
+    explicit ScopedMemoryTag(MemorySubsystem subsystem) : previous(MemoryTracker::current()) {
+        MemoryTracker::setCurrent(subsystem);
+    }
+    ~ScopedMemoryTag() { MemoryTracker::setCurrent(previous); }
+
+    ScopedMemoryTag(const ScopedMemoryTag&) = delete;
+    ScopedMemoryTag& operator=(const ScopedMemoryTag&) = delete;
+
+private:
+    MemorySubsystem previous;
+};
+
+#endif // MEMORY_TRACKER_H
@@ -0,0 +1,124 @@
+#include "Tracer.h"
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Tracer::enabled{false};
+
+namespace {
+    struct Span {
+        const char* name;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    // One per thread. The owning thread is the only writer; the mutex is
+    // uncontended except while a trace is being written out.
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Span> spans;
+        size_t next = 0;      // slot for the next span
+        bool wrapped = false;
+        uint32_t threadIndex = 0;
+        bool isMainThread = false;
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>>& registry() {
+        // Buffers outlive their threads so spans of finished threads are kept
+        static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        return buffers;
+    }
+
+    const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+    // Static initialisation runs on the main thread
+    const std::thread::id mainThreadId = std::this_thread::get_id();
+
+    ThreadBuffer& localBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+            auto created = std::make_shared<ThreadBuffer>();
+            created->spans.resize(Tracer::spansPerThread);
+            created->isMainThread = std::this_thread::get_id() == mainThreadId;
+            std::lock_guard<std::mutex> lock(registryMutex);
+            created->threadIndex = static_cast<uint32_t>(registry().size() + 1);
+            registry().push_back(created);
+            return created;
+        }();
+        return *buffer;
+    }
+
+    void writeEscaped(std::ostream& out, const char* text) {
+        for (const char* p = text; *p; ++p) {
+            if (*p == '"' || *p == '\\') out << '\\';
+            out << *p;
+        }
+    }
+}
+
+uint64_t Tracer::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void Tracer::record(const char* name, uint64_t startNs, uint64_t durationNs) {
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.spans[buffer.next] = Span{name, startNs, durationNs};
+    if (++buffer.next == buffer.spans.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+size_t Tracer::spanCount() {
+    size_t count = 0;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry()) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        count += buffer->wrapped ? buffer->spans.size() : buffer->next;
+    }
+    return count;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry()) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->next = 0;
+        buffer->wrapped = false;
+    }
+}
+
+bool Tracer::writeChromeTrace(const std::string& filename) {
+    std::ofstream out(filename);
+    if (!out.is_open()) return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry()) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIndex
+            << ",\"args\":{\"name\":\"" << (buffer->isMainThread ? "main" : "worker")
+            << " " << buffer->threadIndex << "\"}}";
+        first = false;
+
+        // Oldest span first
+        size_t count = buffer->wrapped ? buffer->spans.size() : buffer->next;
+        size_t begin = buffer->wrapped ? buffer->next : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const Span& span = buffer->spans[(begin + i) % buffer->spans.size()];
+            out << ",\n{\"name\":\"";
+            writeEscaped(out, span.name);
+            out << "\",\"cat\":\"library\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadIndex
+                << ",\"ts\":" << span.start / 1000 << "." << (span.start % 1000) / 100
+                << ",\"dur\":" << span.duration / 1000 << "." << (span.duration % 1000) / 100 << "}";
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
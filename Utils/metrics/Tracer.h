@@ -0,0 +1,51 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Timeline tracing in Chrome trace-event format (chrome://tracing, Perfetto).
+// Every thread records completed spans into its own fixed-size ring buffer, so
+// the newest spans win when a buffer wraps. While tracing is disabled a span
+// costs one relaxed atomic load.
+class Tracer {
+public:
+    static const size_t spansPerThread = 1 << 16;
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    // name must outlive the tracer (use string literals)
+    static void record(const char* name, uint64_t startNs, uint64_t durationNs);
+    static uint64_t nowNs();
+
+    // Writes all buffered spans as a Chrome trace JSON file
+    static bool writeChromeTrace(const std::string& filename);
+    static size_t spanCount();
+    static void clear();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records the lifetime of the enclosing scope as one span
+class ScopedTraceSpan {
+public:
+    explicit ScopedTraceSpan(const char* name)
+        : name(name), active(Tracer::isEnabled()), start(active ? Tracer::nowNs() : 0) {}
+    ~ScopedTraceSpan() {
+        if (active) Tracer::record(name, start, Tracer::nowNs() - start);
+    }
+
+    ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+    ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+private:
+    const char* name;
+    bool active;
+    uint64_t start;
+};
+
+#endif // TRACER_H
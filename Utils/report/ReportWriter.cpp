@@ -0,0 +1,172 @@
+#include "ReportWriter.h"
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+bool parseReportFormat(const std::string& name, ReportFormat& format) {
+    if (name == "text") format = ReportFormat::Text;
+    else if (name == "csv") format = ReportFormat::Csv;
+    else if (name == "jsonl" || name == "json") format = ReportFormat::JsonLines;
+    else return false;
+    return true;
+}
+
+ReportWriter::ReportWriter(int fd, ReportFormat format, const std::vector<ReportColumn>& columns,
+                           const char* textRowEnd)
+    : fd(fd), format(format), columns(columns), textRowEnd(textRowEnd), buffer(bufferSize) {
+    std::cout.flush();
+    if (format == ReportFormat::Csv) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i > 0) append(",");
+            append(columns[i].key);
+        }
+        append("\n");
+    }
+}
+
+ReportWriter::~ReportWriter() {
+    flush();
+}
+
+void ReportWriter::flush() {
+    const char* data = buffer.data();
+    while (used > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned>(used));
+#else
+        ssize_t written = ::write(fd, data, used);
+#endif
+        if (written <= 0) break; // the reader went away; drop the rest
+        data += written;
+        used -= static_cast<size_t>(written);
+    }
+    used = 0;
+}
+
+char* ReportWriter::reserve(size_t bytes) {
+    if (used + bytes > buffer.size()) {
+        flush();
+        if (bytes > buffer.size()) buffer.resize(bytes);
+    }
+    return buffer.data() + used;
+}
+
+void ReportWriter::append(std::string_view bytes) {
+    char* out = reserve(bytes.size());
+    std::memcpy(out, bytes.data(), bytes.size());
+    used += bytes.size();
+}
+
+void ReportWriter::text(std::string_view line) {
+    if (format != ReportFormat::Text) return;
+    append(line);
+}
+
+void ReportWriter::beginField(bool quoted) {
+    const ReportColumn& spec = columns[column];
+    switch (format) {
+        case ReportFormat::Text:
+            if (spec.label[0] == '\0') {
+                append(rowHasFields ? " [" : "[");
+            } else {
+                if (rowHasFields && spec.label[0] != '\n') append(afterTag ? " " : ", ");
+                append(spec.label);
+            }
+            break;
+        case ReportFormat::Csv:
+            if (quoted) append("\"");
+            break;
+        case ReportFormat::JsonLines:
+            append(rowHasFields ? ",\"" : "{\"");
+            append(spec.key);
+            append(quoted ? "\":\"" : "\":");
+            break;
+    }
+}
+
+void ReportWriter::endField(bool quoted) {
+    afterTag = format == ReportFormat::Text && columns[column].label[0] == '\0';
+    if (afterTag) append("]");
+    if (quoted && format != ReportFormat::Text) append("\"");
+    rowHasFields = true;
+    ++column;
+    if (format == ReportFormat::Csv && column < columns.size()) append(",");
+}
+
+ReportWriter& ReportWriter::field(long long value) {
+    if (column >= columns.size()) return *this;
+    beginField(false);
+    char* out = reserve(24);
+    used = static_cast<size_t>(std::to_chars(out, out + 24, value).ptr - buffer.data());
+    endField(false);
+    return *this;
+}
+
+ReportWriter& ReportWriter::field(double value) {
+    if (column >= columns.size()) return *this;
+    beginField(false);
+    char* out = reserve(32);
+    used = static_cast<size_t>(std::to_chars(out, out + 32, value).ptr - buffer.data());
+    endField(false);
+    return *this;
+}
+
+ReportWriter& ReportWriter::field(std::string_view value) {
+    if (column >= columns.size()) return *this;
+    bool quoted = format == ReportFormat::JsonLines ||
+                  (format == ReportFormat::Csv && value.find_first_of(",\"\r\n") != std::string_view::npos);
+    beginField(quoted);
+    if (quoted) appendEscaped(value);
+    else append(value);
+    endField(quoted);
+    return *this;
+}
+
+void ReportWriter::appendEscaped(std::string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    // Worst case is six bytes per character (\u00XX)
+    char* out = reserve(value.size() * 6);
+    char* start = out;
+    for (char c : value) {
+        if (format == ReportFormat::Csv) {
+            if (c == '"') *out++ = '"';
+            *out++ = c;
+        } else if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            std::memcpy(out, "\\u00", 4);
+            out[4] = hex[(c >> 4) & 0xF];
+            out[5] = hex[c & 0xF];
+            out += 6;
+        } else {
+            *out++ = c;
+        }
+    }
+    used += static_cast<size_t>(out - start);
+}
+
+ReportWriter& ReportWriter::skip() {
+    if (column >= columns.size()) return *this;
+    ++column;
+    if (format == ReportFormat::Csv && column < columns.size()) append(",");
+    return *this;
+}
+
+void ReportWriter::endRow() {
+    while (column < columns.size()) skip();
+    switch (format) {
+        case ReportFormat::Text: append(textRowEnd); break;
+        case ReportFormat::Csv: append("\n"); break;
+        case ReportFormat::JsonLines: append(rowHasFields ? "}\n" : "{}\n"); break;
+    }
+    column = 0;
+    rowHasFields = false;
+    afterTag = false;
+    ++rowCount;
+}
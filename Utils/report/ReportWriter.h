@@ -0,0 +1,77 @@
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class ReportFormat {
+    Text,
+    Csv,
+    JsonLines
+};
+
+// "text", "csv" or "jsonl"
+bool parseReportFormat(const std::string& name, ReportFormat& format);
+
+struct ReportColumn {
+    const char* key;    // CSV header and JSON key
+    const char* label;  // text prefix such as "Due: "; empty shows the value as a [tag]
+                        // and a leading '\n' starts a continuation line instead of ", "
+};
+
+// Formats listing rows into a large reusable buffer (numbers with to_chars)
+// and hands each full chunk to the file descriptor in a single write, so a
+// listing costs a few syscalls instead of one flush per row.
+//
+// Fields are given in column order; skip() leaves a column out (an empty CSV
+// field, no text or JSON member) and endRow() skips whatever is left.
+// std::cout is flushed on construction, so earlier output stays in order.
+class ReportWriter {
+public:
+    static const size_t bufferSize = 256 * 1024;
+
+    ReportWriter(int fd, ReportFormat format, const std::vector<ReportColumn>& columns,
+                 const char* textRowEnd = "\n");
+    ~ReportWriter();
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    ReportFormat getFormat() const { return format; }
+    size_t getRowCount() const { return rowCount; }
+
+    // Headings and notes; only the text format shows them
+    void text(std::string_view line);
+
+    ReportWriter& field(long long value);
+    ReportWriter& field(int value) { return field(static_cast<long long>(value)); }
+    ReportWriter& field(double value);
+    ReportWriter& field(std::string_view value);
+    ReportWriter& field(const std::string& value) { return field(std::string_view(value)); }
+    ReportWriter& field(const char* value) { return field(std::string_view(value)); }
+    ReportWriter& skip();
+    void endRow();
+
+    void flush();
+
+private:
+    int fd;
+    ReportFormat format;
+    const std::vector<ReportColumn>& columns;
+    const char* textRowEnd;
+    std::vector<char> buffer;
+    size_t used = 0;
+    size_t column = 0;
+    bool rowHasFields = false;
+    bool afterTag = false;      // a [tag] is followed by a space, not ", "
+    size_t rowCount = 0;
+
+    char* reserve(size_t bytes);
+    void append(std::string_view bytes);
+    void beginField(bool quoted);
+    void endField(bool quoted);
+    void appendEscaped(std::string_view value);
+};
+
+#endif // REPORT_WRITER_H
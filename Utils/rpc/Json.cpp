@@ -0,0 +1,386 @@
+#include "Json.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+bool JsonDocument::parse(std::string_view text, std::string& error) {
+    nodes.clear();
+    scratch.clear();
+    // Unescaped strings are never longer than their source, so the scratch
+    // buffer is not reallocated under the views taken into it
+    scratch.reserve(text.size());
+    input = text;
+    pos = 0;
+    if (!parseValue(0, error)) return false;
+    skipSpace();
+    if (pos != input.size()) {
+        error = "unexpected text after the value";
+        return false;
+    }
+    return true;
+}
+
+void JsonDocument::skipSpace() {
+    while (pos < input.size() &&
+           (input[pos] == ' ' || input[pos] == '\t' || input[pos] == '\r' || input[pos] == '\n')) {
+        ++pos;
+    }
+}
+
+bool JsonDocument::parseValue(int depth, std::string& error) {
+    if (depth > maxDepth) {
+        error = "nested too deeply";
+        return false;
+    }
+    skipSpace();
+    if (pos == input.size()) {
+        error = "unexpected end of input";
+        return false;
+    }
+
+    const char c = input[pos];
+    if (c == '{' || c == '[') {
+        const bool isObject = c == '{';
+        const size_t self = nodes.size();
+        nodes.push_back(Node{isObject ? Type::Object : Type::Array, false, {}, 0});
+        ++pos;
+        skipSpace();
+        const char close = isObject ? '}' : ']';
+        if (pos < input.size() && input[pos] == close) {
+            ++pos;
+        } else {
+            while (true) {
+                if (isObject) {
+                    skipSpace();
+                    std::string_view key;
+                    if (pos == input.size() || input[pos] != '"') {
+                        error = "expected a member name";
+                        return false;
+                    }
+                    if (!parseString(key, error)) return false;
+                    nodes.push_back(Node{Type::String, false, key, static_cast<uint32_t>(nodes.size() + 1)});
+                    skipSpace();
+                    if (pos == input.size() || input[pos] != ':') {
+                        error = "expected ':'";
+                        return false;
+                    }
+                    ++pos;
+                }
+                if (!parseValue(depth + 1, error)) return false;
+                skipSpace();
+                if (pos < input.size() && input[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                if (pos < input.size() && input[pos] == close) {
+                    ++pos;
+                    break;
+                }
+                error = isObject ? "expected ',' or '}'" : "expected ',' or ']'";
+                return false;
+            }
+        }
+        nodes[self].end = static_cast<uint32_t>(nodes.size());
+        return true;
+    }
+    if (c == '"') {
+        std::string_view text;
+        if (!parseString(text, error)) return false;
+        nodes.push_back(Node{Type::String, false, text, static_cast<uint32_t>(nodes.size() + 1)});
+        return true;
+    }
+    if (c == 't') return parseLiteral("true", Type::Bool, true, error);
+    if (c == 'f') return parseLiteral("false", Type::Bool, false, error);
+    if (c == 'n') return parseLiteral("null", Type::Null, false, error);
+    return parseNumber(error);
+}
+
+bool JsonDocument::parseLiteral(std::string_view literal, Type type, bool boolean, std::string& error) {
+    if (input.substr(pos, literal.size()) != literal) {
+        error = "unexpected character";
+        return false;
+    }
+    pos += literal.size();
+    nodes.push_back(Node{type, boolean, literal, static_cast<uint32_t>(nodes.size() + 1)});
+    return true;
+}
+
+bool JsonDocument::parseNumber(std::string& error) {
+    const size_t start = pos;
+    auto digits = [this] {
+        size_t first = pos;
+        while (pos < input.size() && input[pos] >= '0' && input[pos] <= '9') ++pos;
+        return pos > first;
+    };
+    if (pos < input.size() && input[pos] == '-') ++pos;
+    bool valid = digits();
+    if (valid && pos < input.size() && input[pos] == '.') {
+        ++pos;
+        valid = digits();
+    }
+    if (valid && pos < input.size() && (input[pos] == 'e' || input[pos] == 'E')) {
+        ++pos;
+        if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) ++pos;
+        valid = digits();
+    }
+    if (!valid) {
+        error = "bad number";
+        return false;
+    }
+    nodes.push_back(Node{Type::Number, false, input.substr(start, pos - start),
+                         static_cast<uint32_t>(nodes.size() + 1)});
+    return true;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void appendUtf8(std::string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+// pos is at the opening quote
+bool JsonDocument::parseString(std::string_view& text, std::string& error) {
+    const size_t start = ++pos;
+    while (pos < input.size() && input[pos] != '"' && input[pos] != '\\') {
+        if (static_cast<unsigned char>(input[pos]) < 0x20) {
+            error = "control character in string";
+            return false;
+        }
+        ++pos;
+    }
+    if (pos == input.size()) {
+        error = "unterminated string";
+        return false;
+    }
+    if (input[pos] == '"') {
+        text = input.substr(start, pos - start);
+        ++pos;
+        return true;
+    }
+
+    // Escapes: copy what was scanned so far and decode the rest into scratch
+    const size_t begin = scratch.size();
+    scratch.append(input.data() + start, pos - start);
+    while (true) {
+        if (pos == input.size()) {
+            error = "unterminated string";
+            return false;
+        }
+        const char c = input[pos++];
+        if (c == '"') break;
+        if (static_cast<unsigned char>(c) < 0x20) {
+            error = "control character in string";
+            return false;
+        }
+        if (c != '\\') {
+            scratch += c;
+            continue;
+        }
+        if (pos == input.size()) {
+            error = "unterminated string";
+            return false;
+        }
+        const char escape = input[pos++];
+        switch (escape) {
+            case '"': scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/': scratch += '/'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'u': {
+                auto readHex = [this](unsigned& code) {
+                    if (pos + 4 > input.size()) return false;
+                    code = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        int digit = hexValue(input[pos + i]);
+                        if (digit < 0) return false;
+                        code = code * 16 + static_cast<unsigned>(digit);
+                    }
+                    pos += 4;
+                    return true;
+                };
+                unsigned code;
+                if (!readHex(code)) {
+                    error = "bad \\u escape";
+                    return false;
+                }
+                // A surrogate pair is one character; a lone surrogate becomes U+FFFD
+                if (code >= 0xD800 && code < 0xDC00 && input.substr(pos, 2) == "\\u") {
+                    pos += 2;
+                    unsigned low;
+                    if (!readHex(low)) {
+                        error = "bad \\u escape";
+                        return false;
+                    }
+                    code = (low >= 0xDC00 && low < 0xE000) ? 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00) : 0xFFFD;
+                } else if (code >= 0xD800 && code < 0xE000) {
+                    code = 0xFFFD;
+                }
+                appendUtf8(scratch, code);
+                break;
+            }
+            default:
+                error = "bad escape";
+                return false;
+        }
+    }
+    text = std::string_view(scratch.data() + begin, scratch.size() - begin);
+    return true;
+}
+
+const JsonDocument::Node* JsonDocument::find(const Node& object, std::string_view key) const {
+    if (object.type != Type::Object) return nullptr;
+    size_t member = static_cast<size_t>(&object - nodes.data()) + 1;
+    while (member < object.end) {
+        const Node& value = nodes[member + 1];
+        if (nodes[member].text == key) return &value;
+        member = value.end;
+    }
+    return nullptr;
+}
+
+bool JsonDocument::toInt(const Node* node, long long& value) {
+    if (!node || node->type != Type::Number) return false;
+    const char* end = node->text.data() + node->text.size();
+    auto result = std::from_chars(node->text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+bool JsonDocument::toDouble(const Node* node, double& value) {
+    if (!node || node->type != Type::Number) return false;
+    // strtod needs a terminator; numbers are short
+    char buffer[64];
+    if (node->text.size() >= sizeof(buffer)) return false;
+    node->text.copy(buffer, node->text.size());
+    buffer[node->text.size()] = '\0';
+    value = std::strtod(buffer, nullptr);
+    return true;
+}
+
+bool JsonDocument::toString(const Node* node, std::string_view& value) {
+    if (!node || node->type != Type::String) return false;
+    value = node->text;
+    return true;
+}
+
+void JsonWriter::separate() {
+    if (needComma) out += ',';
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separate();
+    out += '{';
+    needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    out += '}';
+    needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separate();
+    out += '[';
+    needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    out += ']';
+    needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    value(name);
+    out += ':';
+    needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    separate();
+    out += '"';
+    size_t run = 0;     // unescaped bytes not yet copied
+    for (size_t i = 0; i < text.size(); ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            ++run;
+            continue;
+        }
+        out.append(text.data() + i - run, run);
+        run = 0;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+        }
+    }
+    out.append(text.data() + text.size() - run, run);
+    out += '"';
+    needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(long long number) {
+    separate();
+    char buffer[24];
+    out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), number).ptr);
+    needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    if (!std::isfinite(number)) return null();
+    separate();
+    char buffer[32];
+    out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), number).ptr);
+    needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    return raw(flag ? "true" : "false");
+}
+
+JsonWriter& JsonWriter::null() {
+    return raw("null");
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+    separate();
+    out += json;
+    needComma = true;
+    return *this;
+}
@@ -0,0 +1,88 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One parsed JSON text as a flat array of nodes in document order. An
+// object or array node is followed by its contents (an object's members are
+// key/value node pairs), and `end` is the index just past a node's subtree,
+// so skipping a value is one jump. Strings point into the input when they
+// have no escapes and into a scratch buffer otherwise. Parsing again reuses
+// both arrays, so a long-lived document stops allocating once warmed up.
+// The input must outlive the parsed nodes.
+class JsonDocument {
+public:
+    enum class Type : uint8_t {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    struct Node {
+        Type type;
+        bool boolean;
+        std::string_view text;  // number as written, or unescaped string
+        uint32_t end;
+    };
+
+    static const int maxDepth = 64;
+
+    bool parse(std::string_view input, std::string& error);
+
+    const Node& root() const { return nodes.front(); }
+    // Value of an object member, or nullptr (also when object is not an object)
+    const Node* find(const Node& object, std::string_view key) const;
+
+    static bool toInt(const Node* node, long long& value);
+    static bool toDouble(const Node* node, double& value);
+    static bool toString(const Node* node, std::string_view& value);
+
+private:
+    std::vector<Node> nodes;
+    std::string scratch;
+    std::string_view input;
+    size_t pos = 0;
+
+    bool parseValue(int depth, std::string& error);
+    bool parseString(std::string_view& text, std::string& error);
+    bool parseNumber(std::string& error);
+    bool parseLiteral(std::string_view literal, Type type, bool boolean, std::string& error);
+    void skipSpace();
+};
+
+// Appends compact JSON to a string. Commas between members and elements
+// are inserted automatically; numbers are formatted with to_chars.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out(out) {}
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& value(std::string_view text);
+    JsonWriter& value(const std::string& text) { return value(std::string_view(text)); }
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(long long number);
+    JsonWriter& value(int number) { return value(static_cast<long long>(number)); }
+    JsonWriter& value(double number);       // NaN and infinities are written as null
+    JsonWriter& value(bool flag);
+    JsonWriter& null();
+    JsonWriter& raw(std::string_view json); // an already encoded value
+
+private:
+    std::string& out;
+    bool needComma = false;
+
+    void separate();
+};
+
+#endif // JSON_H
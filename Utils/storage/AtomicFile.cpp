@@ -0,0 +1,178 @@
+#include "AtomicFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include "../checksum/Crc32c.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const size_t bufferSize = 1 << 20;
+const char checksumPrefix[] = "#crc32c=";
+
+int openForWriting(const std::string& path) {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        const int written = _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1u << 30)));
+#else
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+#endif
+        if (written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool syncDescriptor(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
+
+void closeDescriptor(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Renames over filename, then makes the new directory entry durable
+bool renameDurably(const std::string& tempFile, const std::string& filename) {
+#ifdef _WIN32
+    // Replaces an existing file (rename() would not), and returns once the move is on disk
+    return MoveFileExA(tempFile.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (std::rename(tempFile.c_str(), filename.c_str()) != 0) return false;
+    const std::string directory = std::filesystem::path(filename).parent_path().string();
+    const int directoryFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);   // not every file system can sync a directory; the rename stands either way
+        ::close(directoryFd);
+    }
+    return true;
+#endif
+}
+}
+
+bool replaceFile(const std::string& tempFile, const std::string& filename) {
+#ifdef _WIN32
+    const int fd = _open(tempFile.c_str(), _O_RDWR | _O_BINARY);   // _commit needs write access
+#else
+    const int fd = ::open(tempFile.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    const bool synced = fd >= 0 && syncDescriptor(fd);
+    if (fd >= 0) closeDescriptor(fd);
+    if (!synced || !renameDurably(tempFile, filename)) {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+void AtomicFileWriter::Buffer::start(int descriptor, size_t size) {
+    fd = descriptor;
+    bytes.resize(size);
+    setp(bytes.data(), bytes.data() + bytes.size());
+}
+
+bool AtomicFileWriter::Buffer::flush() {
+    const size_t size = static_cast<size_t>(pptr() - pbase());
+    if (size > 0) {
+        crc = crc32c(pbase(), size, crc);
+        if (!failed && !writeAll(fd, pbase(), size)) failed = true;
+        setp(bytes.data(), bytes.data() + bytes.size());
+    }
+    return !failed;
+}
+
+AtomicFileWriter::Buffer::int_type AtomicFileWriter::Buffer::overflow(int_type c) {
+    if (!flush()) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int AtomicFileWriter::Buffer::sync() {
+    return flush() ? 0 : -1;
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string& filename)
+    : filename(filename), tempFile(filename + ".tmp"), out(&buffer) {
+    const int fd = openForWriting(tempFile);
+    if (fd < 0) {
+        out.setstate(std::ios::badbit);
+        return;
+    }
+    buffer.start(fd, bufferSize);
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    if (buffer.fd >= 0) closeDescriptor(buffer.fd);
+    if (!committed) std::remove(tempFile.c_str());
+}
+
+uint32_t AtomicFileWriter::checksum() {
+    out.flush();
+    return buffer.crc;
+}
+
+bool AtomicFileWriter::commit() {
+    if (committed || buffer.fd < 0) return false;
+    out.flush();
+    const bool written = !out.fail() && !buffer.failed && syncDescriptor(buffer.fd);
+    closeDescriptor(buffer.fd);
+    buffer.fd = -1;
+    if (!written || !renameDurably(tempFile, filename)) return false;   // the destructor removes tempFile
+    committed = true;
+    return true;
+}
+
+bool AtomicFileWriter::commitWithChecksum() {
+    char trailer[32];
+    std::snprintf(trailer, sizeof(trailer), "%s%08x\n", checksumPrefix, static_cast<unsigned>(checksum()));
+    out << trailer;
+    return commit();
+}
+
+bool checkChecksumLine(std::string& content) {
+    size_t end = content.size();
+    if (end > 0 && content[end - 1] == '\n') --end;
+    const size_t last = content.rfind('\n', end == 0 ? 0 : end - 1);
+    const size_t start = last == std::string::npos ? 0 : last + 1;
+    const size_t prefixLength = sizeof(checksumPrefix) - 1;
+    if (content.compare(start, prefixLength, checksumPrefix) != 0) return true;
+
+    const std::string stored = content.substr(start + prefixLength, end - start - prefixLength);
+    char* parsedEnd = nullptr;
+    const unsigned long expected = std::strtoul(stored.c_str(), &parsedEnd, 16);
+    const bool matches = !stored.empty() && *parsedEnd == '\0' && expected == crc32c(content.data(), start);
+    content.resize(start);
+    return matches;
+}
@@ -0,0 +1,65 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Crash-consistent saves. A file is written in full to filename.tmp, the
+// temporary file is flushed to disk and renamed over filename, and then the
+// directory is flushed so the rename itself survives a power cut. After a
+// crash filename holds either its old or its new contents, never a mix.
+
+// Flushes tempFile to disk, renames it over filename and flushes the
+// directory. On failure tempFile is removed and filename is left as it was.
+bool replaceFile(const std::string& tempFile, const std::string& filename);
+
+// A stream onto filename.tmp that keeps the CRC-32C of everything written.
+// Nothing reaches filename until commit() succeeds; a writer destroyed
+// without committing removes its temporary file.
+class AtomicFileWriter {
+public:
+    explicit AtomicFileWriter(const std::string& filename);
+    ~AtomicFileWriter();
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    bool isOpen() const { return buffer.fd >= 0; }
+    std::ostream& stream() { return out; }
+    // Of everything written so far
+    uint32_t checksum();
+    bool commit();
+    // Ends the file with a checksum line (see checkChecksumLine) and commits
+    bool commitWithChecksum();
+
+private:
+    // A 1 MiB buffer in front of the descriptor; the CRC is taken of each
+    // chunk as it is flushed, while it is still in cache
+    struct Buffer : std::streambuf {
+        int fd = -1;
+        uint32_t crc = 0;
+        bool failed = false;
+        std::vector<char> bytes;
+
+        void start(int descriptor, size_t size);
+        bool flush();
+        int_type overflow(int_type c) override;
+        int sync() override;
+    };
+
+    std::string filename;
+    std::string tempFile;
+    Buffer buffer;
+    std::ostream out;
+    bool committed = false;
+};
+
+// Text files saved with commitWithChecksum end with "#crc32c=<8 hex digits>",
+// the CRC-32C of everything before that line. Cuts the line off content and
+// returns whether it matches. Content without one (files from before
+// checksums, or written by other tools) is left as it is and passes.
+bool checkChecksumLine(std::string& content);
+
+#endif // ATOMIC_FILE_H
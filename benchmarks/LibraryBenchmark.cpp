@@ -0,0 +1,504 @@
+// Microbenchmarks for LoanManager, BookSearch, CSVStorageManager and TransactionArchive.
+//
+// Build from the repository root:
+//   gcc -O2 -c Utils/ini/ini.c -o ini.o
+//   g++ -std=c++17 -O2 -pthread -I. benchmarks/LibraryBenchmark.cpp
+//       "Core Classes/"*.cpp Utils/csv/*.cpp Utils/concurrency/*.cpp Utils/metrics/*.cpp Utils/report/*.cpp
+//       Utils/archive/*.cpp Utils/checksum/*.cpp Utils/storage/*.cpp
+//       Utils/ini/ConfigManager.cpp Utils/ini/GlobalConfiguration.cpp
+//       Utils/ini/iniReader/INIReader.cpp ini.o -o LibraryBenchmark
+// (one command, wrapped here)
+// The tree has no build system to hang a target on (the Code::Blocks project
+// is not checked in), so this command is the benchmark's build.
+//
+// Usage:
+//   LibraryBenchmark [--sizes 1000,100000,10000000] [--json results.jsonl] [--dir /tmp]
+//                    [--threads 1,2,4,8] [--no-metrics]
+//
+// --no-metrics turns off the latency histograms, to measure their overhead.
+// --threads lists the shared pool sizes the parallel paths (fine accrual,
+// statistics scan, CSV and archive loading) are timed with; the default is
+// the powers of two up to the hardware thread count, and that count itself.
+// Their rows are named "<benchmark>[<n> threads]".
+//
+// A table is printed to stderr. One JSON object per measurement is written to
+// stdout (or to --json), so runs can be diffed to track regressions.
+// Allocations are counted by MemoryTracker; its per-subsystem report is
+// printed to stderr at the end. The archive's index lookups are checked
+// against a full scan; if they disagree the exit status is 1.
+//
+// Memory is reported per measurement, not for the process:
+//   heap  - live heap bytes after the measurement minus before (MemoryTracker)
+//   rss   - peak resident size during the measurement minus the size at its
+//           start. On Linux the peak is reset before each measurement
+//           (/proc/self/clear_refs); elsewhere it is the resident size at the
+//           end, so only memory still held is seen.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Core Classes/Book.h"
+#include "Core Classes/User.h"
+#include "Core Classes/LoanManager.h"
+#include "Core Classes/BookSearch.h"
+#include "Utils/csv/CSVStorageManager.h"
+#include "Utils/analytics/DayNumber.h"
+#include "Utils/archive/TransactionArchive.h"
+#include "Utils/concurrency/ThreadPool.h"
+#include "Utils/metrics/LatencyHistogram.h"
+#include "Utils/metrics/MemoryTracker.h"
+
+namespace {
+
+#ifdef __linux__
+// A "VmRSS:" style line of /proc/self/status, in kilobytes
+long procStatusKb(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = std::strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0) return std::atol(line.c_str() + length);
+    }
+    return 0;
+}
+#endif
+
+long currentRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<long>(counters.WorkingSetSize / 1024);
+    }
+    return 0;
+#elif defined(__linux__)
+    return procStatusKb("VmRSS:");
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024; // bytes on macOS; only a peak is available
+#endif
+}
+
+// Starts a new high-water mark; returns false where that is not possible
+bool resetPeakRss() {
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.close();
+    return static_cast<bool>(clearRefs);
+#else
+    return false;
+#endif
+}
+
+// Peak resident size since resetPeakRss(), or the current size without one
+long phasePeakRssKb(bool peakWasReset) {
+#ifdef __linux__
+    if (peakWasReset) return procStatusKb("VmHWM:");
+#endif
+    (void)peakWasReset;
+    return currentRssKb();
+}
+
+int64_t liveHeapBytes() {
+    int64_t live = 0;
+    for (size_t i = 0; i < static_cast<size_t>(MemorySubsystem::Count); ++i) {
+        live += static_cast<int64_t>(MemoryTracker::usage(static_cast<MemorySubsystem>(i)).liveBytes);
+    }
+    return live;
+}
+
+struct Result {
+    std::string name;
+    size_t threads;         // shared pool size during the measurement
+    size_t records;
+    size_t ops;
+    double nsPerOp;
+    double allocsPerOp;
+    long heapDeltaKb;       // live heap after minus before
+    long rssDeltaKb;        // peak resident size during minus at the start
+};
+
+std::vector<Result> results;
+int failedChecks = 0;   // lookups that disagreed with a full scan; makes the exit status 1
+
+// Makes the optimizer assume value is read, so the call producing it is kept
+template <typename T>
+void doNotOptimize(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+#endif
+}
+
+// Runs fn once; fn performs `ops` operations
+template <typename Fn>
+void measure(const std::string& name, size_t records, size_t ops, Fn fn) {
+    const int64_t heapBefore = liveHeapBytes();
+    const long rssBefore = currentRssKb();
+    const bool peakWasReset = resetPeakRss();
+    uint64_t allocsBefore = MemoryTracker::totalAllocations();
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    uint64_t allocs = MemoryTracker::totalAllocations() - allocsBefore;
+    const long rssDelta = phasePeakRssKb(peakWasReset) - rssBefore;
+    const long heapDelta = static_cast<long>((liveHeapBytes() - heapBefore) / 1024);
+
+    if (ops == 0) ops = 1;
+    Result r{name, ThreadPool::global().size(), records, ops, elapsed.count() / ops, static_cast<double>(allocs) / ops, heapDelta, rssDelta};
+    results.push_back(r);
+    std::fprintf(stderr, "%-34s %10zu %12.1f ns/op %10.2f allocs/op %10ld KB heap %10ld KB rss\n",
+                 r.name.c_str(), r.records, r.nsPerOp, r.allocsPerOp, r.heapDeltaKb, r.rssDeltaKb);
+}
+
+std::vector<std::unique_ptr<Book>> makeBooks(size_t count) {
+    static const char* categories[] = {"Science", "History", "Fiction", "Art", "Computing"};
+    std::vector<std::unique_ptr<Book>> books;
+    books.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        int id = static_cast<int>(i + 1);
+        std::string title = "Title " + std::to_string(id);
+        std::string author = "Author " + std::to_string(id % 997);
+        std::string category = categories[i % 5];
+        switch (i % 3) {
+            case 0:
+                books.push_back(std::make_unique<TextBook>(id, title, author, category, "2001-05-17", 320,
+                                                           "Undergraduate", "Physics"));
+                break;
+            case 1:
+                books.push_back(std::make_unique<Magazine>(id, title, author, category, "2019-02-01", 64,
+                                                           static_cast<int>(i % 120)));
+                break;
+            default:
+                // Reference books cannot be borrowed, so use text books for the loan benchmarks
+                books.push_back(std::make_unique<TextBook>(id, title, author, category, "1995-09-09", 800,
+                                                           "Graduate", "Mathematics"));
+                break;
+        }
+    }
+    return books;
+}
+
+// Even positions are regular users and odd ones librarians, so both roles'
+// borrow checks (limit, fines and standing for regular users) are timed
+std::vector<std::unique_ptr<User>> makeUsers(size_t count) {
+    std::vector<std::unique_ptr<User>> users;
+    users.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        int id = static_cast<int>(i + 1);
+        if (i % 2 == 0) {
+            users.push_back(std::make_unique<RegularUser>(id, "user" + std::to_string(id), "secret"));
+        } else {
+            users.push_back(std::make_unique<Librarian>(id, "user" + std::to_string(id), "secret"));
+        }
+    }
+    return users;
+}
+
+// The archive's index lookups against a full scan, on returned loans spread
+// over three years (the loans in runSuite are all borrowed today, so every
+// block would match any date range)
+void measureArchiveLookups(size_t n, size_t userCount, const std::string& archiveFile) {
+    const int firstDay = dayNumber("2023-01-01");
+    const int spanDays = 3 * 365;
+    TransactionArchive::Rows history;
+    history.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const int day = firstDay + static_cast<int>(static_cast<uint64_t>(i) * spanDays / n);
+        auto loan = std::make_unique<LoanTransaction>(static_cast<int>(i + 1), static_cast<int>(i % userCount + 1),
+                                                      static_cast<int>(i + 1), dateFromDayNumber(day),
+                                                      dateFromDayNumber(day + 14));
+        loan->returnDate = dateFromDayNumber(day + 10);
+        loan->isReturned = true;
+        history.push_back(std::move(loan));
+    }
+    if (!TransactionArchive::write(archiveFile, history)) return;
+    history.clear();
+
+    TransactionArchive archive;
+    if (!archive.open(archiveFile)) return;
+    const size_t lookups = std::min<size_t>(n, 1000);
+    size_t found = 0;
+    measure("archive.findById", n, lookups, [&] {
+        for (size_t i = 0; i < lookups; ++i) {
+            const int id = static_cast<int>(i * n / lookups + 1);
+            auto loan = archive.findById(id);
+            if (loan && loan->transactionId == id) ++found;
+        }
+    });
+
+    const std::string from = dateFromDayNumber(firstDay + spanDays / 2);
+    const std::string to = dateFromDayNumber(firstDay + spanDays / 2 + 29);
+    size_t inRange = 0;
+    measure("archive.borrowedBetween(30 days)", n, 1, [&] { inRange = archive.borrowedBetween(from, to).size(); });
+    size_t scanned = 0;
+    measure("archive.readAll+filter(30 days)", n, 1, [&] {
+        TransactionArchive::Rows rows;
+        archive.readAll(rows);
+        for (const auto& loan : rows) {
+            if (from <= loan->borrowDate && loan->borrowDate <= to) ++scanned;
+        }
+    });
+
+    if (found != lookups || inRange != scanned) {
+        std::fprintf(stderr, "archive lookups disagree with a full scan: %zu of %zu ids found, %zu vs %zu rows in range\n",
+                     found, lookups, inRange, scanned);
+        ++failedChecks;
+    }
+    std::remove(archiveFile.c_str());
+}
+
+void runSuite(size_t n, const std::string& dir, const std::vector<size_t>& threadCounts) {
+    std::fprintf(stderr, "\n--- %zu records ---\n", n);
+
+    // Book i goes to users[i % users.size()]. The user count is even, so even
+    // books go to regular users and odd ones to librarians, and each user
+    // borrows at most 4 books, within the default limits of both roles.
+    auto books = makeBooks(n);
+    auto users = makeUsers(2 * (n / 8 + 1));
+    LoanManager manager;
+
+    const size_t regularLoans = (n + 1) / 2;
+    measure("borrowBook(regular)", n, regularLoans, [&] {
+        for (size_t i = 0; i < n; i += 2) {
+            manager.borrowBook(users[i % users.size()].get(), books[i].get());
+        }
+    });
+    measure("borrowBook(librarian)", n, n - regularLoans, [&] {
+        for (size_t i = 1; i < n; i += 2) {
+            manager.borrowBook(users[i % users.size()].get(), books[i].get());
+        }
+    });
+
+    measure("reserveBook", n, n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            manager.reserveBook(users[(i + 1) % users.size()].get(), books[i].get());
+        }
+    });
+
+    const size_t scans = 5;
+    measure("getOverdueCount", n, scans, [&] {
+        for (size_t i = 0; i < scans; ++i) doNotOptimize(manager.getOverdueCount());
+    });
+    measure("getTotalFines", n, scans, [&] {
+        for (size_t i = 0; i < scans; ++i) doNotOptimize(manager.getTotalFines());
+    });
+    measure("accrueFines(first pass)", n, 1, [&] { manager.accrueFines(books, users); });
+    measure("accrueFines", n, scans, [&] {
+        for (size_t i = 0; i < scans; ++i) manager.accrueFines(books, users);
+    });
+
+    measure("searchBooks(title)", n, scans, [&] {
+        for (size_t i = 0; i < scans; ++i) {
+            BookSearch::search(books, BookSearch::Field::Title, "Title 42");
+        }
+    });
+    measure("searchBooks(category)", n, scans, [&] {
+        for (size_t i = 0; i < scans; ++i) {
+            BookSearch::search(books, BookSearch::Field::Category, "Fiction");
+        }
+    });
+
+    // Save and load while the history still has open loans and reservations
+    std::vector<Reservation> allReservations;
+    for (const auto& pair : manager.getReservations()) {
+        std::queue<Reservation> q = pair.second;
+        while (!q.empty()) {
+            allReservations.push_back(q.front());
+            q.pop();
+        }
+    }
+    const std::string usersFile = dir + "/bench_users.csv";
+    const std::string booksFile = dir + "/bench_books.csv";
+    const std::string transactionsFile = dir + "/bench_transactions.csv";
+    const std::string archiveFile = dir + "/bench_transactions.archive";
+    const std::string reservationsFile = dir + "/bench_reservations.csv";
+
+    measure("saveUsers", users.size(), users.size(), [&] { CSVStorageManager::saveUsers(users, usersFile); });
+    measure("loadUsers", users.size(), users.size(), [&] { CSVStorageManager::loadUsers(usersFile); });
+    measure("saveBooks", n, n, [&] { CSVStorageManager::saveBooks(books, booksFile); });
+    measure("loadBooks", n, n, [&] { CSVStorageManager::loadBooks(booksFile); });
+    measure("saveLoanTransactions", n, n, [&] {
+        CSVStorageManager::saveLoanTransactions(manager.getTransactions(), transactionsFile);
+    });
+    measure("loadLoanTransactions", n, n, [&] { CSVStorageManager::loadLoanTransactions(transactionsFile); });
+    measure("saveTransactionArchive", n, n, [&] {
+        TransactionArchive::write(archiveFile, manager.getTransactions());
+    });
+    measure("loadTransactionArchive", n, n, [&] {
+        TransactionArchive archive;
+        TransactionArchive::Rows rows;
+        if (archive.open(archiveFile)) archive.readAll(rows);
+    });
+    measureArchiveLookups(n, users.size(), dir + "/bench_history.archive");
+
+    std::error_code sizeError;
+    std::cerr << "transactions on disk: csv " << std::filesystem::file_size(transactionsFile, sizeError)
+              << " bytes, archive " << std::filesystem::file_size(archiveFile, sizeError) << " bytes\n";
+
+    // The parallel paths again, with the shared pool resized to each count
+    const size_t defaultThreads = ThreadPool::global().size();
+    for (size_t threads : threadCounts) {
+        ThreadPool::resizeGlobal(threads);
+        const std::string suffix = "[" + std::to_string(threads) + " threads]";
+        measure("accrueFines" + suffix, n, scans, [&] {
+            for (size_t i = 0; i < scans; ++i) manager.accrueFines(books, users);
+        });
+        measure("computeStatistics" + suffix, n, scans, [&] {
+            for (size_t i = 0; i < scans; ++i) doNotOptimize(manager.computeStatistics().totalLoans);
+        });
+        measure("loadLoanTransactions" + suffix, n, n, [&] {
+            CSVStorageManager::loadLoanTransactions(transactionsFile);
+        });
+        measure("loadTransactionArchive" + suffix, n, n, [&] {
+            TransactionArchive archive;
+            TransactionArchive::Rows rows;
+            if (archive.open(archiveFile)) archive.readAll(rows);
+        });
+    }
+    ThreadPool::resizeGlobal(defaultThreads);
+    measure("saveReservations", allReservations.size(), allReservations.size(), [&] {
+        CSVStorageManager::saveReservations(allReservations, reservationsFile);
+    });
+    measure("loadReservations", allReservations.size(), allReservations.size(), [&] {
+        CSVStorageManager::loadReservations(reservationsFile);
+    });
+
+    // Listings rendered to a file, as when the output is redirected
+    const std::string listingFile = dir + "/bench_listing.txt";
+    const std::pair<const char*, ReportFormat> formats[] = {
+        {"text", ReportFormat::Text}, {"csv", ReportFormat::Csv}, {"jsonl", ReportFormat::JsonLines}};
+    for (const auto& [formatName, format] : formats) {
+        FILE* file = std::fopen(listingFile.c_str(), "wb");
+        if (!file) break;
+        measure(std::string("renderBooks(") + formatName + ")", n, n, [&] {
+            ReportWriter out(fileno(file), format, Book::reportColumns());
+            for (const auto& book : books) {
+                book->render(out);
+                out.endRow();
+            }
+        });
+        measure(std::string("printAllLoans(") + formatName + ")", n, n, [&] {
+            manager.printAllLoans(format, fileno(file));
+        });
+        std::fclose(file);
+    }
+    std::remove(listingFile.c_str());
+
+    measure("returnBook(regular)", n, regularLoans, [&] {
+        for (size_t i = 0; i < n; i += 2) {
+            manager.returnBook(users[i % users.size()].get(), books[i].get());
+        }
+    });
+    measure("returnBook(librarian)", n, n - regularLoans, [&] {
+        for (size_t i = 1; i < n; i += 2) {
+            manager.returnBook(users[i % users.size()].get(), books[i].get());
+        }
+    });
+
+    std::remove(usersFile.c_str());
+    std::remove(booksFile.c_str());
+    std::remove(transactionsFile.c_str());
+    std::remove(archiveFile.c_str());
+    std::remove(reservationsFile.c_str());
+}
+
+void writeJson(std::ostream& out) {
+    for (const auto& r : results) {
+        out << "{\"benchmark\":\"" << r.name << "\""
+            << ",\"threads\":" << r.threads
+            << ",\"records\":" << r.records
+            << ",\"ops\":" << r.ops
+            << ",\"ns_per_op\":" << r.nsPerOp
+            << ",\"allocs_per_op\":" << r.allocsPerOp
+            << ",\"heap_delta_kb\":" << r.heapDeltaKb
+            << ",\"rss_delta_kb\":" << r.rssDeltaKb << "}\n";
+    }
+}
+
+// Powers of two below the hardware thread count, then that count
+std::vector<size_t> defaultThreadCounts() {
+    const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> counts;
+    for (size_t count = 1; count < hardware; count *= 2) counts.push_back(count);
+    counts.push_back(hardware);
+    return counts;
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) sizes.push_back(std::stoull(item));
+    }
+    return sizes;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = {1000, 100000, 10000000};
+    std::string jsonFile;
+    std::string dir = ".";
+    std::vector<size_t> threadCounts = defaultThreadCounts();
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonFile = argv[++i];
+        } else if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threadCounts = parseSizes(argv[++i]);
+        } else if (arg == "--no-metrics") {
+            OperationMetrics::setEnabled(false);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--sizes 1000,100000] [--json file] [--dir path]"
+                         " [--threads 1,2,4] [--no-metrics]\n";
+            return 2;
+        }
+    }
+
+    // returnBook reports reservation hand-overs on stdout; keep stdout for JSON only
+    std::ostringstream discarded;
+    std::streambuf* original = std::cout.rdbuf(discarded.rdbuf());
+    for (size_t n : sizes) {
+        runSuite(n, dir, threadCounts);
+        discarded.str("");
+    }
+    std::cout.rdbuf(original);
+    std::cerr << "\n";
+    MemoryTracker::writeReport(std::cerr);
+
+    if (jsonFile.empty()) {
+        writeJson(std::cout);
+    } else {
+        std::ofstream out(jsonFile);
+        writeJson(out);
+    }
+    return failedChecks == 0 ? 0 : 1;
+}
@@ -4,15 +4,49 @@
 #include <limits>
 #include <iomanip>
 #include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <random>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
 #include "Core Classes/Book.h"
 #include "Core Classes/User.h"
 #include "Core Classes/LoanManager.h"
+#include "Core Classes/BookSearch.h"
+#include "Core Classes/CatalogIndex.h"
+#include "Core Classes/IdAllocator.h"
+#include "Core Classes/SlotMap.h"
 #include "Utils/ini/GlobalConfiguration.h"
 #include "Utils/ini/ConfigManager.h"
+#include "Utils/ini/ConfigWatcher.h"
 #include "Utils/csv/CSVStorageManager.h"
+#include "Utils/archive/TransactionArchive.h"
 #include "Utils/InputValidator.h"
+#include "Utils/concurrency/ThreadPool.h"
+#include "Utils/metrics/LatencyHistogram.h"
+#include "Utils/metrics/Tracer.h"
+#include "Utils/metrics/MemoryTracker.h"
+#include "Utils/analytics/PopularityTracker.h"
+#include "Utils/analytics/CirculationCube.h"
+#include "Utils/analytics/BorrowerSketches.h"
+#include "Utils/analytics/CoBorrowingModel.h"
+#include "Utils/analytics/DayNumber.h"
+#include "Utils/batch/BatchScript.h"
+#include "Utils/report/ReportWriter.h"
+#include "Utils/rpc/Json.h"
 #ifdef _WIN32
 #include <direct.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 class LibrarySystem {
@@ -24,7 +58,104 @@ private:
     std::string usersCSVFile = "database/users.csv";
     std::string booksCSVFile = "database/books.csv";
     std::string transactionsCSVFile = "database/transactions.csv";
+    std::string transactionsArchiveFile = "database/transactions.archive";
+    std::string coldLoansFile = "database/transactions_cold.bin";
+    std::string coldLoansIndexFile = "database/transactions_cold.idx";
     std::string reservationsCSVFile = "database/reservations.csv";
+    std::string latencyMetricsFile = "database/latency_metrics"; // .txt and .json
+    std::string traceFile = "database/trace.json";
+    std::string memoryUsageFile = "database/memory_usage.txt";
+    std::string borrowerSketchesFile = "database/borrower_sketches.bin";
+    std::string idsCSVFile = "database/ids.csv";
+    ConfigWatcher configWatcher;
+    PopularityTracker popularity;
+    CirculationCube circulation;
+    BorrowerSketches borrowers;
+    CoBorrowingModel coBorrowing;
+    CatalogIndex catalog;
+    IdAllocator ids;
+    SlotMap<Book> bookSlots;        // id -> book, kept in step with books
+    SlotMap<User> userSlots;        // id -> user, kept in step with users
+
+    // Startup phase timings (filled concurrently by the load tasks)
+    std::vector<std::pair<std::string, double>> startupPhases;
+    std::mutex startupPhasesMutex;
+
+    // The span is recorded after the phase, so the config phase itself is
+    // traced even though it is the one that turns tracing on
+    template <typename Fn>
+    void timedPhase(const char* name, Fn fn) {
+        uint64_t start = Tracer::nowNs();
+        fn();
+        uint64_t elapsed = Tracer::nowNs() - start;
+        if (Tracer::isEnabled()) Tracer::record(name, start, elapsed);
+        std::lock_guard<std::mutex> lock(startupPhasesMutex);
+        startupPhases.emplace_back(name, elapsed / 1e6);
+    }
+
+    // On stderr, so the output of --batch scripts and --rpc stays clean
+    void printStartupPhases(double totalMs) const {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2);
+        for (const auto& [name, ms] : startupPhases) {
+            out << "[startup] " << std::left << std::setw(28) << name << std::right << std::setw(10) << ms << " ms\n";
+        }
+        out << "[startup] " << std::left << std::setw(28) << "total (wall)" << std::right
+            << std::setw(10) << totalMs << " ms\n";
+        std::cerr << out.str() << std::flush;
+    }
+
+    // Fills an id -> object map from a loaded file. Earlier versions could give
+    // two entities the same id; the first keeps it and the rest are reported
+    template <typename T, typename IdOf>
+    static void indexLoaded(const std::vector<std::unique_ptr<T>>& objects, SlotMap<T>& slots, IdOf idOf,
+                            const char* kind) {
+        slots.clear();
+        int maxId = 0;
+        for (const auto& object : objects) maxId = std::max(maxId, ((*object).*idOf)());
+        slots.reserve(maxId, objects.size());
+        for (const auto& object : objects) {
+            if (!slots.insert(((*object).*idOf)(), object.get())) {
+                std::cerr << "Warning: " << kind << " id " << ((*object).*idOf)()
+                          << " is duplicated or invalid; only its first entry can be looked up by id\n";
+            }
+        }
+    }
+
+    // The transactions are read from whichever of the CSV and the archive was
+    // saved last, so switching transactions_format loses nothing; on a tie the
+    // configured format wins. A damaged archive falls back to the CSV.
+    void loadTransactions() {
+        namespace fs = std::filesystem;
+        std::error_code csvError, archiveError;
+        const auto csvTime = fs::last_write_time(transactionsCSVFile, csvError);
+        const auto archiveTime = fs::last_write_time(transactionsArchiveFile, archiveError);
+        bool useArchive = !archiveError;
+        if (useArchive && !csvError && csvTime != archiveTime) useArchive = archiveTime > csvTime;
+        else if (useArchive && !csvError) useArchive = config()->transactions_format == "archive";
+
+        if (useArchive) {
+            TransactionArchive archive;
+            std::string error;
+            if (archive.open(transactionsArchiveFile, &error) &&
+                archive.readAll(loanManager->getTransactions(), &error)) {
+                return;
+            }
+            std::cerr << "Warning: cannot read " << transactionsArchiveFile << " (" << error
+                      << "); loading " << transactionsCSVFile << " instead\n";
+        }
+        CSVStorageManager::checkOrCreateCSVFile(transactionsCSVFile, CSVStorageManager::transactionsHeader);
+        loanManager->getTransactions() = CSVStorageManager::loadLoanTransactions(transactionsCSVFile);
+    }
+
+    void saveTransactions() {
+        if (config()->transactions_format == "archive") {
+            if (TransactionArchive::write(transactionsArchiveFile, loanManager->getTransactions())) return;
+            std::cerr << "Warning: cannot write " << transactionsArchiveFile << "; saving "
+                      << transactionsCSVFile << " instead\n";
+        }
+        CSVStorageManager::saveLoanTransactions(loanManager->getTransactions(), transactionsCSVFile);
+    }
 
     // Helper functions
     void clearScreen() {
@@ -42,6 +173,31 @@ private:
         std::cin.get();
     }
 
+    // Shows a listing page_size rows at a time; Enter shows the next page and q stops
+    template <typename FetchPage, typename RenderRow>
+    void showPaged(const std::vector<ReportColumn>& columns, const char* rowEnd, FetchPage fetchPage,
+                   RenderRow renderRow, const char* emptyMessage) {
+        PageCursor cursor;
+        size_t shown = 0;
+        while (true) {
+            auto page = fetchPage(cursor, static_cast<size_t>(std::max(1, config()->page_size)));
+            {
+                ReportWriter out(1, ReportFormat::Text, columns, rowEnd);
+                for (const auto& item : page.items) {
+                    renderRow(out, item);
+                    out.endRow();
+                }
+            }
+            shown += page.items.size();
+            if (!page.more) break;
+            std::cout << "-- " << shown << " shown; Enter for more, q to stop: " << std::flush;
+            std::string answer;
+            if (!std::getline(std::cin, answer) || answer == "q" || answer == "Q") break;
+            cursor = page.next;
+        }
+        if (shown == 0) std::cout << emptyMessage;
+    }
+
     void displayHeader(const std::string& title) {
         clearScreen();
         std::cout << "\n" << std::string(50, '=') << std::endl;
@@ -115,10 +271,12 @@ private:
                      << "\n9. Generate Reports"
                      << "\n10. System Settings"
                      << "\n11. Register New Librarian"
-                     << "\n12. Logout"
+                     << "\n12. Diagnostics"
+                     << "\n13. Circulation Analytics"
+                     << "\n14. Logout"
                      << "\n\n";
 
-            int choice = InputValidator::getInt("Choice: ", 1, 12);
+            int choice = InputValidator::getInt("Choice: ", 1, 14);
 
             switch (choice) {
                 case 1: addBook(); break;
@@ -132,7 +290,9 @@ private:
                 case 9: generateReports(); break;
                 case 10: systemSettings(); break;
                 case 11: handleLibrarianRegistration(); break;
-                case 12: return;
+                case 12: diagnostics(); break;
+                case 13: circulationAnalytics(); break;
+                case 14: return;
                 default: std::cout << "Invalid choice. Please try again.\n";
             }
             waitForKey();
@@ -157,8 +317,8 @@ private:
         std::cout << "Password: ";
         std::getline(std::cin, password);
 
-        int newId = users.size() + 1;
-        users.push_back(std::make_unique<Librarian>(newId, username, password));
+        ScopedMemoryTag tag(MemorySubsystem::Users);
+        addUser(std::make_unique<Librarian>(ids.allocate(IdKind::User), username, password));
         std::cout << "\nLibrarian registered successfully!\n";
         waitForKey();
     }
@@ -176,7 +336,7 @@ private:
         for (const auto& user : users) {
             if (user->getUsername() == username && user->authenticate(password)) {
                 currentUser = user.get();
-                if (dynamic_cast<Librarian*>(currentUser)) {
+                if (currentUser->usesLibrarianMenu()) {
                     showLibrarianMenu();
                 } else {
                     showUserMenu();
@@ -208,14 +368,29 @@ private:
         std::cout << "Password: ";
         std::getline(std::cin, password);
 
-        int newId = users.size() + 1;
-        users.push_back(std::make_unique<RegularUser>(newId, username, password));
+        ScopedMemoryTag tag(MemorySubsystem::Users);
+        addUser(std::make_unique<RegularUser>(ids.allocate(IdKind::User), username, password));
         std::cout << "\nUser registered successfully!\n";
         waitForKey();
     }
 
+    void addUser(std::unique_ptr<User> user) {
+        ids.observe(IdKind::User, user->getUserId());
+        userSlots.insert(user->getUserId(), user.get());
+        users.push_back(std::move(user));
+    }
+
+    // Files the book just appended to books
+    void indexNewBook() {
+        Book* book = books.back().get();
+        ids.observe(IdKind::Book, book->getId());
+        bookSlots.insert(book->getId(), book);
+        catalog.add(book);
+    }
+
     // Book management functions
     void addBook() {
+        ScopedMemoryTag tag(MemorySubsystem::Catalog);
         displayHeader("Add New Book");
         std::cout << "\nSelect book type:"
                  << "\n1. TextBook"
@@ -244,7 +419,8 @@ private:
         std::cin >> pageCount;
         std::cin.ignore();
 
-        int id = books.size() + 1; // Simple ID generation
+        // Taken only once the book is added, so a bad type wastes no id
+        int id = ids.peek(IdKind::Book);
 
         switch (choice) {
             case 1: {
@@ -274,38 +450,44 @@ private:
                 std::cout << "Invalid book type selected.\n";
                 return;
         }
+        indexNewBook();
 
         std::cout << "\nBook added successfully!\n";
     }
 
-    void viewAllBooks() {
-        displayHeader("All Books");
-        if (books.empty()) {
-            std::cout << "\nNo books in the library.\n";
-            return;
-        }
-
+    // Text rows are followed by a rule line, as in the other book listings
+    void listBooks(ReportFormat format, bool availableOnly) const {
+        static const std::string rowEnd = "\n" + std::string(50, '-') + "\n";
+        ReportWriter out(1, format, Book::reportColumns(), rowEnd.c_str());
         for (const auto& book : books) {
-            book->printInfo();
-            std::cout << std::string(50, '-') << std::endl;
+            if (availableOnly && book->getStatus() != BookStatus::Available) continue;
+            book->render(out);
+            out.endRow();
+        }
+        if (out.getRowCount() == 0) {
+            out.text(availableOnly ? "\nNo available books found.\n" : "\nNo books in the library.\n");
         }
     }
 
+    void showBookPages(bool availableOnly) {
+        static const std::string rowEnd = "\n" + std::string(50, '-') + "\n";
+        showPaged(Book::reportColumns(), rowEnd.c_str(),
+            [&](const PageCursor& after, size_t limit) {
+                return availableOnly ? catalog.pageByStatus(BookStatus::Available, after, limit)
+                                     : catalog.page(after, limit);
+            },
+            [](ReportWriter& out, const Book* book) { book->render(out); },
+            availableOnly ? "\nNo available books found.\n" : "\nNo books in the library.\n");
+    }
+
+    void viewAllBooks() {
+        displayHeader("All Books");
+        showBookPages(false);
+    }
+
     void viewAvailableBooks() {
         displayHeader("Available Books");
-        bool found = false;
-        
-        for (const auto& book : books) {
-            if (book->getStatus() == BookStatus::Available) {
-                book->printInfo();
-                std::cout << std::string(50, '-') << std::endl;
-                found = true;
-            }
-        }
-
-        if (!found) {
-            std::cout << "\nNo available books found.\n";
-        }
+        showBookPages(true);
     }
 
     void searchBooks() {
@@ -323,27 +505,54 @@ private:
         std::cout << "Enter search term: ";
         std::getline(std::cin, searchTerm);
 
-        bool found = false;
-        for (const auto& book : books) {
-            bool match = false;
-            switch (choice) {
-                case 1: match = (book->getTitle().find(searchTerm) != std::string::npos); break;
-                case 2: match = (book->getAuthor().find(searchTerm) != std::string::npos); break;
-                case 3: match = (book->getCategory().find(searchTerm) != std::string::npos); break;
-            }
-            if (match) {
-                book->printInfo();
-                std::cout << std::string(50, '-') << std::endl;
-                found = true;
-            }
+        std::vector<Book*> results;
+        switch (choice) {
+            case 1: results = BookSearch::search(books, BookSearch::Field::Title, searchTerm); break;
+            case 2: results = BookSearch::search(books, BookSearch::Field::Author, searchTerm); break;
+            case 3: results = BookSearch::search(books, BookSearch::Field::Category, searchTerm); break;
         }
 
-        if (!found) {
+        printWithRecommendations(std::vector<const Book*>(results.begin(), results.end()));
+
+        if (results.empty()) {
             std::cout << "\nNo matching books found.\n";
         }
     }
 
+    // printInfo for each book, followed by its "also borrowed" neighbors
+    void printWithRecommendations(const std::vector<const Book*>& shown) {
+        const size_t count = 3;
+        std::vector<std::vector<BookNeighbor>> neighbors;
+        std::unordered_set<int> ids;
+        for (const Book* book : shown) {
+            neighbors.push_back(coBorrowing.neighbors(book->getId(), count));
+            for (const auto& neighbor : neighbors.back()) ids.insert(neighbor.bookId);
+        }
+
+        // One pass over the catalog for the titles
+        std::unordered_map<int, std::string> titles;
+        if (!ids.empty()) {
+            for (const auto& book : books) {
+                if (ids.count(book->getId())) titles[book->getId()] = book->getTitle();
+            }
+        }
+
+        for (size_t i = 0; i < shown.size(); ++i) {
+            shown[i]->printInfo();
+            if (!neighbors[i].empty()) {
+                std::cout << "  Patrons who borrowed this also borrowed: ";
+                for (size_t j = 0; j < neighbors[i].size(); ++j) {
+                    const BookNeighbor& neighbor = neighbors[i][j];
+                    std::cout << (j ? "; " : "") << titles[neighbor.bookId] << " (ID " << neighbor.bookId << ")";
+                }
+                std::cout << "\n";
+            }
+            std::cout << std::string(50, '-') << std::endl;
+        }
+    }
+
     void editBook() {
+        ScopedMemoryTag tag(MemorySubsystem::Catalog);
         displayHeader("Edit Book");
         viewAllBooks();
         
@@ -354,16 +563,14 @@ private:
 
         if (id == 0) return;
 
-        auto it = std::find_if(books.begin(), books.end(),
-            [id](const auto& book) { return book->getId() == id; });
-
-        if (it == books.end()) {
+        Book* book = bookSlots.find(id);
+        if (!book) {
             std::cout << "Book not found.\n";
             return;
         }
 
         std::cout << "\nCurrent book details:\n";
-        (*it)->printInfo();
+        printWithRecommendations({book});
 
         std::cout << "\nWhat would you like to edit?"
                  << "\n1. Title"
@@ -384,28 +591,28 @@ private:
             case 1:
                 std::cout << "New title: ";
                 std::getline(std::cin, newValue);
-                (*it)->setTitle(newValue);
+                book->setTitle(newValue);
                 break;
             case 2:
                 std::cout << "New author: ";
                 std::getline(std::cin, newValue);
-                (*it)->setAuthor(newValue);
+                book->setAuthor(newValue);
                 break;
             case 3:
                 std::cout << "New category: ";
                 std::getline(std::cin, newValue);
-                (*it)->setCategory(newValue);
+                book->setCategory(newValue);
                 break;
             case 4:
                 std::cout << "New publication date (YYYY-MM-DD): ";
                 std::getline(std::cin, newValue);
-                (*it)->setPublicationDate(newValue);
+                book->setPublicationDate(newValue);
                 break;
             case 5:
                 int newPages;
                 std::cout << "New page count: ";
                 std::cin >> newPages;
-                (*it)->setPageCount(newPages);
+                book->setPageCount(newPages);
                 break;
             case 6:
                 std::cout << "New status:"
@@ -417,12 +624,13 @@ private:
                 int statusChoice;
                 std::cin >> statusChoice;
                 switch (statusChoice) {
-                    case 1: (*it)->setStatus(BookStatus::Available); break;
-                    case 2: (*it)->setStatus(BookStatus::Borrowed); break;
-                    case 3: (*it)->setStatus(BookStatus::Reserved); break;
-                    case 4: (*it)->setStatus(BookStatus::Lost); break;
+                    case 1: book->setStatus(BookStatus::Available); break;
+                    case 2: book->setStatus(BookStatus::Borrowed); break;
+                    case 3: book->setStatus(BookStatus::Reserved); break;
+                    case 4: book->setStatus(BookStatus::Lost); break;
                     default: std::cout << "Invalid status choice.\n"; return;
                 }
+                catalog.update(book);
                 break;
             case 0:
                 return;
@@ -445,15 +653,16 @@ private:
 
         if (id == 0) return;
 
-        auto it = std::find_if(books.begin(), books.end(),
-            [id](const auto& book) { return book->getId() == id; });
-
-        if (it == books.end()) {
+        if (!bookSlots.find(id)) {
             std::cout << "Book not found.\n";
             return;
         }
 
-        books.erase(it);
+        // Other books keep their ids and slots; this id is never handed out again
+        catalog.remove(id);
+        bookSlots.erase(id);
+        books.erase(std::find_if(books.begin(), books.end(),
+            [id](const auto& book) { return book->getId() == id; }));
         std::cout << "\nBook removed successfully!\n";
     }
 
@@ -468,15 +677,13 @@ private:
 
         if (id == 0) return;
 
-        auto it = std::find_if(books.begin(), books.end(),
-            [id](const auto& book) { return book->getId() == id; });
-
-        if (it == books.end()) {
+        Book* book = bookSlots.find(id);
+        if (!book) {
             std::cout << "Book not found.\n";
             return;
         }
 
-        if (loanManager->borrowBook(currentUser, it->get())) {
+        if (loanManager->borrowBook(currentUser, book)) {
             std::cout << "\nBook borrowed successfully!\n";
         } else {
             std::cout << "\nCould not borrow book. Please check your borrowing limits or book availability.\n";
@@ -508,15 +715,13 @@ private:
 
         if (id == 0) return;
 
-        auto it = std::find_if(books.begin(), books.end(),
-            [id](const auto& book) { return book->getId() == id; });
-
-        if (it == books.end()) {
+        Book* book = bookSlots.find(id);
+        if (!book) {
             std::cout << "Book not found.\n";
             return;
         }
 
-        if (loanManager->returnBook(currentUser, it->get())) {
+        if (loanManager->returnBook(currentUser, book)) {
             std::cout << "\nBook returned successfully!\n";
         } else {
             std::cout << "\nCould not return book. Please check if you actually borrowed this book.\n";
@@ -547,15 +752,13 @@ private:
 
         if (id == 0) return;
 
-        auto it = std::find_if(books.begin(), books.end(),
-            [id](const auto& book) { return book->getId() == id; });
-
-        if (it == books.end()) {
+        Book* book = bookSlots.find(id);
+        if (!book) {
             std::cout << "Book not found.\n";
             return;
         }
 
-        if (loanManager->reserveBook(currentUser, it->get())) {
+        if (loanManager->reserveBook(currentUser, book)) {
             std::cout << "\nBook reserved successfully!\n";
         } else {
             std::cout << "\nCould not reserve book. The book might not be available for reservation.\n";
@@ -574,7 +777,12 @@ private:
 
     void viewMyFines() {
         displayHeader("My Fines");
+        if (!loanManager->accrueUserFines(currentUser)) loanManager->accrueFines(books, users);
         std::cout << "Your current fines: $" << currentUser->getTotalFines() << std::endl;
+        if (currentUser->getAccruedFines() > 0) {
+            std::cout << "Accruing on overdue loans: $" << currentUser->getAccruedFines()
+                      << " (charged when the books are returned)" << std::endl;
+        }
     }
 
     void manageUsers() {
@@ -588,12 +796,20 @@ private:
 
     void viewAllLoans() {
         displayHeader("All Loans");
-        loanManager->printAllLoans();
+        std::cout << "\n=== All Current Loans (soonest due first) ===\n";
+        showPaged(LoanManager::loanReportColumns(), "\n",
+            [this](const PageCursor& after, size_t limit) { return loanManager->loansPage(after, limit); },
+            [this](ReportWriter& out, const LoanTransaction* loan) { loanManager->renderLoan(out, *loan); },
+            "No current loans.\n");
     }
 
     void viewAllReservations() {
         displayHeader("All Reservations");
-        loanManager->printAllReservations();
+        std::cout << "\n=== All Current Reservations ===\n";
+        showPaged(LoanManager::reservationReportColumns(), "\n",
+            [this](const PageCursor& after, size_t limit) { return loanManager->reservationsPage(after, limit); },
+            [](ReportWriter& out, const ReservationEntry& entry) { LoanManager::renderReservation(out, entry); },
+            "No current reservations.\n");
     }
 
     void manageFines() {
@@ -607,15 +823,15 @@ private:
 
         if (userId == 0) return;
 
-        auto it = std::find_if(users.begin(), users.end(),
-            [userId](const auto& user) { return user->getUserId() == userId; });
-
-        if (it == users.end()) {
+        User* user = userSlots.find(userId);
+        if (!user) {
             std::cout << "User not found.\n";
             return;
         }
 
-        std::cout << "Current fines: $" << (*it)->getTotalFines() << std::endl;
+        if (!loanManager->accrueUserFines(user)) loanManager->accrueFines(books, users);
+        std::cout << "Current fines: $" << user->getTotalFines()
+                  << " (plus $" << user->getAccruedFines() << " accruing on overdue loans)" << std::endl;
         
         double amount;
         std::cout << "Enter amount to waive (0 to cancel): $";
@@ -623,31 +839,271 @@ private:
 
         if (amount <= 0) return;
 
-        if (loanManager->payFine(it->get(), amount)) {
+        if (loanManager->payFine(user, amount)) {
             std::cout << "\nFines waived successfully!\n";
         } else {
             std::cout << "\nError waiving fines.\n";
         }
     }
 
+    void printLibraryStatistics(std::ostream& out) {
+        LoanStatistics stats = loanManager->getStatistics();
+        FineAccrualSummary accrued = loanManager->currentFineAccrual(books, users);
+        out << "\nLibrary Statistics:"
+            << "\n-------------------"
+            << "\nTotal books: " << books.size()
+            << "\nTotal users: " << users.size()
+            << "\nTotal loans: " << stats.totalLoans
+            << "\nActive loans: " << stats.activeLoans
+            << "\nOverdue books: " << stats.overdueCount
+            << "\nTotal fines: $" << stats.totalFines
+            << "\nFines accruing on overdue loans: $" << accrued.accruedTotal
+            << " (" << accrued.overdueLoans << " loans; the last full pass took " << accrued.elapsedMs << " ms)\n";
+        if (config()->check_statistics) {
+            if (loanManager->checkStatistics(out)) {
+                out << "(counters match a full recount)\n";
+            }
+        }
+    }
+
     void generateReports() {
         displayHeader("Generate Reports");
-        
-        std::cout << "\nLibrary Statistics:"
-                 << "\n-------------------"
-                 << "\nTotal books: " << books.size()
-                 << "\nTotal users: " << users.size()
-                 << "\nTotal loans: " << loanManager->getTotalLoans()
-                 << "\nActive loans: " << loanManager->getActiveLoans()
-                 << "\nOverdue books: " << loanManager->getOverdueCount()
-                 << "\nTotal fines: $" << loanManager->getTotalFines()
-                 << std::endl;
+        printLibraryStatistics(std::cout);
+        std::cout << std::flush;
 
         std::cout << "\nOverdue Books:\n";
         loanManager->printOverdueBooks();
 
         std::cout << "\nMost Popular Books:\n";
-        // TODO: Implement most popular books report
+        printMostPopular();
+
+        std::cout << "\nDistinct Borrowers (estimated):\n";
+        printDistinctBorrowers();
+
+        std::cout << "\nOperation Latencies:\n";
+        OperationMetrics::writeText(std::cout);
+        if (OperationMetrics::dump(latencyMetricsFile)) {
+            std::cout << "(saved to " << latencyMetricsFile << ".txt/.json)\n";
+        }
+    }
+
+    void diagnostics() {
+        displayHeader("Diagnostics");
+        std::cout << "\nTracing: " << (Tracer::isEnabled() ? "on" : "off")
+                 << " (" << Tracer::spanCount() << " spans buffered)"
+                 << "\n\n1. Toggle Tracing"
+                 << "\n2. Write Trace File (" << traceFile << ")"
+                 << "\n3. Memory Usage"
+                 << "\n4. Check Statistics Consistency"
+                 << "\n5. Check Distinct-Borrower Sketches"
+                 << "\n6. Return to Main Menu"
+                 << "\n\nChoice: ";
+
+        int choice;
+        std::cin >> choice;
+        std::cin.ignore();
+
+        switch (choice) {
+            case 1: {
+                ConfigSnapshot settings = *config();
+                settings.tracing_enabled = !Tracer::isEnabled();
+                Tracer::setEnabled(settings.tracing_enabled);
+                ConfigManager::saveConfig(settings);
+                std::cout << "Tracing " << (settings.tracing_enabled ? "enabled" : "disabled") << ".\n";
+                break;
+            }
+            case 2:
+                if (Tracer::writeChromeTrace(traceFile)) {
+                    std::cout << "Trace written to " << traceFile << " (open it in chrome://tracing or Perfetto).\n";
+                } else {
+                    std::cout << "Could not write " << traceFile << ".\n";
+                }
+                break;
+            case 3:
+                std::cout << "\n";
+                MemoryTracker::writeReport(std::cout);
+                {
+                    const LoanHistoryTree::CacheStats cache = loanManager->getColdIndexCacheStats();
+                    std::cout << "History index cache: " << cache.pages << "/" << cache.capacity << " pages, "
+                              << cache.hits << " hits, " << cache.misses << " misses\n";
+                }
+                if (MemoryTracker::dump(memoryUsageFile)) {
+                    std::cout << "(saved to " << memoryUsageFile << ")\n";
+                }
+                break;
+            case 4:
+                if (loanManager->checkStatistics(std::cout)) {
+                    std::cout << "Statistics counters match a full recount.\n";
+                }
+                break;
+            case 5: {
+                std::cout << "\n";
+                std::vector<LoanTransaction> coldCopies;
+                if (borrowers.crossCheck(loanManager->fullHistory(coldCopies), books, std::cout)) {
+                    std::cout << "Sketches are within tolerance of the exact counts.\n";
+                }
+                break;
+            }
+            case 6:
+                return;
+            default:
+                std::cout << "Invalid choice.\n";
+                break;
+        }
+    }
+
+    void buildAnalytics() {
+        auto findBook = [this](int id) -> const Book* { return bookSlots.find(id); };
+        // Built from both history tiers; the decoded cold loans are dropped afterwards
+        std::vector<LoanTransaction> coldCopies;
+        const LoanHistory history = loanManager->fullHistory(coldCopies);
+        // The analytics are independent, so they are built side by side
+        TaskGroup builds;
+        builds.run([&] { popularity.rebuild(history, findBook); });
+        builds.run([&] { circulation.rebuild(history, books); });
+        builds.run([&] {
+            // Saved sketches only need the loans made since they were written
+            if (!borrowers.load(borrowerSketchesFile, history, books)) {
+                borrowers.rebuild(history, books);
+            }
+        });
+        builds.run([&] { coBorrowing.rebuild(history); });
+        builds.wait();
+        loanManager->addListener(&popularity);
+        loanManager->addListener(&circulation);
+        loanManager->addListener(&borrowers);
+        loanManager->addListener(&coBorrowing);
+    }
+
+    void circulationAnalytics() {
+        displayHeader("Circulation Analytics");
+        const int today = todayDayNumber();
+
+        std::string from, to, category;
+        std::cout << "\nFrom date (YYYY-MM-DD, empty = one year ago): ";
+        std::getline(std::cin, from);
+        std::cout << "To date (YYYY-MM-DD, empty = today): ";
+        std::getline(std::cin, to);
+
+        CubeQuery query;
+        query.fromDay = from.empty() ? today - 364 : dayNumber(from);
+        query.toDay = to.empty() ? today : dayNumber(to);
+        if (query.fromDay == kInvalidDay || query.toDay == kInvalidDay) {
+            std::cout << "\nInvalid date.\n";
+            return;
+        }
+
+        std::cout << "\nGranularity:\n1. Day\n2. Week\n3. Month\n";
+        int granularity = InputValidator::getInt("Choice: ", 1, 3);
+        query.granularity = granularity == 1 ? CubeGranularity::Day
+                          : granularity == 2 ? CubeGranularity::Week : CubeGranularity::Month;
+
+        std::cout << "\nGroup by:\n1. Nothing\n2. Category\n3. Book type\n4. Category and book type\n";
+        int grouping = InputValidator::getInt("Choice: ", 1, 4);
+        query.groupByCategory = grouping == 2 || grouping == 4;
+        query.groupByType = grouping == 3 || grouping == 4;
+
+        std::cout << "Only category (empty = all): ";
+        std::getline(std::cin, category);
+        if (!category.empty()) {
+            query.category = circulation.findCategory(category);
+            if (query.category < 0) {
+                std::cout << "\nNo loans in category " << category << ".\n";
+                return;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<CubeRow> rows = circulation.query(query);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "\n" << std::left << std::setw(12) << "Period"
+                  << std::setw(18) << "Category" << std::setw(15) << "Type" << std::right
+                  << std::setw(9) << "Loans" << std::setw(9) << "Returns"
+                  << std::setw(9) << "Overdue" << std::setw(12) << "Fines" << "\n";
+        CirculationMeasures total;
+        for (const CubeRow& row : rows) {
+            std::cout << std::left << std::setw(12) << dateFromDayNumber(row.periodStart)
+                      << std::setw(18) << (row.category < 0 ? "*" : circulation.categoryName(row.category))
+                      << std::setw(15) << (row.bookType < 0 ? "*" : circulation.typeName(row.bookType)) << std::right
+                      << std::setw(9) << row.measures.loans << std::setw(9) << row.measures.returns
+                      << std::setw(9) << row.measures.overdueReturns
+                      << std::setw(12) << std::fixed << std::setprecision(2) << row.measures.fines << "\n";
+            std::cout.unsetf(std::ios::floatfield);
+            total += row.measures;
+        }
+        std::cout << "\nTotal: " << total.loans << " loans, " << total.returns << " returns, "
+                  << total.overdueReturns << " overdue returns, $" << std::fixed << std::setprecision(2)
+                  << total.fines << " fines" << "\n(" << rows.size() << " rows in " << elapsed.count() << " ms)\n";
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    void printMostPopular() {
+        const size_t count = 5;
+        const PopularityWindow windows[] = {PopularityWindow::Last30Days, PopularityWindow::Last90Days,
+                                            PopularityWindow::Last365Days, PopularityWindow::AllTime};
+        std::vector<std::pair<PopularityWindow, std::vector<PopularityEntry>>> topBooks;
+        std::unordered_set<int> ids;
+        for (PopularityWindow window : windows) {
+            topBooks.emplace_back(window, popularity.top(PopularityDimension::Book, window, count));
+            for (const auto& entry : topBooks.back().second) ids.insert(entry.id);
+        }
+
+        // One pass over the catalog for the titles
+        std::unordered_map<int, std::string> titles;
+        for (const auto& book : books) {
+            if (ids.count(book->getId())) titles[book->getId()] = book->getTitle();
+        }
+
+        for (const auto& [window, entries] : topBooks) {
+            std::cout << PopularityTracker::windowName(window) << ":\n";
+            if (entries.empty()) std::cout << "  No loans.\n";
+            int rank = 1;
+            for (const auto& entry : entries) {
+                std::cout << "  " << rank++ << ". " << titles[entry.id] << " (ID " << entry.id << ") - "
+                          << entry.borrows << " loans\n";
+            }
+        }
+
+        const std::pair<PopularityDimension, const char*> groups[] = {
+            {PopularityDimension::Category, "Top Categories"}, {PopularityDimension::Author, "Top Authors"}};
+        for (const auto& [dimension, title] : groups) {
+            std::cout << "\n" << title << " (last 365 days / all time):\n";
+            auto recent = popularity.top(dimension, PopularityWindow::Last365Days, count);
+            auto allTime = popularity.top(dimension, PopularityWindow::AllTime, count);
+            for (size_t i = 0; i < std::max(recent.size(), allTime.size()); ++i) {
+                std::cout << "  " << i + 1 << ". ";
+                std::string left = i < recent.size() ? recent[i].name + " (" + std::to_string(recent[i].borrows) + ")" : "-";
+                std::cout << std::left << std::setw(36) << left << std::right;
+                if (i < allTime.size()) std::cout << allTime[i].name << " (" << allTime[i].borrows << ")";
+                std::cout << "\n";
+            }
+        }
+    }
+
+    void printDistinctBorrowers() const {
+        const int today = todayDayNumber();
+        std::vector<std::string> categories = borrowers.categories();
+        std::sort(categories.begin(), categories.end());
+        std::cout << "  " << std::left << std::setw(24) << "Category" << std::right
+                  << std::setw(16) << "Last 12 months" << std::setw(12) << "All time" << "\n";
+        std::cout << std::fixed << std::setprecision(0);
+        for (const auto& category : categories) {
+            std::cout << "  " << std::left << std::setw(24) << category << std::right
+                      << std::setw(16) << borrowers.category(category, today - 364, today)
+                      << std::setw(12) << borrowers.category(category, INT_MIN, INT_MAX) << "\n";
+        }
+        std::cout << "  " << std::left << std::setw(24) << "Whole catalog" << std::right
+                  << std::setw(16) << borrowers.catalog(today - 364, today)
+                  << std::setw(12) << borrowers.catalog(INT_MIN, INT_MAX) << "\n";
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
+    static void applyDiagnosticsConfig() {
+        const std::shared_ptr<const ConfigSnapshot> settings = config();
+        OperationMetrics::setEnabled(settings->latency_metrics_enabled);
+        Tracer::setEnabled(settings->tracing_enabled);
     }
 
     void systemSettings() {
@@ -666,14 +1122,15 @@ private:
 
         switch (choice) {
             case 1: {
-                std::cout << "Current fine rate per day: $" << daily_fine_rate << std::endl;
+                std::cout << "Current fine rate per day: $" << config()->daily_fine_rate << std::endl;
                 std::cout << "Enter new fine rate per day: $";
                 double newRate;
                 std::cin >> newRate;
                 std::cin.ignore();
                 if (newRate > 0) {
-                    daily_fine_rate = newRate;
-                    ConfigManager::saveConfig();
+                    ConfigSnapshot settings = *config();
+                    settings.daily_fine_rate = newRate;
+                    ConfigManager::saveConfig(settings);
                     std::cout << "Fine rate updated successfully.\n";
                 } else {
                     std::cout << "Invalid value. No changes made.\n";
@@ -681,14 +1138,15 @@ private:
                 break;
             }
             case 2: {
-                std::cout << "Current loan period (days): " << regular_user_loan_period << std::endl;
+                std::cout << "Current loan period (days): " << config()->regular_user_loan_period << std::endl;
                 std::cout << "Enter new loan period (days): ";
                 int newPeriod;
                 std::cin >> newPeriod;
                 std::cin.ignore();
                 if (newPeriod > 0) {
-                    regular_user_loan_period = newPeriod;
-                    ConfigManager::saveConfig();
+                    ConfigSnapshot settings = *config();
+                    settings.regular_user_loan_period = newPeriod;
+                    ConfigManager::saveConfig(settings);
                     std::cout << "Loan period updated successfully.\n";
                 } else {
                     std::cout << "Invalid value. No changes made.\n";
@@ -696,14 +1154,15 @@ private:
                 break;
             }
             case 3: {
-                std::cout << "Current max reservations per user: " << regular_user_borrow_limit << std::endl;
+                std::cout << "Current max reservations per user: " << config()->regular_user_borrow_limit << std::endl;
                 std::cout << "Enter new max reservations per user: ";
                 int newMax;
                 std::cin >> newMax;
                 std::cin.ignore();
                 if (newMax > 0) {
-                    regular_user_borrow_limit = newMax;
-                    ConfigManager::saveConfig();
+                    ConfigSnapshot settings = *config();
+                    settings.regular_user_borrow_limit = newMax;
+                    ConfigManager::saveConfig(settings);
                     std::cout << "Reservation limit updated successfully.\n";
                 } else {
                     std::cout << "Invalid value. No changes made.\n";
@@ -715,27 +1174,29 @@ private:
                 std::cout << "Feature not yet implemented.\n";
                 break;
             case 5: {
-                std::cout << "Current librarian borrow limit: " << librarian_borrow_limit << std::endl;
+                std::cout << "Current librarian borrow limit: " << config()->librarian_borrow_limit << std::endl;
                 std::cout << "Enter new librarian borrow limit: ";
                 int newLimit;
                 std::cin >> newLimit;
                 std::cin.ignore();
                 if (newLimit > 0) {
-                    librarian_borrow_limit = newLimit;
-                    ConfigManager::saveConfig();
+                    ConfigSnapshot settings = *config();
+                    settings.librarian_borrow_limit = newLimit;
+                    ConfigManager::saveConfig(settings);
                     std::cout << "Librarian borrow limit updated successfully.\n";
                 } else {
                     std::cout << "Invalid value. No changes made.\n";
                 }
 
-                std::cout << "Current librarian loan period (days): " << librarian_loan_period << std::endl;
+                std::cout << "Current librarian loan period (days): " << config()->librarian_loan_period << std::endl;
                 std::cout << "Enter new librarian loan period (days): ";
                 int newPeriod;
                 std::cin >> newPeriod;
                 std::cin.ignore();
                 if (newPeriod > 0) {
-                    librarian_loan_period = newPeriod;
-                    ConfigManager::saveConfig();
+                    ConfigSnapshot settings = *config();
+                    settings.librarian_loan_period = newPeriod;
+                    ConfigManager::saveConfig(settings);
                     std::cout << "Librarian loan period updated successfully.\n";
                 } else {
                     std::cout << "Invalid value. No changes made.\n";
@@ -750,50 +1211,672 @@ private:
         }
     }
 
+    // Batch mode: commands from a script run straight against the loaded
+    // library with no screens or prompts, and output is buffered
+    struct BatchContext {
+        std::ostringstream out;
+        std::unordered_map<std::string, User*> userByName;
+    };
+
+    struct BatchTally {
+        int ok = 0;
+        int failed = 0;
+    };
+
+    static bool parseBatchInt(const std::string& text, int& value) {
+        char* end = nullptr;
+        long parsed = std::strtol(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || parsed < std::numeric_limits<int>::min() ||
+            parsed > std::numeric_limits<int>::max()) {
+            return false;
+        }
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    // A user is named by user ID or username
+    User* findBatchUser(BatchContext& context, const std::string& name) const {
+        int id;
+        if (parseBatchInt(name, id)) {
+            if (User* user = userSlots.find(id)) return user;
+        }
+        auto it = context.userByName.find(name);
+        return it == context.userByName.end() ? nullptr : it->second;
+    }
+
+    Book* findBatchBook(const std::string& idText) const {
+        int id;
+        return parseBatchInt(idText, id) ? bookSlots.find(id) : nullptr;
+    }
+
+    // add-book <textbook|magazine|reference> <title> <author> <category> <YYYY-MM-DD> <pages>
+    //          [<academic level> <field> | <issue number>]
+    bool batchAddBook(BatchContext&, const BatchCommand& command, std::string& error) {
+        const std::vector<std::string>& args = command.args;
+        const size_t extra = args.empty() ? 0 : args[0] == "textbook" ? 2 : args[0] == "magazine" ? 1 : 0;
+        if (args.size() != 6 + extra) {
+            error = "usage: add-book <textbook|magazine|reference> <title> <author> <category> <date> <pages> "
+                    "[<academic level> <field> | <issue number>]";
+            return false;
+        }
+        int pageCount;
+        if (!parseBatchInt(args[5], pageCount) || pageCount <= 0) {
+            error = "bad page count '" + args[5] + "'";
+            return false;
+        }
+        if (dayNumber(args[4]) == kInvalidDay) {
+            error = "bad publication date '" + args[4] + "'";
+            return false;
+        }
+
+        ScopedMemoryTag tag(MemorySubsystem::Catalog);
+        const int id = ids.peek(IdKind::Book);
+        if (args[0] == "textbook") {
+            books.push_back(std::make_unique<TextBook>(id, args[1], args[2], args[3], args[4], pageCount,
+                                                       args[6], args[7]));
+        } else if (args[0] == "magazine") {
+            int issueNumber;
+            if (!parseBatchInt(args[6], issueNumber)) {
+                error = "bad issue number '" + args[6] + "'";
+                return false;
+            }
+            books.push_back(std::make_unique<Magazine>(id, args[1], args[2], args[3], args[4], pageCount,
+                                                       issueNumber));
+        } else if (args[0] == "reference") {
+            books.push_back(std::make_unique<ReferenceBook>(id, args[1], args[2], args[3], args[4], pageCount));
+        } else {
+            error = "unknown book type '" + args[0] + "'";
+            return false;
+        }
+        indexNewBook();
+        return true;
+    }
+
+    // borrow|return <user> <book ID>
+    bool batchLoan(BatchContext& context, const BatchCommand& command, std::string& error) {
+        if (command.args.size() != 2) {
+            error = "usage: " + command.name + " <user ID or username> <book ID>";
+            return false;
+        }
+        User* user = findBatchUser(context, command.args[0]);
+        Book* book = findBatchBook(command.args[1]);
+        if (!user || !book) {
+            error = !user ? "user '" + command.args[0] + "' not found" : "book '" + command.args[1] + "' not found";
+            return false;
+        }
+        if (command.name == "borrow") {
+            if (loanManager->borrowBook(user, book)) return true;
+            error = "cannot borrow (limits, fines or availability)";
+        } else {
+            if (loanManager->returnBook(user, book)) return true;
+            error = "no open loan of this book by this user";
+        }
+        return false;
+    }
+
+    // waive <user> <amount|all>
+    bool batchWaive(BatchContext& context, const BatchCommand& command, std::string& error) {
+        if (command.args.size() != 2) {
+            error = "usage: waive <user ID or username> <amount|all>";
+            return false;
+        }
+        User* user = findBatchUser(context, command.args[0]);
+        if (!user) {
+            error = "user '" + command.args[0] + "' not found";
+            return false;
+        }
+        double amount = user->getTotalFines();
+        if (command.args[1] != "all") {
+            char* end = nullptr;
+            amount = std::strtod(command.args[1].c_str(), &end);
+            if (command.args[1].empty() || *end != '\0' || amount <= 0) {
+                error = "bad amount '" + command.args[1] + "'";
+                return false;
+            }
+        }
+        return amount <= 0 || loanManager->payFine(user, amount); // waiving all of nothing is a no-op
+    }
+
+    // list <books|available|loans|overdue> [text|csv|jsonl]
+    bool batchList(BatchContext& context, const BatchCommand& command, std::string& error) {
+        ReportFormat format = ReportFormat::Text;
+        if (command.args.empty() || command.args.size() > 2 ||
+            (command.args.size() == 2 && !parseReportFormat(command.args[1], format))) {
+            error = "usage: list <books|available|loans|overdue> [text|csv|jsonl]";
+            return false;
+        }
+        // The listing writes to stdout directly, after what is buffered so far
+        std::cout << context.out.str();
+        context.out.str("");
+        const std::string& what = command.args[0];
+        if (what == "books" || what == "available") {
+            listBooks(format, what == "available");
+        } else if (what == "loans") {
+            loanManager->printAllLoans(format);
+        } else if (what == "overdue") {
+            loanManager->printOverdueBooks(format);
+        } else {
+            error = "unknown listing '" + what + "'";
+            return false;
+        }
+        return true;
+    }
+
+    // history <user> [text|csv|jsonl]
+    bool batchHistory(BatchContext& context, const BatchCommand& command, std::string& error) {
+        ReportFormat format = ReportFormat::Text;
+        if (command.args.empty() || command.args.size() > 2 ||
+            (command.args.size() == 2 && !parseReportFormat(command.args[1], format))) {
+            error = "usage: history <user ID or username> [text|csv|jsonl]";
+            return false;
+        }
+        User* user = findBatchUser(context, command.args[0]);
+        if (!user) {
+            error = "user '" + command.args[0] + "' not found";
+            return false;
+        }
+        std::cout << context.out.str();
+        context.out.str("");
+        loanManager->printTransactionHistory(user->getUserId(), format);
+        return true;
+    }
+
+    // RPC mode: one JSON request per line on stdin, one JSON response per
+    // line on stdout, for driving the library from another process.
+    //   {"id":1,"method":"login","params":{"username":"user1","password":"pass1"}}
+    //   {"id":1,"ok":true,"result":{"session":"5f0c...","user_id":1,"username":"user1","librarian":false}}
+    // Failures are {"id":1,"ok":false,"error":"..."}. Requests may be
+    // pipelined: they run in order, and the responses to everything read so
+    // far go out in one write before the next read.
+    struct RpcContext {
+        JsonDocument request;
+        std::string responses;
+        std::unordered_map<uint64_t, User*> sessions;
+        std::unordered_map<std::string, User*> userByName;
+        std::mt19937_64 random{std::random_device{}()};
+    };
+
+    static User* rpcSessionUser(RpcContext& rpc, const JsonDocument::Node* params, std::string& error) {
+        std::string_view token;
+        uint64_t id = 0;
+        if (params && JsonDocument::toString(rpc.request.find(*params, "session"), token) && token.size() == 16) {
+            auto parsed = std::from_chars(token.data(), token.data() + token.size(), id, 16);
+            if (parsed.ec == std::errc() && parsed.ptr == token.data() + token.size()) {
+                auto it = rpc.sessions.find(id);
+                if (it != rpc.sessions.end()) return it->second;
+            }
+        }
+        error = "not logged in (missing or unknown session)";
+        return nullptr;
+    }
+
+    Book* rpcBook(RpcContext& rpc, const JsonDocument::Node* params, std::string& error) const {
+        long long id;
+        if (!params || !JsonDocument::toInt(rpc.request.find(*params, "book_id"), id)) {
+            error = "book_id must be a number";
+            return nullptr;
+        }
+        Book* book = id > 0 && id <= std::numeric_limits<int>::max() ? bookSlots.find(static_cast<int>(id)) : nullptr;
+        if (!book) error = "book not found";
+        return book;
+    }
+
+    static void writeBookJson(JsonWriter& json, const Book& book) {
+        json.beginObject()
+            .key("id").value(book.getId())
+            .key("type").value(book.getType())
+            .key("title").value(book.getTitle())
+            .key("author").value(book.getAuthor())
+            .key("category").value(book.getCategory())
+            .key("published").value(book.getPublicationDate())
+            .key("pages").value(book.getPageCount())
+            .key("status").value(bookStatusName(book.getStatus()))
+            .endObject();
+    }
+
+    // Writes the result value for a successful call
+    bool rpcCall(RpcContext& rpc, std::string_view method, const JsonDocument::Node* params,
+                 JsonWriter& result, std::string& error) {
+        const JsonDocument& request = rpc.request;
+        if (method == "login") {
+            std::string_view username, password;
+            if (!params || !JsonDocument::toString(request.find(*params, "username"), username) ||
+                !JsonDocument::toString(request.find(*params, "password"), password)) {
+                error = "username and password are required";
+                return false;
+            }
+            auto it = rpc.userByName.find(std::string(username));
+            if (it == rpc.userByName.end() || !it->second->authenticate(std::string(password))) {
+                error = "invalid username or password";
+                return false;
+            }
+            uint64_t token;
+            do {
+                token = rpc.random();
+            } while (token == 0 || rpc.sessions.count(token));
+            rpc.sessions[token] = it->second;
+            char hex[17];
+            std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(token));
+            result.beginObject()
+                .key("session").value(std::string_view(hex, 16))
+                .key("user_id").value(it->second->getUserId())
+                .key("username").value(it->second->getUsername())
+                .key("librarian").value(it->second->usesLibrarianMenu())
+                .endObject();
+            return true;
+        }
+        if (method == "search") {
+            std::string_view field, query, cursorText;
+            long long limit = config()->page_size;
+            if (!params || !JsonDocument::toString(request.find(*params, "query"), query)) {
+                error = "query is required";
+                return false;
+            }
+            JsonDocument::toString(request.find(*params, "field"), field);
+            JsonDocument::toInt(request.find(*params, "limit"), limit);
+            JsonDocument::toString(request.find(*params, "cursor"), cursorText);
+            BookSearch::Field searchField = BookSearch::Field::Title;
+            if (field == "author") searchField = BookSearch::Field::Author;
+            else if (field == "category") searchField = BookSearch::Field::Category;
+            else if (!field.empty() && field != "title") {
+                error = "field must be title, author or category";
+                return false;
+            }
+            PageCursor cursor;
+            if (!PageCursor::parse(std::string(cursorText), cursor)) {
+                error = "bad cursor";
+                return false;
+            }
+            limit = std::max(1LL, std::min(limit, 1000LL));
+
+            Page<const Book*> page = catalog.searchPage(searchField, std::string(query), cursor, static_cast<size_t>(limit));
+            result.beginObject().key("books").beginArray();
+            for (const Book* book : page.items) writeBookJson(result, *book);
+            result.endArray().key("next_cursor");
+            if (page.more) result.value(page.next.toString());
+            else result.null();
+            result.endObject();
+            return true;
+        }
+        if (method == "stats") {
+            User* user = rpcSessionUser(rpc, params, error);
+            if (!user) return false;
+            if (!user->usesLibrarianMenu()) {
+                error = "librarians only";
+                return false;
+            }
+            LoanStatistics stats = loanManager->getStatistics();
+            FineAccrualSummary accrued = loanManager->currentFineAccrual(books, users);
+            result.beginObject()
+                .key("books").value(static_cast<long long>(books.size()))
+                .key("users").value(static_cast<long long>(users.size()))
+                .key("total_loans").value(stats.totalLoans)
+                .key("active_loans").value(stats.activeLoans)
+                .key("overdue").value(stats.overdueCount)
+                .key("total_fines").value(stats.totalFines)
+                .key("accruing_fines").value(accrued.accruedTotal)
+                .endObject();
+            return true;
+        }
+
+        // The rest act for the logged-in user
+        if (method != "logout" && method != "borrow" && method != "return" && method != "reserve" &&
+            method != "fines") {
+            error = method.empty() ? "method is required" : "unknown method";
+            return false;
+        }
+        User* user = rpcSessionUser(rpc, params, error);
+        if (!user) return false;
+        if (method == "logout") {
+            std::string_view token;
+            JsonDocument::toString(request.find(*params, "session"), token);
+            uint64_t id = 0;
+            std::from_chars(token.data(), token.data() + token.size(), id, 16);
+            rpc.sessions.erase(id);
+            result.beginObject().endObject();
+            return true;
+        }
+        if (method == "borrow" || method == "return" || method == "reserve") {
+            Book* book = rpcBook(rpc, params, error);
+            if (!book) return false;
+            if (method == "borrow") {
+                if (!loanManager->borrowBook(user, book)) {
+                    error = "cannot borrow (limits, fines or availability)";
+                    return false;
+                }
+                result.beginObject().key("book_id").value(book->getId())
+                    .key("due_date").value(loanManager->getTransactions().back()->dueDate).endObject();
+            } else if (method == "return") {
+                if (!loanManager->returnBook(user, book)) {
+                    error = "no open loan of this book by this user";
+                    return false;
+                }
+                result.beginObject().key("book_id").value(book->getId())
+                    .key("fines").value(user->getTotalFines()).endObject();
+            } else {
+                if (!loanManager->reserveBook(user, book)) {
+                    error = "cannot reserve (the book must be on loan and not already reserved by you)";
+                    return false;
+                }
+                result.beginObject().key("book_id").value(book->getId()).endObject();
+            }
+            return true;
+        }
+        if (method == "fines") {
+            // Librarians may look up anyone with user_id
+            User* subject = user;
+            long long userId;
+            if (JsonDocument::toInt(request.find(*params, "user_id"), userId) && userId != user->getUserId()) {
+                if (!user->usesLibrarianMenu()) {
+                    error = "librarians only";
+                    return false;
+                }
+                subject = userId > 0 && userId <= std::numeric_limits<int>::max()
+                              ? userSlots.find(static_cast<int>(userId)) : nullptr;
+                if (!subject) {
+                    error = "user not found";
+                    return false;
+                }
+            }
+            if (!loanManager->accrueUserFines(subject)) loanManager->accrueFines(books, users);
+            result.beginObject()
+                .key("user_id").value(subject->getUserId())
+                .key("fines").value(subject->getTotalFines())
+                .key("accruing").value(subject->getAccruedFines())
+                .endObject();
+            return true;
+        }
+        return false;
+    }
+
+    void handleRpcLine(RpcContext& rpc, std::string_view line) {
+        JsonWriter json(rpc.responses);
+        std::string error;
+        if (!rpc.request.parse(line, error) || rpc.request.root().type != JsonDocument::Type::Object) {
+            if (error.empty()) error = "a request must be a JSON object";
+            json.beginObject().key("id").null().key("ok").value(false)
+                .key("error").value("bad request: " + error).endObject();
+            rpc.responses += '\n';
+            return;
+        }
+
+        const JsonDocument::Node& root = rpc.request.root();
+        json.beginObject().key("id");
+        const JsonDocument::Node* id = rpc.request.find(root, "id");
+        if (id && id->type == JsonDocument::Type::Number) json.raw(id->text);
+        else if (id && id->type == JsonDocument::Type::String) json.value(id->text);
+        else json.null();
+
+        std::string_view method;
+        JsonDocument::toString(rpc.request.find(root, "method"), method);
+        const JsonDocument::Node* params = rpc.request.find(root, "params");
+        if (params && params->type != JsonDocument::Type::Object) params = nullptr;
+
+        // On failure whatever the call wrote is dropped
+        const size_t resultStart = rpc.responses.size();
+        json.key("ok").value(true).key("result");
+        if (rpcCall(rpc, method, params, json, error)) {
+            json.endObject();
+        } else {
+            rpc.responses.resize(resultStart);
+            rpc.responses += ",\"ok\":false,\"error\":";
+            JsonWriter(rpc.responses).value(error).endObject();
+        }
+        rpc.responses += '\n';
+    }
 
 public:
+    // Serves requests from inFd until end of input, then saves once.
+    // Responses go to outFd; anything else printed goes to std::cout.
+    int runRpc(int inFd, int outFd) {
+        RpcContext rpc;
+        rpc.userByName.reserve(users.size());
+        for (const auto& user : users) rpc.userByName[user->getUsername()] = user.get();
+
+        auto flushResponses = [&] {
+            const char* data = rpc.responses.data();
+            size_t left = rpc.responses.size();
+            while (left > 0) {
+#ifdef _WIN32
+                int written = _write(outFd, data, static_cast<unsigned>(left));
+#else
+                ssize_t written = ::write(outFd, data, left);
+#endif
+                if (written <= 0) break; // the client went away
+                data += written;
+                left -= static_cast<size_t>(written);
+            }
+            rpc.responses.clear();
+        };
+
+        std::string input;
+        std::vector<char> chunk(64 * 1024);
+        size_t requests = 0;
+        while (true) {
+            size_t consumed = 0;
+            size_t newline;
+            while ((newline = input.find('\n', consumed)) != std::string::npos) {
+                std::string_view line(input.data() + consumed, newline - consumed);
+                consumed = newline + 1;
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (line.find_first_not_of(" \t") == std::string_view::npos) continue;
+                handleRpcLine(rpc, line);
+                ++requests;
+                if (rpc.responses.size() >= 64 * 1024) flushResponses();
+            }
+            input.erase(0, consumed);
+            flushResponses();
+#ifdef _WIN32
+            int got = _read(inFd, chunk.data(), static_cast<unsigned>(chunk.size()));
+#else
+            ssize_t got = ::read(inFd, chunk.data(), chunk.size());
+#endif
+            if (got <= 0) break;
+            input.append(chunk.data(), static_cast<size_t>(got));
+        }
+        if (input.find_first_not_of(" \t\r") != std::string::npos) {
+            handleRpcLine(rpc, input);
+            ++requests;
+            flushResponses();
+        }
+
+        std::cout << "[rpc] " << requests << " requests served\n";
+        shutdown();
+        return 0;
+    }
+
+    // Runs every command in the script, then saves once. Bad commands are
+    // reported with their line number and skipped; the result is non-zero
+    // if any command failed.
+    int runBatch(std::istream& script) {
+        auto begin = std::chrono::steady_clock::now();
+        BatchContext context;
+        context.userByName.reserve(users.size());
+        for (const auto& user : users) {
+            context.userByName[user->getUsername()] = user.get();
+        }
+
+        static const char* const commandNames[] = {"add-book", "borrow", "return", "waive", "report", "list",
+                                                   "history"};
+        std::map<std::string, BatchTally> tallies;
+        BatchScriptReader reader(script);
+        BatchCommand command;
+        std::string error;
+        int failed = 0;
+        while (reader.next(command, error)) {
+            bool ok = false;
+            if (command.name.empty()) {
+                // malformed line; error is set by the reader
+            } else if (command.name == "add-book") {
+                ok = batchAddBook(context, command, error);
+            } else if (command.name == "borrow" || command.name == "return") {
+                ok = batchLoan(context, command, error);
+            } else if (command.name == "waive") {
+                ok = batchWaive(context, command, error);
+            } else if (command.name == "list") {
+                ok = batchList(context, command, error);
+            } else if (command.name == "history") {
+                ok = batchHistory(context, command, error);
+            } else if (command.name == "report") {
+                printLibraryStatistics(context.out);
+                ok = true;
+            } else {
+                error = "unknown command '" + command.name + "'";
+            }
+
+            BatchTally& tally = tallies[command.name.empty() ? "(malformed)" : command.name];
+            if (ok) {
+                ++tally.ok;
+            } else {
+                ++tally.failed;
+                ++failed;
+                context.out << "line " << command.line << ": " << error << '\n';
+            }
+            if (context.out.tellp() > 64 * 1024) {
+                std::cout << context.out.str();
+                context.out.str("");
+            }
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        int total = 0;
+        for (const auto& entry : tallies) total += entry.second.ok + entry.second.failed;
+        context.out << "\nBatch summary: " << total << " commands in " << std::fixed << std::setprecision(2)
+                    << elapsed.count() << " ms, " << failed << " failed\n";
+        for (const char* name : commandNames) {
+            auto it = tallies.find(name);
+            if (it == tallies.end()) continue;
+            context.out << "  " << std::left << std::setw(12) << name << std::right << std::setw(8)
+                        << it->second.ok << " ok" << std::setw(8) << it->second.failed << " failed\n";
+        }
+        for (const auto& [name, tally] : tallies) {
+            if (std::find(std::begin(commandNames), std::end(commandNames), name) != std::end(commandNames)) continue;
+            context.out << "  " << std::left << std::setw(12) << name << std::right << std::setw(8)
+                        << tally.ok << " ok" << std::setw(8) << tally.failed << " failed\n";
+        }
+        std::cout << context.out.str() << std::flush;
+
+        shutdown();
+        return failed == 0 ? 0 : 1;
+    }
+
     LibrarySystem() : loanManager(std::make_unique<LoanManager>()), currentUser(nullptr) {
         // ساخت پوشه database اگر وجود نداشت
+        auto startupBegin = std::chrono::steady_clock::now();
+        uint64_t startupTraceBegin = Tracer::nowNs();
         #ifdef _WIN32
         _mkdir("database");
         #else
         mkdir("database", 0777);
         #endif
 
-        // بررسی وجود فایل و خواندن کاربران
-        CSVStorageManager::checkOrCreateCSVFile(usersCSVFile);
-        users = CSVStorageManager::loadUsers(usersCSVFile);
-        if (users.empty()) {
-            users.push_back(std::make_unique<Librarian>(1, "admin", "admin123"));
-        }
+        // Config first: borrow limits, loan periods and fines come from the snapshot.
+        // Later edits to Config.ini are picked up by the watcher without a restart.
+        timedPhase("config", [this] {
+            loadGlobalConfigurationFromIni();
+            applyDiagnosticsConfig();
+            configWatcher.start(ConfigManager::getConfigFile(), [] {
+                // saveConfig has already published what it wrote
+                if (ConfigManager::unchangedSinceSave()) return;
+                if (loadGlobalConfigurationFromIni()) {
+                    applyDiagnosticsConfig();
+                }
+            });
+        });
+
+        // The four files are independent, so they load concurrently.
+        // Each task only touches its own member (the transaction and reservation
+        // tasks touch different parts of the LoanManager), and the transaction
+        // index build runs inside its task so it overlaps with the other reads.
+        TaskGroup loads;
+        loads.run([this] {
+            // بررسی وجود فایل و خواندن کاربران
+            timedPhase("load users", [this] {
+                CSVStorageManager::checkOrCreateCSVFile(usersCSVFile, CSVStorageManager::usersHeader);
+                users = CSVStorageManager::loadUsers(usersCSVFile);
+            });
+            timedPhase("index users", [this] { indexLoaded(users, userSlots, &User::getUserId, "user"); });
+        });
+        loads.run([this] {
+            // بررسی وجود فایل و خواندن کتاب‌ها
+            timedPhase("load books", [this] {
+                CSVStorageManager::checkOrCreateCSVFile(booksCSVFile, CSVStorageManager::booksHeader);
+                books = CSVStorageManager::loadBooks(booksCSVFile);
+            });
+            timedPhase("index catalog", [this] {
+                indexLoaded(books, bookSlots, &Book::getId, "book");
+                catalog.rebuild(books);
+            });
+        });
+        loads.run([this] {
+            // بررسی وجود فایل و خواندن تراکنش‌ها
+            timedPhase("load transactions", [this] { loadTransactions(); });
+            timedPhase("open cold loans", [this] { loanManager->openColdHistory(coldLoansFile, coldLoansIndexFile); });
+            timedPhase("build loan indexes", [this] { loanManager->rebuildIndexes(); });
+        });
+        loads.run([this] {
+            // بررسی وجود فایل و خواندن رزروها
+            timedPhase("load reservations", [this] {
+                CSVStorageManager::checkOrCreateCSVFile(reservationsCSVFile, CSVStorageManager::reservationsHeader);
+                auto loadedReservations = CSVStorageManager::loadReservations(reservationsCSVFile);
+                ScopedMemoryTag tag(MemorySubsystem::Reservations);
+                // فرض بر این است که رزروها را باید به map مربوطه اضافه کنید (مثلاً بر اساس bookId)
+                for (const auto& r : loadedReservations) {
+                    loanManager->getReservations()[r.bookId].push(r);
+                }
+            });
+        });
+        loads.wait();
+        loanManager->addListener(&catalog);
+
+        // Analytics are derived from the loaded history once, then kept up to date by LoanManager events
+        timedPhase("build analytics", [this] { buildAnalytics(); });
+        // Old returned loans leave memory once the analytics have seen them
+        timedPhase("tier loan history", [this] { loanManager->tierHistory(config()->cold_loan_age_days); });
 
-        // بررسی وجود فایل و خواندن کتاب‌ها
-        CSVStorageManager::checkOrCreateCSVFile(booksCSVFile);
-        books = CSVStorageManager::loadBooks(booksCSVFile);
+        // Ids in use win over the saved counters, so a stale ids file cannot cause duplicates
+        ids.load(idsCSVFile);
+        for (const auto& book : books) ids.observe(IdKind::Book, book->getId());
+        for (const auto& user : users) ids.observe(IdKind::User, user->getUserId());
 
-        // بررسی وجود فایل و خواندن تراکنش‌ها
-        CSVStorageManager::checkOrCreateCSVFile(transactionsCSVFile);
-        auto loadedTransactions = CSVStorageManager::loadLoanTransactions(transactionsCSVFile);
-        for (auto& t : loadedTransactions) {
-            loanManager->getTransactions().push_back(std::move(t));
+        if (users.empty()) {
+            ScopedMemoryTag tag(MemorySubsystem::Users);
+            addUser(std::make_unique<Librarian>(ids.allocate(IdKind::User), "admin", "admin123"));
         }
 
-        // بررسی وجود فایل و خواندن رزروها
-        CSVStorageManager::checkOrCreateCSVFile(reservationsCSVFile);
-        auto loadedReservations = CSVStorageManager::loadReservations(reservationsCSVFile);
-        // فرض بر این است که رزروها را باید به map مربوطه اضافه کنید (مثلاً بر اساس bookId)
-        for (const auto& r : loadedReservations) {
-            loanManager->getReservations()[r.bookId].push(r);
+        // Fines keep accruing on overdue loans while they are out; balances reflect them from the start
+        timedPhase("accrue fines", [this] { loanManager->accrueFines(books, users); });
+
+        if (Tracer::isEnabled()) {
+            Tracer::record("LibrarySystem startup", startupTraceBegin, Tracer::nowNs() - startupTraceBegin);
         }
+        std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - startupBegin;
+        printStartupPhases(total.count());
     }
 
     void run() {
-        loadGlobalConfigurationFromIni();
         showMainMenu();
+        shutdown();
+    }
+
+    // Saves the database and writes the diagnostics files that are enabled
+    void shutdown() {
+        saveDatabase();
+        if (OperationMetrics::isEnabled()) {
+            OperationMetrics::dump(latencyMetricsFile);
+        }
+        if (Tracer::isEnabled()) {
+            Tracer::writeChromeTrace(traceFile);
+        }
+        MemoryTracker::dump(memoryUsageFile);
+    }
+
+    void saveDatabase() {
+        ScopedTraceSpan span("LibrarySystem save");
         // ذخیره کاربران، کتاب‌ها، تراکنش‌ها و رزروها در انتهای برنامه
         CSVStorageManager::saveUsers(users, usersCSVFile);
         CSVStorageManager::saveBooks(books, booksCSVFile);
-        CSVStorageManager::saveLoanTransactions(loanManager->getTransactions(), transactionsCSVFile);
+        saveTransactions();
         // جمع‌آوری همه رزروها از map و ذخیره در فایل
         std::vector<Reservation> allReservations;
         for (const auto& pair : loanManager->getReservations()) {
@@ -804,11 +1887,47 @@ public:
             }
         }
         CSVStorageManager::saveReservations(allReservations, reservationsCSVFile);
+        borrowers.save(borrowerSketchesFile);
+        ids.save(idsCSVFile);
     }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
+    // LibrarySystem [--batch <script file, or - for stdin> | --rpc]
+    std::string batchScript;
+    bool rpc = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            batchScript = argv[++i];
+        } else if (arg == "--rpc") {
+            rpc = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--batch <script file, or - for stdin> | --rpc]" << std::endl;
+            return 2;
+        }
+    }
+
     try {
+        if (rpc) {
+            // stdout carries only responses; startup and other messages go to stderr
+            std::cout.rdbuf(std::cerr.rdbuf());
+            LibrarySystem library;
+            return library.runRpc(0, 1);
+        }
+        if (!batchScript.empty()) {
+            std::ios::sync_with_stdio(false);
+            std::ifstream file;
+            if (batchScript != "-") {
+                file.open(batchScript);
+                if (!file) {
+                    std::cerr << "Error: cannot open batch script " << batchScript << std::endl;
+                    return 1;
+                }
+            }
+            LibrarySystem library;
+            return library.runBatch(batchScript == "-" ? std::cin : file);
+        }
         LibrarySystem library;
         library.run();
     } catch (const std::exception& e) {
@@ -0,0 +1,406 @@
+// Synthetic dataset generator for benchmarks and capacity planning.
+//
+// Writes users.csv, books.csv, transactions.csv and reservations.csv in the
+// exact CSVStorageManager formats. The data is internally consistent: a book
+// has at most one open loan, users stay within their borrow limit, book status
+// matches the open loans, and reservations only queue on borrowed books.
+// Book popularity follows a Zipf distribution. Loans are simulated day by day
+// over several years and streamed to disk, so the transaction count is
+// limited by disk space rather than memory. Borrow limits, loan periods and
+// fines come from Config.ini, read and compiled by the app's own
+// ConfigManager and FinePolicy, so generated fines match what returnBook
+// would assess.
+//
+// Build from the repository root:
+//   gcc -O2 -c Utils/ini/ini.c -o ini.o
+//   g++ -std=c++17 -O2 -I. tools/DatasetGenerator.cpp "Core Classes/FinePolicy.cpp"
+//       Utils/ini/ConfigManager.cpp Utils/ini/GlobalConfiguration.cpp
+//       Utils/ini/iniReader/INIReader.cpp Utils/metrics/MemoryTracker.cpp
+//       Utils/storage/AtomicFile.cpp Utils/checksum/Crc32c.cpp ini.o -o DatasetGenerator
+// (one command, wrapped here)
+//
+// Usage:
+//   DatasetGenerator [--out database] [--config Config.ini] [--users 1000]
+//                    [--librarians 5] [--books 5000] [--transactions 100000]
+//                    [--years 3] [--zipf 1.0] [--seed 42]
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Utils/csv/CSVStorageManager.h"
+#include "Utils/analytics/DayNumber.h"
+#include "Utils/ini/ConfigManager.h"
+#include "Utils/ini/GlobalConfiguration.h"
+
+namespace {
+
+struct Options {
+    std::string outDir = "database";
+    std::string configFile = "Config.ini";
+    int64_t users = 1000;
+    int64_t librarians = 5;
+    int64_t books = 5000;
+    int64_t transactions = 100000;
+    int years = 3;
+    double zipfExponent = 1.0;
+    uint64_t seed = 42;
+};
+
+// Buffered writer that formats numbers with to_chars and writes in large chunks
+class CsvWriter {
+public:
+    explicit CsvWriter(const std::string& path) : file(std::fopen(path.c_str(), "wb")), used(0) {
+        if (!file) {
+            std::cerr << "Cannot open " << path << " for writing\n";
+            std::exit(1);
+        }
+        buffer.resize(1 << 20);
+    }
+    ~CsvWriter() {
+        flush();
+        std::fclose(file);
+    }
+
+    CsvWriter& text(const char* s) { return text(s, std::strlen(s)); }
+    CsvWriter& text(const std::string& s) { return text(s.data(), s.size()); }
+    CsvWriter& text(const char* s, size_t n) {
+        reserve(n);
+        std::memcpy(buffer.data() + used, s, n);
+        used += n;
+        return *this;
+    }
+    CsvWriter& ch(char c) {
+        reserve(1);
+        buffer[used++] = c;
+        return *this;
+    }
+    CsvWriter& num(int64_t value) {
+        reserve(24);
+        auto result = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value);
+        used = result.ptr - buffer.data();
+        return *this;
+    }
+    CsvWriter& real(double value) {
+        // Same rendering as operator<< with the default precision
+        char tmp[32];
+        int n = std::snprintf(tmp, sizeof(tmp), "%g", value);
+        return text(tmp, n);
+    }
+    CsvWriter& date(int64_t day) {
+        reserve(10);
+        formatDate(day, buffer.data() + used);
+        used += 10;
+        return *this;
+    }
+
+private:
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t used;
+
+    void reserve(size_t n) {
+        if (used + n > buffer.size()) flush();
+    }
+    void flush() {
+        if (used) std::fwrite(buffer.data(), 1, used, file);
+        used = 0;
+    }
+
+    // Days since 1970-01-01 to YYYY-MM-DD (Hinnant's civil_from_days)
+    static void formatDate(int64_t z, char* out) {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(z - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const int64_t y = static_cast<int64_t>(yoe) + era * 400;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+        const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+        const int64_t year = y + (m <= 2);
+        out[0] = char('0' + year / 1000 % 10);
+        out[1] = char('0' + year / 100 % 10);
+        out[2] = char('0' + year / 10 % 10);
+        out[3] = char('0' + year % 10);
+        out[4] = '-';
+        out[5] = char('0' + m / 10);
+        out[6] = char('0' + m % 10);
+        out[7] = '-';
+        out[8] = char('0' + d / 10);
+        out[9] = char('0' + d % 10);
+    }
+};
+
+// Zipf(n, s) sampler using rejection-inversion (Hormann & Derflinger),
+// O(1) per sample without a table. Returns ranks in [1, n].
+class ZipfSampler {
+public:
+    ZipfSampler(int64_t n, double s) : n(n), s(s) {
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralN = hIntegral(n + 0.5);
+        threshold = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    template <typename Rng>
+    int64_t operator()(Rng& rng) {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true) {
+            double u = hIntegralN + uniform(rng) * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            int64_t k = static_cast<int64_t>(x + 0.5);
+            if (k < 1) k = 1;
+            else if (k > n) k = n;
+            if (k - x <= threshold || u >= hIntegral(k + 0.5) - h(static_cast<double>(k))) {
+                return k;
+            }
+        }
+    }
+
+private:
+    int64_t n;
+    double s;
+    double hIntegralX1, hIntegralN, threshold;
+
+    double h(double x) const { return std::exp(-s * std::log(x)); }
+    double hIntegral(double x) const {
+        double logX = std::log(x);
+        return helper2((1.0 - s) * logX) * logX;
+    }
+    double hIntegralInverse(double x) const {
+        double t = x * (1.0 - s);
+        if (t < -1.0) t = -1.0;
+        return std::exp(helper1(t) * x);
+    }
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+enum BookKind { KindTextBook, KindMagazine, KindReference };
+
+// BookStatus values as stored by CSVStorageManager::saveBooks
+const int statusAvailable = 0;
+const int statusBorrowed = 1;
+const int statusReferenceOnly = 4;
+
+const char* categories[] = {"Science", "History", "Fiction", "Art", "Computing", "Philosophy",
+                            "Medicine", "Law", "Economics", "Poetry", "Travel", "Children"};
+const char* fields[] = {"Physics", "Chemistry", "Biology", "Mathematics", "Engineering", "Literature"};
+const char* levels[] = {"HighSchool", "Undergraduate", "Graduate"};
+
+bool parseOptions(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (arg == "--out") o.outDir = value;
+        else if (arg == "--config") o.configFile = value;
+        else if (arg == "--users") o.users = std::stoll(value);
+        else if (arg == "--librarians") o.librarians = std::stoll(value);
+        else if (arg == "--books") o.books = std::stoll(value);
+        else if (arg == "--transactions") o.transactions = std::stoll(value);
+        else if (arg == "--years") o.years = std::stoi(value);
+        else if (arg == "--zipf") o.zipfExponent = std::stod(value);
+        else if (arg == "--seed") o.seed = std::stoull(value);
+        else return false;
+    }
+    return o.users > 0 && o.books > 0 && o.years > 0 && o.transactions >= 0 && o.librarians >= 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseOptions(argc, argv, o)) {
+        std::cerr << "Usage: " << argv[0] << " [--out dir] [--config file] [--users N] [--librarians N]"
+                  << " [--books N] [--transactions N] [--years N] [--zipf S] [--seed N]\n";
+        return 2;
+    }
+    // A missing file leaves every setting at the app's defaults
+    if (!ConfigManager::loadConfig(o.configFile)) {
+        std::cerr << "Note: cannot read " << o.configFile << ", using the default limits and fines\n";
+    }
+    const ConfigSnapshot settings = ConfigManager::readSnapshot();
+
+    std::mt19937_64 rng(o.seed);
+    const int64_t totalUsers = o.users + o.librarians;
+    const int64_t today = todayDayNumber();  // local date, as LoanManager stamps loans
+    const int64_t firstDay = today - 365LL * o.years;
+
+    // Catalog layout: 60% text books, 25% magazines, 15% reference books
+    std::vector<uint8_t> kind(o.books);
+    std::vector<int64_t> lendable; // ids of borrowable books
+    lendable.reserve(o.books);
+    for (int64_t i = 0; i < o.books; ++i) {
+        int64_t bucket = rng() % 100;
+        kind[i] = bucket < 60 ? KindTextBook : (bucket < 85 ? KindMagazine : KindReference);
+        if (kind[i] != KindReference) lendable.push_back(i + 1);
+    }
+    // Popularity rank -> book id, so popular books are spread over the id range
+    std::shuffle(lendable.begin(), lendable.end(), rng);
+
+    // --- transactions.csv: simulate the loan history day by day ---
+    std::vector<int32_t> busyUntil(o.books + 1, INT32_MIN);      // day the open loan ends
+    std::vector<int32_t> openLoansOf(totalUsers + 1, 0);
+    std::vector<uint8_t> openAtEnd(o.books + 1, 0);
+    std::vector<int32_t> borrowerAtEnd(o.books + 1, 0);           // userId of the open loan
+    using ReturnEvent = std::pair<int32_t, int32_t>;               // (return day, userId)
+    std::priority_queue<ReturnEvent, std::vector<ReturnEvent>, std::greater<ReturnEvent>> pendingReturns;
+
+    int64_t written = 0;
+    {
+        CsvWriter out(o.outDir + "/transactions.csv");
+        out.text(CSVStorageManager::transactionsHeader).ch('\n');
+
+        if (!lendable.empty() && o.transactions > 0) {
+            ZipfSampler popularity(static_cast<int64_t>(lendable.size()), o.zipfExponent);
+            std::uniform_int_distribution<int64_t> anyUser(1, totalUsers);
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            int64_t transactionId = 1;
+
+            for (int64_t day = firstDay; day <= today && written < o.transactions; ++day) {
+                while (!pendingReturns.empty() && pendingReturns.top().first <= day) {
+                    --openLoansOf[pendingReturns.top().second];
+                    pendingReturns.pop();
+                }
+
+                // Spread the remaining loans evenly over the remaining days
+                int64_t remainingDays = today - day + 1;
+                int64_t quota = (o.transactions - written + remainingDays - 1) / remainingDays;
+                int64_t attempts = quota * 4;
+                for (int64_t made = 0; made < quota && attempts > 0; --attempts) {
+                    int64_t bookId = lendable[popularity(rng) - 1];
+                    if (busyUntil[bookId] > day) continue;
+                    int64_t userId = anyUser(rng);
+                    bool librarian = userId > o.users;
+                    int limit = librarian ? settings.librarian_borrow_limit : settings.regular_user_borrow_limit;
+                    if (openLoansOf[userId] >= limit) continue;
+
+                    int period = librarian ? settings.librarian_loan_period : settings.regular_user_loan_period;
+                    int64_t due = day + period;
+                    // Most loans come back on time; about 15% are late by up to 30 days
+                    int64_t back = unit(rng) < 0.85
+                        ? day + 1 + static_cast<int64_t>(unit(rng) * period)
+                        : due + 1 + static_cast<int64_t>(unit(rng) * 30);
+
+                    out.num(transactionId++).ch(',').num(userId).ch(',').num(bookId).ch(',')
+                       .date(day).ch(',').date(due).ch(',');
+                    if (back <= today) {
+                        // Assessed as returnBook does: the fine policy, capped at max_fine
+                        BookType type = kind[bookId - 1] == KindMagazine ? BookType::Magazine : BookType::TextBook;
+                        UserRole role = librarian ? UserRole::Librarian : UserRole::Regular;
+                        int daysLate = static_cast<int>(std::max<int64_t>(0, back - due));
+                        double fine = std::min(settings.fine_policy.fine(type, role, daysLate), settings.max_fine);
+                        out.date(back).ch(',').real(fine).text(",1\n");
+                    } else {
+                        out.text(",0,0\n");
+                        openAtEnd[bookId] = 1;
+                        borrowerAtEnd[bookId] = static_cast<int32_t>(userId);
+                    }
+
+                    busyUntil[bookId] = static_cast<int32_t>(back);
+                    ++openLoansOf[userId];
+                    pendingReturns.emplace(static_cast<int32_t>(back), static_cast<int32_t>(userId));
+                    ++made;
+                    ++written;
+                }
+            }
+        }
+    }
+
+    // --- users.csv ---
+    {
+        CsvWriter out(o.outDir + "/users.csv");
+        out.text(CSVStorageManager::usersHeader).ch('\n');
+        for (int64_t id = 1; id <= totalUsers; ++id) {
+            bool librarian = id > o.users;
+            out.num(id).ch(',');
+            if (librarian) out.text("librarian").num(id - o.users);
+            else out.text("user").num(id);
+            out.ch(',').text("pass").num(id).ch(',')
+               .text(librarian ? "Librarian" : "RegularUser").ch(',')
+               .text("Active,0,")
+               .num(librarian ? settings.librarian_borrow_limit : settings.regular_user_borrow_limit).ch(',')
+               .num(librarian ? settings.librarian_loan_period : settings.regular_user_loan_period).ch(',')
+               .text(librarian ? "true,true,true,true\n" : "false,false,false,false\n");
+        }
+    }
+
+    // --- books.csv ---
+    {
+        CsvWriter out(o.outDir + "/books.csv");
+        out.text(CSVStorageManager::booksHeader).ch('\n');
+        for (int64_t id = 1; id <= o.books; ++id) {
+            uint8_t k = kind[id - 1];
+            int status = k == KindReference ? statusReferenceOnly
+                       : (openAtEnd[id] ? statusBorrowed : statusAvailable);
+            int64_t published = firstDay - 365 * 20 + static_cast<int64_t>(rng() % (365 * 20));
+            out.num(id).ch(',')
+               .text("Title ").num(id).ch(',')
+               .text("Author ").num(static_cast<int64_t>(rng() % (o.books / 4 + 1)) + 1).ch(',')
+               .text(categories[rng() % (sizeof(categories) / sizeof(categories[0]))]).ch(',')
+               .date(published).ch(',')
+               .num(40 + static_cast<int64_t>(rng() % 900)).ch(',')
+               .num(status).ch(',');
+            switch (k) {
+                case KindTextBook:
+                    out.text("TextBook,").text(levels[rng() % 3]).ch(',').text(fields[rng() % 6]).text(",\n");
+                    break;
+                case KindMagazine:
+                    out.text("Magazine,,,").num(1 + static_cast<int64_t>(rng() % 200)).ch('\n');
+                    break;
+                default:
+                    out.text("ReferenceBook,,,\n");
+                    break;
+            }
+        }
+    }
+
+    // --- reservations.csv: short queues on some of the borrowed books ---
+    int64_t reservations = 0;
+    {
+        CsvWriter out(o.outDir + "/reservations.csv");
+        out.text(CSVStorageManager::reservationsHeader).ch('\n');
+        std::uniform_int_distribution<int64_t> anyUser(1, totalUsers);
+        std::vector<int64_t> queued;
+        for (int64_t id = 1; id <= o.books; ++id) {
+            if (!openAtEnd[id] || rng() % 3 != 0) continue;
+            // Everyone but the borrower may queue, each user once per book
+            int queueLength = static_cast<int>(std::min<int64_t>(1 + rng() % 3, totalUsers - 1));
+            // Queued a day apart, the last one today at the latest
+            int64_t reservedOn = today - (queueLength - 1) - static_cast<int64_t>(rng() % 10);
+            queued.clear();
+            while (static_cast<int>(queued.size()) < queueLength) {
+                int64_t userId = anyUser(rng);
+                if (userId == borrowerAtEnd[id] ||
+                    std::find(queued.begin(), queued.end(), userId) != queued.end()) continue;
+                queued.push_back(userId);
+            }
+            for (int q = 0; q < queueLength; ++q) {
+                // Waiting reservations have no expiry until the book is returned
+                out.num(queued[q]).ch(',').num(id).ch(',').date(reservedOn + q).text(",\n");
+                ++reservations;
+            }
+        }
+    }
+
+    std::cerr << "Wrote " << totalUsers << " users, " << o.books << " books, " << written
+              << " transactions and " << reservations << " reservations to " << o.outDir << "\n";
+    if (written < o.transactions) {
+        std::cerr << "Note: only " << written << " of " << o.transactions
+                  << " loans fit; add books or years for a denser history\n";
+    }
+    return 0;
+}